@@ -2,6 +2,7 @@
 #include <bits/stdc++.h>
 #include "../include/ntt.h"
 #include "../include/montgomery.h"
+#include "../include/poly_arena.h"
 using namespace std;
 using u64 = uint64_t;
 using clk = chrono::high_resolution_clock;
@@ -40,13 +41,16 @@ int main() {
     vector<u64> a(n);
     for (size_t i=0;i<n/8;i++) a[i]=i+1;
 
+    // Every transform maps [0, mod) to [0, mod), so each timing runs in
+    // place on its own buffer instead of copying the input per run.
     auto a_baseline = a;
     auto a_full = a;
-    auto a_core = a;
+    PolyArena arena;
+    PolyBuf a_core(arena, n), a_avx(arena, n);
 
     // Full transform timings (includes conversions)
-    double t_baseline = time_fn([&](){ auto t = a_baseline; ntt(t, roots, mod); }, 5);
-    double t_full = time_fn([&](){ auto t = a_full; ntt_montgomery(t, roots, mod); }, 5);
+    double t_baseline = time_fn([&](){ ntt(a_baseline, roots, mod); }, 5);
+    double t_full = time_fn([&](){ ntt_montgomery(a_full, roots, mod); }, 5);
 
     // Now prepare montgomery preconverted arrays for core timing
     Montgomery M(mod);
@@ -54,13 +58,12 @@ int main() {
     vector<u64> mroots = compute_roots(root_n, n, mod);
     for (size_t i = 0; i < n; ++i) mroots[i] = M.to_mont(mroots[i]);
     // convert input to mont domain
-    for (size_t i = 0; i < n; ++i) a_core[i] = M.to_mont(a_core[i]);
+    for (size_t i = 0; i < n; ++i) a_core[i] = a_avx[i] = M.to_mont(a[i]);
 
-    double t_core = time_fn([&](){ auto t = a_core; ntt_montgomery_core(t, mroots, mod); }, 5);
+    double t_core = time_fn([&](){ ntt_montgomery_core(a_core.data(), n, mroots.data(), mod); }, 5);
 
 
-    auto a_avx = a_core;
-    double t_avx = time_fn([&](){ auto t = a_avx; ntt_avx2_core(t, mroots, mod); }, 5);
+    double t_avx = time_fn([&](){ ntt_avx2_core(a_avx.data(), n, mroots.data(), mod); }, 5);
     cout << "NTT montgomery avx2 core median ms: " << t_avx << endl;
     if (t_avx>0) cout << "AVX2 Core Speedup: " << t_baseline / t_avx << "x" << endl;
 
@@ -1 +1,240 @@
-// GoogleBenchmark demo placeholder
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+#include "../include/ntt.h"
+#include "../include/ntt_batch.h"
+#include "../include/ntt_fixed.h"
+#include "../include/ntt_plan.h"
+#include "../include/montgomery.h"
+#include "../include/cpu_features.h"
+#include "../include/aligned_vector.h"
+#if defined(__x86_64__) || defined(__i386)
+#include <x86intrin.h>
+#endif
+using u64 = uint64_t;
+using u32 = uint32_t;
+
+// Kernel benchmarks: every transform variant over n = 2^10..2^20 and the
+// 31/50/60-bit modulus classes (batch variants over batch sizes). Each one
+// runs in place on a buffer prepared outside the timed loop; the transforms
+// map reduced input to reduced output, so no copy is needed per iteration.
+//
+// Counters: ns_per_bfly (wall time per butterfly, (n/2) log2 n per transform)
+// and cycles_per_bfly (time-stamp counter ticks, i.e. cycles at the nominal
+// TSC frequency, not core cycles under turbo). Write JSON with
+//   gbench_ntt --benchmark_out=run.json --benchmark_out_format=json
+// and compare it against bench/baseline.json with bench/compare.py.
+
+static u64 tsc() {
+#if defined(__x86_64__) || defined(__i386)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Largest prime of the class below 2^bits with q = 1 (mod 2^21), so one
+// modulus serves every size in the sweep (2013265921 for 31 bits).
+static u64 class_prime(unsigned bits) {
+    static std::map<unsigned, u64> cache;
+    auto it = cache.find(bits);
+    if (it != cache.end()) return it->second;
+    u64 q = generate_ntt_primes(bits, 1, size_t(1) << 20).at(0);
+    cache[bits] = q;
+    return q;
+}
+
+static void random_fill(u64* a, size_t n, u64 mod) {
+    std::mt19937_64 rng(n ^ mod);
+    for (size_t i = 0; i < n; ++i) a[i] = rng() % mod;
+}
+
+static double butterflies(size_t n, unsigned log_n) {
+    return double(n / 2) * log_n;
+}
+
+// Runs fn() per iteration and attaches the per-butterfly counters.
+template <class Fn>
+static void run(benchmark::State& state, double bfly, Fn&& fn) {
+    auto c0 = std::chrono::steady_clock::now();
+    u64 t0 = tsc();
+    for (auto _ : state) {
+        fn();
+        benchmark::ClobberMemory();
+    }
+    u64 t1 = tsc();
+    auto c1 = std::chrono::steady_clock::now();
+    const double total = bfly * double(state.iterations());
+    state.counters["ns_per_bfly"] = std::chrono::duration<double, std::nano>(c1 - c0).count() / total;
+    state.counters["cycles_per_bfly"] = double(t1 - t0) / total;
+    state.SetItemsProcessed(int64_t(bfly) * state.iterations());
+}
+
+// Plan for the class modulus, optionally forced onto the scalar kernels.
+struct Setup {
+    unsigned log_n;
+    size_t n;
+    u64 mod;
+    NttPlan plan;
+    aligned_vector<u64> a;
+
+    Setup(const benchmark::State& state, bool avx2)
+        : log_n((unsigned)state.range(0)), n(size_t(1) << log_n), mod(class_prime((unsigned)state.range(1))),
+          plan(n, mod), a(n) {
+        plan.use_avx2 = avx2 && plan.use_avx2;
+        random_fill(a.data(), n, mod);
+    }
+};
+
+static bool skip_without_avx2(benchmark::State& state) {
+    if (cpu_has_avx2()) return false;
+    state.SkipWithError("host has no AVX2");
+    return true;
+}
+
+// --- single transforms ---
+
+static void BM_baseline(benchmark::State& state) {
+    Setup s(state, false);
+    std::vector<u64> roots = compute_roots(s.plan.root, s.n, s.mod);
+    std::vector<u64> v(s.a.begin(), s.a.end());
+    run(state, butterflies(s.n, s.log_n), [&] { ntt(v, roots, s.mod); });
+}
+
+static void BM_montgomery_core(benchmark::State& state) {
+    Setup s(state, false);
+    Montgomery M(s.mod);
+    std::vector<u64> mroots = compute_roots(s.plan.root, s.n, s.mod);
+    for (u64& r : mroots) r = M.to_mont(r);
+    run(state, butterflies(s.n, s.log_n), [&] { ntt_montgomery_core(s.a.data(), s.n, mroots.data(), s.mod); });
+}
+
+static void BM_montgomery_avx2(benchmark::State& state) {
+    if (skip_without_avx2(state)) return;
+    Setup s(state, true);
+    Montgomery M(s.mod);
+    std::vector<u64> mroots = compute_roots(s.plan.root, s.n, s.mod);
+    for (u64& r : mroots) r = M.to_mont(r);
+    run(state, butterflies(s.n, s.log_n), [&] { ntt_avx2_core(s.a.data(), s.n, mroots.data(), s.mod); });
+}
+
+static void BM_plan_scalar(benchmark::State& state) {
+    Setup s(state, false);
+    run(state, butterflies(s.n, s.log_n), [&] { ntt(s.a.data(), s.n, s.plan); });
+}
+
+static void BM_plan_avx2(benchmark::State& state) {
+    if (skip_without_avx2(state)) return;
+    Setup s(state, true);
+    run(state, butterflies(s.n, s.log_n), [&] { ntt(s.a.data(), s.n, s.plan); });
+}
+
+static void BM_bitrev(benchmark::State& state) {
+    Setup s(state, true);
+    run(state, butterflies(s.n, s.log_n), [&] { ntt_to_bitrev(s.a.data(), s.n, s.plan); });
+}
+
+static void BM_negacyclic_scalar(benchmark::State& state) {
+    Setup s(state, false);
+    run(state, butterflies(s.n, s.log_n), [&] { ntt_negacyclic(s.a.data(), s.n, s.plan); });
+}
+
+static void BM_negacyclic(benchmark::State& state) {
+    Setup s(state, true);
+    run(state, butterflies(s.n, s.log_n), [&] { ntt_negacyclic(s.a.data(), s.n, s.plan); });
+}
+
+static void BM_negacyclic_inverse(benchmark::State& state) {
+    Setup s(state, true);
+    run(state, butterflies(s.n, s.log_n), [&] { intt_negacyclic(s.a.data(), s.n, s.plan); });
+}
+
+// u32 storage; only the 31-bit class qualifies (plan.narrow)
+static void BM_negacyclic_u32(benchmark::State& state) {
+    Setup s(state, true);
+    if (!s.plan.narrow) {
+        state.SkipWithError("modulus too wide for the u32 path");
+        return;
+    }
+    aligned_vector<u32> a32(s.a.begin(), s.a.end());
+    run(state, butterflies(s.n, s.log_n), [&] { ntt_negacyclic(a32.data(), s.n, s.plan); });
+}
+
+// registered Ntt<Q, LOGN> instances (their own 60-bit primes); range(1) is
+// the index into the candidates
+static void BM_negacyclic_fixed(benchmark::State& state) {
+    static const u64 candidates[] = {1152921504606748673ULL, 1152921504606683137ULL};
+    const unsigned log_n = (unsigned)state.range(0);
+    const size_t n = size_t(1) << log_n;
+    const FixedNtt* f = find_fixed_ntt(n, candidates[state.range(1)]);
+    if (!f) {
+        state.SkipWithError("no registered instance");
+        return;
+    }
+    aligned_vector<u64> a(n);
+    random_fill(a.data(), n, f->mod);
+    run(state, butterflies(n, log_n), [&] { f->forward(a.data()); });
+}
+
+// --- batches of equal-size transforms; range(2) is the batch size ---
+
+static void BM_batch_serial(benchmark::State& state) {
+    Setup s(state, true);
+    const size_t count = (size_t)state.range(2);
+    aligned_vector<u64> a(count * s.n);
+    random_fill(a.data(), a.size(), s.mod);
+    run(state, count * butterflies(s.n, s.log_n), [&] { ntt_negacyclic_batch(a.data(), count, s.plan); });
+}
+
+static void BM_batch_interleaved(benchmark::State& state) {
+    Setup s(state, true);
+    const size_t count = (size_t)state.range(2);
+    aligned_vector<u64> a(batch_interleaved_words(count, s.n));
+    random_fill(a.data(), a.size(), s.mod);
+    const size_t groups = a.size() / (NTT_BATCH_LANES * s.n);
+    run(state, count * butterflies(s.n, s.log_n),
+        [&] { ntt_negacyclic_interleaved(a.data(), groups, s.plan); });
+}
+
+// --- sweeps ---
+
+static void sizes_and_widths(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"log_n", "bits"});
+    for (int bits : {31, 50, 60})
+        for (int lg = 10; lg <= 20; ++lg) b->Args({lg, bits});
+}
+
+static void fixed_sets(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"log_n", "prime"});
+    for (int p : {0, 1})
+        for (int lg : {12, 13, 14}) b->Args({lg, p});
+}
+
+static void batches(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"log_n", "bits", "batch"});
+    for (int bits : {31, 50, 60})
+        for (int lg = 10; lg <= 14; ++lg)
+            for (int count : {4, 16}) b->Args({lg, bits, count});
+}
+
+BENCHMARK(BM_baseline)->Apply(sizes_and_widths);
+BENCHMARK(BM_montgomery_core)->Apply(sizes_and_widths);
+BENCHMARK(BM_montgomery_avx2)->Apply(sizes_and_widths);
+BENCHMARK(BM_plan_scalar)->Apply(sizes_and_widths);
+BENCHMARK(BM_plan_avx2)->Apply(sizes_and_widths);
+BENCHMARK(BM_bitrev)->Apply(sizes_and_widths);
+BENCHMARK(BM_negacyclic_scalar)->Apply(sizes_and_widths);
+BENCHMARK(BM_negacyclic)->Apply(sizes_and_widths);
+BENCHMARK(BM_negacyclic_inverse)->Apply(sizes_and_widths);
+BENCHMARK(BM_negacyclic_u32)->Apply([](benchmark::internal::Benchmark* b) {
+    b->ArgNames({"log_n", "bits"});
+    for (int lg = 10; lg <= 20; ++lg) b->Args({lg, 31});
+});
+BENCHMARK(BM_negacyclic_fixed)->Apply(fixed_sets);
+BENCHMARK(BM_batch_serial)->Apply(batches);
+BENCHMARK(BM_batch_interleaved)->Apply(batches);
+
+BENCHMARK_MAIN();
@@ -1,6 +1,8 @@
 \
 #include <bits/stdc++.h>
 #include "../include/ntt.h"
+#include "../include/ntt_batch.h"
+#include "../include/ntt_fixed.h"
 using namespace std;
 using u64 = uint64_t;
 using clk = chrono::high_resolution_clock;
@@ -16,6 +18,17 @@ u64 mod_pow(u64 a, u64 e, u64 mod) {
     return (u64)res;
 }
 
+double best_ns(function<void()> fn, int runs) {
+    double best = 1e300;
+    for (int i = 0; i < runs; i++) {
+        auto t0 = clk::now();
+        fn();
+        auto t1 = clk::now();
+        best = min(best, chrono::duration<double, std::nano>(t1 - t0).count());
+    }
+    return best;
+}
+
 int main() {
     const u64 mod = 2013265921;
     size_t n = 1<<14; // 16384 - may be large for this environment; adjust as needed
@@ -30,5 +43,64 @@ int main() {
     auto t1 = clk::now();
     double ms = chrono::duration<double, std::milli>(t1-t0).count();
     cout << "NTT of size " << n << " took " << ms << " ms (single run)" << endl;
+
+    // Size sweep of the plan transforms in ns per butterfly ((n/2) log2 n
+    // butterflies per transform). Sizes from 2^17 on take the cache-blocked
+    // path, so the columns should stay roughly flat. BENCH_MAX_LOG caps it.
+    int max_log = 20;
+    if (const char* e = getenv("BENCH_MAX_LOG")) max_log = atoi(e);
+    const u64 q = generate_ntt_primes(60, 1, size_t(1) << max_log)[0];
+    printf("\n%6s %14s %14s %14s %14s   (ns/butterfly, 60-bit q)\n",
+           "log n", "ntt", "intt", "ntt_nega", "intt_nega");
+    for (int lg = 12; lg <= max_log; ++lg) {
+        size_t m = size_t(1) << lg;
+        NttPlan plan(m, q);
+        vector<u64> x(m);
+        for (size_t i = 0; i < m; ++i) x[i] = (i * 0x9e3779b97f4a7c15ULL) % q;
+        int runs = max(5, (int)((size_t(1) << 23) / m));
+        double bf = (double)m / 2 * lg;
+        double t_f = best_ns([&]() { ntt(x, plan); }, runs);
+        double t_i = best_ns([&]() { intt(x, plan); }, runs);
+        double t_nf = best_ns([&]() { ntt_negacyclic(x, plan); }, runs);
+        double t_ni = best_ns([&]() { intt_negacyclic(x, plan); }, runs);
+        printf("%6d %14.2f %14.2f %14.2f %14.2f\n", lg, t_f / bf, t_i / bf, t_nf / bf, t_ni / bf);
+    }
+
+    // Batches of 16 negacyclic transforms: one polynomial at a time versus
+    // the interleaved layout (4 polynomials per vector).
+    const size_t batch = 16;
+    printf("\n%6s %14s %14s   (ns/butterfly, forward, batch of %zu)\n", "log n", "per-poly", "interleaved", batch);
+    for (int lg = 8; lg <= min(14, max_log); lg += 2) {
+        size_t m = size_t(1) << lg;
+        NttPlan plan(m, q);
+        vector<u64> x(batch * m), il(batch_interleaved_words(batch, m));
+        for (size_t i = 0; i < x.size(); ++i) x[i] = (i * 0x9e3779b97f4a7c15ULL) % q;
+        batch_interleave(x.data(), batch, m, il.data());
+        int runs = max(5, (int)((size_t(1) << 22) / (batch * m)));
+        double bf = (double)batch * m / 2 * lg;
+        double t_p = best_ns([&]() { ntt_negacyclic_batch(x.data(), batch, plan); }, runs);
+        double t_il = best_ns([&]() { ntt_negacyclic_interleaved(il.data(), batch / NTT_BATCH_LANES, plan); }, runs);
+        printf("%6d %14.2f %14.2f\n", lg, t_p / bf, t_il / bf);
+    }
+
+    // Compile-time specialized instances (ntt_fixed.h) against the plan.
+    const u64 qf = 1152921504606748673ULL;
+    printf("\n%6s %14s %14s %14s %14s   (ns/butterfly, registered 60-bit q)\n",
+           "log n", "plan fwd", "fixed fwd", "plan inv", "fixed inv");
+    for (int lg = 12; lg <= 14; ++lg) {
+        size_t m = size_t(1) << lg;
+        const NttPlan& plan = *cached_plan(m, qf);
+        const FixedNtt* f = find_fixed_ntt(m, qf);
+        if (!f) continue;
+        vector<u64> x(m);
+        for (size_t i = 0; i < m; ++i) x[i] = (i * 0x9e3779b97f4a7c15ULL) % qf;
+        int runs = max(5, (int)((size_t(1) << 23) / m));
+        double bf = (double)m / 2 * lg;
+        double t_pf = best_ns([&]() { ntt_negacyclic(x, plan); }, runs);
+        double t_ff = best_ns([&]() { f->forward(x.data()); }, runs);
+        double t_pi = best_ns([&]() { intt_negacyclic(x, plan); }, runs);
+        double t_fi = best_ns([&]() { f->inverse(x.data()); }, runs);
+        printf("%6d %14.2f %14.2f %14.2f %14.2f\n", lg, t_pf / bf, t_ff / bf, t_pi / bf, t_fi / bf);
+    }
     return 0;
 }
@@ -0,0 +1,74 @@
+#include <bits/stdc++.h>
+#include "../include/poly.h"
+#include "../include/rns.h"
+#include "../include/ntt_plan.h"
+using namespace std;
+using u64 = uint64_t;
+using clk = chrono::high_resolution_clock;
+
+// Times schoolbook, Karatsuba and NTT products for equal-length operands;
+// used to pick the crossover constants in src/poly.cpp. Then compares the
+// fused RNS tensor / inner products against composed rns_multiply calls.
+double time_fn(function<void()> fn, int runs) {
+    vector<double> times;
+    for (int i = 0; i < runs; i++) {
+        auto t0 = clk::now();
+        fn();
+        auto t1 = clk::now();
+        times.push_back(chrono::duration<double, micro>(t1 - t0).count());
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+int main() {
+    const u64 mods[] = {2013265921ULL, 1152921504606584833ULL};
+    mt19937_64 rng(1);
+    for (u64 mod : mods) {
+        printf("mod = %llu\n%8s %12s %12s %12s  (us)\n", (unsigned long long)mod, "len", "schoolbook", "karatsuba", "ntt");
+        for (size_t len : {16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 1024, 2048}) {
+            vector<u64> a(len), b(len);
+            for (auto& x : a) x = rng() % mod;
+            for (auto& x : b) x = rng() % mod;
+            int runs = len <= 256 ? 201 : 31;
+            double ts = time_fn([&]() { auto c = poly_mul_schoolbook(a, b, mod); }, runs);
+            double tk = time_fn([&]() { auto c = poly_mul_karatsuba(a, b, mod); }, runs);
+            double tn = time_fn([&]() { auto c = poly_mul_ntt(a, b, mod); }, runs);
+            printf("%8zu %12.2f %12.2f %12.2f\n", len, ts, tk, tn);
+        }
+    }
+
+    printf("\n%6s %12s %12s %12s %12s  (us, 3 x 60-bit limbs)\n", "log n", "tensor", "fused",
+           "inner(8)", "fused");
+    for (unsigned lg : {12u, 13u, 14u}) {
+        size_t n = size_t(1) << lg;
+        RnsBase B(n, generate_ntt_primes(60, 3, n));
+        vector<RnsPoly> a(8, RnsPoly(B)), b(8, RnsPoly(B));
+        for (size_t k = 0; k < 8; ++k)
+            for (size_t i = 0; i < B.size(); ++i)
+                for (size_t j = 0; j < n; ++j) {
+                    a[k].limb(i)[j] = rng() % B.moduli[i];
+                    b[k].limb(i)[j] = rng() % B.moduli[i];
+                }
+        RnsPoly c0(B), c1(B), c2(B), t(B);
+        int runs = 21;
+        double tt = time_fn([&]() {
+            rns_multiply(a[0], b[0], c0);
+            rns_multiply(a[0], b[1], c1);
+            rns_multiply(a[1], b[0], t);
+            rns_add(c1, t, c1);
+            rns_multiply(a[1], b[1], c2);
+        }, runs);
+        double tf = time_fn([&]() { rns_tensor(a[0], a[1], b[0], b[1], c0, c1, c2); }, runs);
+        double ti = time_fn([&]() {
+            rns_multiply(a[0], b[0], c0);
+            for (size_t k = 1; k < 8; ++k) {
+                rns_multiply(a[k], b[k], t);
+                rns_add(c0, t, c0);
+            }
+        }, runs);
+        double tif = time_fn([&]() { rns_inner_product(a, b, c0); }, runs);
+        printf("%6u %12.1f %12.1f %12.1f %12.1f\n", lg, tt, tf, ti, tif);
+    }
+    return 0;
+}
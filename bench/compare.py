@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Compare a gbench_ntt JSON run against a stored baseline.
+
+    gbench_ntt --benchmark_out=run.json --benchmark_out_format=json
+    python3 bench/compare.py run.json                 # vs bench/baseline.json
+    python3 bench/compare.py run.json --update        # store run as baseline
+
+The baseline keeps one number per benchmark name: the chosen counter
+(ns_per_bfly by default), the best of the repetitions when the run used
+--benchmark_repetitions. Timings on shared machines are noisy upwards, so
+the minimum is the stable statistic; use 3 or more repetitions for both the
+baseline and the run. Benchmarks slower than the baseline by more than
+--threshold are flagged and make the script exit with status 1.
+"""
+import argparse
+import json
+import os
+import sys
+
+DEFAULT_BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "baseline.json")
+
+
+def load_run(path, metric):
+    with open(path) as f:
+        doc = json.load(f)
+    values = {}
+    for b in doc.get("benchmarks", []):
+        if b.get("error_occurred") or b.get("run_type") == "aggregate" or metric not in b:
+            continue
+        name = b.get("run_name", b["name"])
+        values[name] = min(values.get(name, b[metric]), b[metric])
+    return doc.get("context", {}), values
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("run", help="JSON written by gbench_ntt --benchmark_out")
+    ap.add_argument("--baseline", default=DEFAULT_BASELINE)
+    ap.add_argument("--metric", default="ns_per_bfly")
+    ap.add_argument("--threshold", type=float, default=0.10, help="relative slowdown that counts as a regression")
+    ap.add_argument("--update", action="store_true", help="write the run as the new baseline and exit")
+    args = ap.parse_args()
+
+    context, current = load_run(args.run, args.metric)
+    if args.update:
+        keep = ("host_name", "num_cpus", "mhz_per_cpu", "caches", "library_build_type", "date")
+        out = {
+            "metric": args.metric,
+            "context": {k: context[k] for k in keep if k in context},
+            "benchmarks": dict(sorted(current.items())),
+        }
+        with open(args.baseline, "w") as f:
+            json.dump(out, f, indent=1)
+            f.write("\n")
+        print("wrote %d entries to %s" % (len(current), args.baseline))
+        return 0
+
+    with open(args.baseline) as f:
+        base = json.load(f)
+    if base.get("metric", args.metric) != args.metric:
+        sys.exit("baseline stores %s, not %s" % (base["metric"], args.metric))
+    reference = base["benchmarks"]
+
+    regressions = 0
+    width = max([len(k) for k in current] + [9])
+    print("%-*s %12s %12s %9s" % (width, "benchmark", "baseline", "current", "change"))
+    for name in sorted(current):
+        if name not in reference:
+            print("%-*s %12s %12.4g %9s  new" % (width, name, "-", current[name], ""))
+            continue
+        old, new = reference[name], current[name]
+        change = (new - old) / old if old else 0.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            mark = "  improved"
+        print("%-*s %12.4g %12.4g %+8.1f%%%s" % (width, name, old, new, 100 * change, mark))
+    # a filtered run leaves most of the baseline out; only count those
+    missing = sorted(set(reference) - set(current))
+
+    print("\n%d compared, %d regressions over %.0f%%, %d new, %d missing"
+          % (len(set(current) & set(reference)), regressions, 100 * args.threshold,
+             len(set(current) - set(reference)), len(missing)))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Minimal allocator returning storage aligned to 'Align' bytes, so SIMD
+// kernels can use aligned loads on tables built with it.
+template <class T, size_t Align = 64>
+struct AlignedAllocator {
+    using value_type = T;
+    template <class U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template <class U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(size_t count) {
+        size_t bytes = (count * sizeof(T) + Align - 1) / Align * Align;
+        void* p = std::aligned_alloc(Align, bytes ? bytes : Align);
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t) { std::free(p); }
+
+    template <class U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+    template <class U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+template <class T>
+using aligned_vector = std::vector<T, AlignedAllocator<T, 64>>;
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "ntt_plan.h"
+using u64 = uint64_t;
+
+// Per-host kernel selection for the plan transforms. Which implementation
+// is fastest depends on n and on the microarchitecture, so instead of fixed
+// rules the choices can be measured on the host, kept in a small profile
+// file, and applied to every plan when it is built (registered fixed
+// parameter sets excepted, below):
+//
+//  - avx2:    4-lane kernels or the scalar ones (plan.use_avx2); for width
+//             32 measured on the u32-storage kernels it also selects
+//  - blocked: cache-blocked schedule of ntt_blocked.h or the breadth-first
+//             loops (plan.blocked), and from BLOCKED_MIN_N its shape: tile
+//             of 2^11..2^13 coefficients, 2..4 stages fused per group
+//             (plan.blocked_tile, plan.blocked_group)
+//  - batch_interleave_min: ntt_negacyclic_batch / intt_negacyclic_batch
+//             run batches of at least this many polynomials through the
+//             interleaved kernels of ntt_batch.h; 0 never does
+//
+// Exception: the registered Ntt<Q, LOGN> instances of ntt_fixed.h choose
+// their kernels from the host alone. rns_ntt / rns_intt and the
+// (u64*, n, mod) transforms send registered primes there, so the profile
+// does not affect those parameter sets. A key covers every modulus of its
+// width and cannot time a registered prime apart from the others.
+//
+// Entries are keyed by (log2 n, storage width): width 32 for moduli below
+// 2^31, 64 otherwise. Without an entry a plan gets the built-in defaults
+// (AVX2 when the host has it, blocked from BLOCKED_MIN_N with a 2^12 tile
+// and groups of 4, no interleaving).
+//
+// Profile file (text, one entry per line):
+//   he-tune 2
+//   cpu <brand string>
+//   <log2 n> <width> <avx2> <blocked> <batch_interleave_min> <log2 tile> <group>
+// A profile written on a different CPU model is rejected, so a profile
+// copied to another kind of host is ignored there (and, with HE_TUNE_FILE,
+// replaced by that host's own calibration) rather than misapplied.
+//
+// Setting HE_TUNE_FILE=<path> makes tuning automatic: the first plan built
+// loads the profile, and a plan whose key has no entry is calibrated on the
+// spot (about 50 to 200 ms, up to 0.5 s from BLOCKED_MIN_N where the
+// blocked shape is timed too; batch timings only up to n = 2^14) and the
+// profile rewritten. That happens in the thread building the plan;
+// cached_plan builds outside its lock, so other keys are not held up.
+// Plans built before a profile is loaded keep their settings.
+
+static const unsigned TUNE_FILE_VERSION = 2;
+
+struct TuneChoice {
+    bool avx2 = false;
+    bool blocked = false;
+    size_t batch_interleave_min = 0;
+    size_t blocked_tile = size_t(1) << 12;  // a power of two, at least 64
+    size_t blocked_group = 4;               // at least 1
+};
+
+// Storage width class of a modulus: 32 or 64.
+unsigned tune_width(u64 mod);
+
+// Built-in defaults for (n, mod), then the profile entry if there is one.
+// AVX2 is never enabled on a host without it. NttPlan::init and the
+// plan-file reader call this.
+void tune_apply(NttPlan& plan);
+// The profile entry for (n, mod); false when there is none.
+bool tune_lookup(size_t n, u64 mod, TuneChoice& out);
+// Adds or replaces the entry for (n, mod)'s key.
+void tune_set(size_t n, u64 mod, const TuneChoice& c);
+void tune_clear();
+
+// Times every variant for (n, mod) on this host (mod must support
+// NttPlan(n, mod)), records the fastest with tune_set and returns it.
+TuneChoice tune_calibrate(size_t n, u64 mod);
+
+// Replaces the table with the profile at 'path'. Returns false, leaving the
+// table unchanged, when the file is missing or malformed, has another
+// version, or was written on another CPU model.
+bool tune_load(const char* path);
+// Writes the table, via a temporary renamed over 'path'. False on I/O error.
+bool tune_save(const char* path);
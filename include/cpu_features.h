@@ -7,6 +7,12 @@ static inline bool cpu_has_avx2() {
 #if defined(__x86_64__) || defined(_M_X64) || defined(__i386)
     unsigned int eax, ebx, ecx, edx;
     if (!__get_cpuid_max(0, nullptr)) return false;
+    // the OS must also save YMM state (OSXSAVE + XCR0 bits 1 and 2)
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    if (!(ecx & (1u << 27)) || !(ecx & (1u << 28))) return false;
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0x6) != 0x6) return false;
     if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
     return (ebx & (1 << 5)) != 0; // AVX2 bit in EBX of leaf 7
 #else
@@ -16,3 +22,20 @@ static inline bool cpu_has_avx2() {
 #else
 static inline bool cpu_has_avx2(){ return false; }
 #endif
+
+// cpu_has_avx2() queried once, for dispatch in hot paths.
+static inline bool host_has_avx2() {
+    static const bool has = cpu_has_avx2();
+    return has;
+}
+
+// AVX2 kernels are compiled per function with a target attribute instead of
+// a global -mavx2, so one binary runs on hosts with and without AVX2; callers
+// pick the kernel at runtime with host_has_avx2().
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386))
+#define HE_HAVE_AVX2_KERNELS 1
+#define HE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define HE_HAVE_AVX2_KERNELS 0
+#define HE_TARGET_AVX2
+#endif
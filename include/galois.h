@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "aligned_vector.h"
+using u64 = uint64_t;
+using u32 = uint32_t;
+
+// Galois automorphisms sigma_k : a(X) -> a(X^k) of Z_q[X]/(X^n + 1), for odd
+// k in [1, 2n). Slot rotations use k = 5^step mod 2n and conjugation uses
+// k = 2n - 1.
+//
+// In the coefficient domain, sigma_k sends coefficient i to i*k mod 2n,
+// negated when that wraps past n. In the evaluation domain (the bit-reversed
+// order of ntt_negacyclic) it is a plain index permutation: slot j holds
+// a(psi^{2 bitrev(j) + 1}), and sigma_k a at that point is a at
+// psi^{(2 bitrev(j) + 1) k}, which is another slot. No transform is needed
+// in either domain.
+struct GaloisTable {
+    size_t n = 0;
+    size_t k = 0;
+    // evaluation domain: out[j] = in[ntt_src[j]]
+    aligned_vector<u32> ntt_src;
+    // coefficient domain: out[j] = +-in[coeff_src[j] & ~NEG], negated when
+    // the NEG bit is set
+    static const u32 NEG = u32(1) << 31;
+    aligned_vector<u32> coeff_src;
+    // one index on every cycle of length > 1, for the in-place forms
+    std::vector<u32> ntt_cycles;
+    std::vector<u32> coeff_cycles;
+
+    GaloisTable() = default;
+    // n a power of two below 2^31, k odd and below 2n.
+    GaloisTable(size_t n, size_t k);
+};
+
+// Process-wide table cache keyed by (n, k), like cached_plan. Thread-safe;
+// tables are immutable once built.
+const GaloisTable* cached_galois_table(size_t n, size_t k);
+
+// Galois element of a rotation by 'step' slots: 5^step mod 2n. Negative steps
+// rotate the other way.
+size_t galois_element(size_t n, long long step);
+// Galois element of complex conjugation: 2n - 1.
+size_t galois_conjugate(size_t n);
+
+// Evaluation domain: pure permutation of n values (any range). The in-place
+// form follows the permutation's cycles and needs no scratch.
+void automorphism_ntt(const u64* in, u64* out, size_t n, size_t k);
+void automorphism_ntt(u64* a, size_t n, size_t k);
+// Coefficient domain, residues in [0, mod). The out-of-place form is a
+// 4-lane AVX2 gather with masked negation on hosts that have it. out must not
+// alias in.
+void automorphism_coeff(const u64* in, u64* out, size_t n, size_t k, u64 mod);
+void automorphism_coeff(u64* a, size_t n, size_t k, u64 mod);
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+using u64 = uint64_t;
+using u32 = uint32_t;
+using u128 = __uint128_t;
+
+// Scalar modular helpers; a, b in [0, mod).
+u64 add_mod(u64 a, u64 b, u64 mod);
+u64 sub_mod(u64 a, u64 b, u64 mod);
+u64 mul_mod(u64 a, u64 b, u64 mod);
+
+// Barrett reduction of products of two residues (HAC 14.42 with b = 2):
+// for mod of 'bits' bits and z < mod^2 < 2^(2*bits),
+//   q3 = ((z >> (bits - 1)) * mu) >> (bits + 1),  mu = floor(2^(2*bits) / mod)
+// under-estimates z / mod by at most 2, so z - q3 * mod < 3 * mod and two
+// conditional subtractions finish. Needs mod < 2^62 and no division per
+// product.
+struct Barrett {
+    u64 mod = 0;
+    u64 mu = 0;
+    unsigned bits = 0;
+
+    Barrett() = default;
+    explicit Barrett(u64 m);
+
+    // a * b mod mod for a, b in [0, mod)
+    u64 mul(u64 a, u64 b) const {
+        u128 z = (u128)a * b;
+        u64 q1 = (u64)(z >> (bits - 1));
+        u64 q3 = (u64)(((u128)q1 * mu) >> (bits + 1));
+        u64 r = (u64)z - q3 * mod;
+        if (r >= 2 * mod) r -= 2 * mod;
+        return r >= mod ? r - mod : r;
+    }
+};
+
+// Element-wise ops over arrays of n residues in [0, mod), results fully
+// reduced; out (or acc) may alias any input. mod < 2^62 (u32 forms: mod <
+// 2^31). They run 4-lane (8-lane for u32) AVX2 kernels on hosts that have
+// it and the scalar loops otherwise. Scalar multiplies use a Shoup quotient
+// computed once per call, dyadic ones Barrett.
+void add_mod_array(const u64* a, const u64* b, u64* out, size_t n, u64 mod);
+void sub_mod_array(const u64* a, const u64* b, u64* out, size_t n, u64 mod);
+void negate_mod_array(const u64* a, u64* out, size_t n, u64 mod);
+// out = a * c
+void mul_scalar_mod_array(const u64* a, u64 c, u64* out, size_t n, u64 mod);
+// out = a * b (dyadic / Hadamard product)
+void mul_mod_array(const u64* a, const u64* b, u64* out, size_t n, u64 mod);
+void mul_mod_array(const u32* a, const u32* b, u32* out, size_t n, u32 mod);
+// acc = acc + a * b and acc = acc + a * c
+void fma_mod_array(const u64* a, const u64* b, u64* acc, size_t n, u64 mod);
+void fma_scalar_mod_array(const u64* a, u64 c, u64* acc, size_t n, u64 mod);
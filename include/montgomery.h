@@ -7,12 +7,16 @@ struct Montgomery {
     u64 mod;    // modulus N
     u64 ninv;   // -N^{-1} mod R (R = 2^64)
     u64 rmask;  // mask for R-1 (if R power of two) not used explicitly but kept for clarity
+    u64 r2;     // R^2 mod N, lets to_mont use a Montgomery multiply instead of a division
 
     Montgomery(u64 m=0);
     void init(u64 m);
     u64 to_mont(u64 a) const;
     u64 from_mont(u64 a) const;
     u64 mul(u64 a, u64 b) const;
+    // Montgomery product without the final subtraction: result in [0, 2N).
+    // Valid for a*b < 4N^2 with N < 2^62, e.g. a < 4N and b < N.
+    u64 mul_lazy(u64 a, u64 b) const;
     u64 add(u64 a, u64 b) const;
     u64 sub(u64 a, u64 b) const;
 };
@@ -4,17 +4,71 @@
 #include <vector>
 #include <cstdint>
 #include <cstddef>
+#include "ntt_plan.h"
 using u64 = uint64_t;
+using u32 = uint32_t;
 
+// In-place bit-reversal permutation (n a power of two). Blocked so that it
+// moves whole cache lines; only needed by callers that want natural-order
+// evaluations from ntt_to_bitrev / ntt_negacyclic.
 void bit_reverse_permute(std::vector<u64>& a);
+void bit_reverse_permute(u64* a, size_t n);
 std::vector<u64> compute_roots(u64 root, size_t n, u64 mod);
 void ntt(std::vector<u64>& a, const std::vector<u64>& roots, u64 mod);
 void intt(std::vector<u64>& a, const std::vector<u64>& roots, u64 mod);
 
 void ntt_montgomery(std::vector<u64>& a, const std::vector<u64>& roots, u64 mod);
 
+// Plan-based transforms (see ntt_plan.h). These are the hot-path entry
+// points: build the plan once per (n, mod) and reuse it. They use the AVX2
+// kernels when plan.use_avx2 is set (by default, when the host supports it).
+void ntt(std::vector<u64>& a, const NttPlan& plan);
+void intt(std::vector<u64>& a, const NttPlan& plan);
+void ntt_montgomery(std::vector<u64>& a, const NttPlan& plan);
+// Pointer + length forms of the same, in place on caller memory (any
+// buffer of n == plan.n coefficients; 64-byte alignment helps the SIMD
+// kernels but is not required). Every plan transform below has one.
+void ntt(u64* a, size_t n, const NttPlan& plan);
+void intt(u64* a, size_t n, const NttPlan& plan);
+void ntt_montgomery(u64* a, size_t n, const NttPlan& plan);
+
+// Cyclic transform pair without bit_reverse_permute, for convolutions where
+// the order of the evaluations does not matter (pointwise products).
+// ntt_to_bitrev: natural-order coefficients -> evaluations in bit-reversed
+// order, fully reduced (ntt_to_bitrev followed by bit_reverse_permute equals
+// ntt). intt_from_bitrev: bit-reversed evaluations (each < 2*mod) -> natural
+// coefficients, scaled by n^{-1}.
+void ntt_to_bitrev(std::vector<u64>& a, const NttPlan& plan);
+void intt_from_bitrev(std::vector<u64>& a, const NttPlan& plan);
+void ntt_to_bitrev(u64* a, size_t n, const NttPlan& plan);
+void intt_from_bitrev(u64* a, size_t n, const NttPlan& plan);
+
+// Negacyclic transforms over Z_q[X]/(X^n + 1) (requires plan.has_negacyclic()).
+// Forward: natural-order coefficients -> evaluations in bit-reversed order.
+// Inverse: bit-reversed evaluations (each < 2*mod) -> natural coefficients.
+// A ring product is ntt_negacyclic on both operands, a pointwise product and
+// intt_negacyclic; no padding, scaling pass or permutation is needed.
+void ntt_negacyclic(std::vector<u64>& a, const NttPlan& plan);
+void intt_negacyclic(std::vector<u64>& a, const NttPlan& plan);
+void ntt_negacyclic(u64* a, size_t n, const NttPlan& plan);
+void intt_negacyclic(u64* a, size_t n, const NttPlan& plan);
+
+// 32-bit storage variants for plans with plan.narrow (mod < 2^31): same
+// orders and semantics as the u64 versions, except that every input must be
+// fully reduced (< mod). 8-lane AVX2 when plan.use_avx2.
+void ntt_to_bitrev(std::vector<u32>& a, const NttPlan& plan);
+void intt_from_bitrev(std::vector<u32>& a, const NttPlan& plan);
+void ntt_to_bitrev(u32* a, size_t n, const NttPlan& plan);
+void intt_from_bitrev(u32* a, size_t n, const NttPlan& plan);
+void ntt_negacyclic(std::vector<u32>& a, const NttPlan& plan);
+void intt_negacyclic(std::vector<u32>& a, const NttPlan& plan);
+void ntt_negacyclic(u32* a, size_t n, const NttPlan& plan);
+void intt_negacyclic(u32* a, size_t n, const NttPlan& plan);
+
 void ntt_montgomery_core(std::vector<u64>& a, const std::vector<u64>& mroots, u64 mod);
+void ntt_montgomery_core(u64* a, size_t n, const u64* mroots, u64 mod);
 
-#ifdef __AVX2__
+// 4-lane AVX2 version of ntt_montgomery_core; falls back to the scalar core
+// at runtime on hosts without AVX2 (see ntt_simd.h).
 void ntt_avx2_core(std::vector<u64>& a, const std::vector<u64>& mroots, u64 mod);
-#endif
+void ntt_avx2_core(u64* a, size_t n, const u64* mroots, u64 mod);
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "ntt_plan.h"
+using u64 = uint64_t;
+
+// Batched transforms: many polynomials with the same (n, q) at once, e.g.
+// every limb of a batch of ciphertexts.
+//
+// Interleaved layout: polynomials are taken in groups of NTT_BATCH_LANES,
+// and within a group coefficient j of polynomials 0..3 is stored adjacently:
+//
+//   a[(g * n + j) * NTT_BATCH_LANES + l] = coefficient j of polynomial
+//                                          g * NTT_BATCH_LANES + l
+//
+// so every butterfly of every stage is one 4-lane vector op across four
+// polynomials with a broadcast twiddle; the short stages (t < 4) that the
+// single-polynomial kernels leave to scalar code are vectorized too. The
+// evaluations of each polynomial end up in the same (bit-reversed) order as
+// with the single-polynomial transforms, and pointwise ops need no change
+// since they are element-wise.
+static const size_t NTT_BATCH_LANES = 4;
+
+// Words needed for 'count' polynomials in interleaved layout (the last
+// group is padded to NTT_BATCH_LANES polynomials).
+static inline size_t batch_interleaved_words(size_t count, size_t n) {
+    return (count + NTT_BATCH_LANES - 1) / NTT_BATCH_LANES * NTT_BATCH_LANES * n;
+}
+
+// Contiguous (a[i * n + j]) <-> interleaved. Padding lanes are zeroed on
+// interleave and ignored on deinterleave.
+void batch_interleave(const u64* in, size_t count, size_t n, u64* out);
+void batch_deinterleave(const u64* in, size_t count, size_t n, u64* out);
+// Same with polynomial p at in[p] / out[p] (separately owned buffers).
+void batch_interleave(const u64* const* in, size_t count, size_t n, u64* out);
+void batch_deinterleave(const u64* in, size_t count, size_t n, u64* const* out);
+
+// In-place transforms of 'groups' interleaved groups (4 * groups
+// polynomials), same semantics per polynomial as ntt_negacyclic /
+// intt_negacyclic and ntt_to_bitrev / intt_from_bitrev.
+void ntt_negacyclic_interleaved(u64* a, size_t groups, const NttPlan& plan);
+void intt_negacyclic_interleaved(u64* a, size_t groups, const NttPlan& plan);
+void ntt_to_bitrev_interleaved(u64* a, size_t groups, const NttPlan& plan);
+void intt_from_bitrev_interleaved(u64* a, size_t groups, const NttPlan& plan);
+
+// 'count' polynomials stored back to back (a[i * n + j]), on the calling
+// thread; see ntt_parallel.h for the pool versions. From
+// plan.batch_interleave_min polynomials on (set by the host's tuning
+// profile, autotune.h), whole groups go through a temporary interleaved copy
+// and the interleaved kernels; otherwise they run one after another.
+void ntt_negacyclic_batch(u64* a, size_t count, const NttPlan& plan);
+void intt_negacyclic_batch(u64* a, size_t count, const NttPlan& plan);
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+using u64 = uint64_t;
+using u128 = __uint128_t;
+
+// Compile-time specialized negacyclic transforms for fixed (q, n).
+//
+// Ntt<Q, LOGN> derives psi, n^{-1} and the psi-merged twiddle tables (with
+// Shoup quotients) at compile time, using the same root choice as
+// NttPlan(n, q), so its output is bit-for-bit that of ntt_negacyclic /
+// intt_negacyclic with a plan. Its kernels see n, q and every stage's
+// stride as constants: stage loops are unrolled by template recursion, the
+// last two forward (first two inverse) stages are vectorized with in-register
+// shuffles instead of running scalar, and the final reduction is fused into
+// the last stage.
+//
+// forward/inverse are compiled into the library only for the parameter sets
+// registered in src/ntt_fixed.cpp; find_fixed_ntt maps runtime (n, q) onto
+// those, and the (u64*, n, mod) overloads below fall back to cached_plan for
+// everything else. These kernels pick AVX2 from the host alone; the
+// autotune profile (autotune.h) does not apply to them.
+
+constexpr u64 ce_mul_mod(u64 a, u64 b, u64 mod) {
+    return (u64)((u128)a * b % mod);
+}
+
+constexpr u64 ce_pow_mod(u64 a, u64 e, u64 mod) {
+    u64 r = 1;
+    a %= mod;
+    while (e) {
+        if (e & 1) r = ce_mul_mod(r, a, mod);
+        a = ce_mul_mod(a, a, mod);
+        e >>= 1;
+    }
+    return r;
+}
+
+// Same rule as find_root_of_unity: g^{(mod-1)/order}, g the smallest
+// quadratic non-residue; 0 if order does not divide mod - 1.
+constexpr u64 ce_root_of_unity(u64 order, u64 mod) {
+    if (order == 0 || (mod - 1) % order != 0) return 0;
+    u64 g = 2;
+    while (ce_pow_mod(g, (mod - 1) / 2, mod) != mod - 1) ++g;
+    return ce_pow_mod(g, (mod - 1) / order, mod);
+}
+
+constexpr u64 ce_shoup(u64 w, u64 mod) {
+    return (u64)(((u128)w << 64) / mod);
+}
+
+constexpr size_t ce_bitrev(size_t x, unsigned bits) {
+    size_t r = 0;
+    for (unsigned b = 0; b < bits; ++b) r |= ((x >> b) & 1) << (bits - 1 - b);
+    return r;
+}
+
+template <u64 Q, unsigned LOGN>
+struct Ntt {
+    static_assert(Q < (u64(1) << 62), "lazy butterflies need q < 2^62");
+    static_assert(LOGN >= 3, "the shuffled short stages need n >= 8");
+    static_assert((Q - 1) % (u64(2) << LOGN) == 0, "q must be 1 mod 2n");
+
+    static constexpr size_t n = size_t(1) << LOGN;
+    static constexpr u64 mod = Q;
+    static constexpr u64 psi = ce_root_of_unity(2 * n, Q);
+    static constexpr u64 psi_inv = ce_pow_mod(psi, 2 * n - 1, Q);
+    static constexpr u64 n_inv = ce_pow_mod(n % Q, Q - 2, Q);
+    static constexpr u64 n_inv_shoup = ce_shoup(n_inv, Q);
+
+    // Same [m + i] layout as NttPlan::nega_fwd_tw / nega_inv_tw.
+    struct alignas(64) Tables {
+        u64 fwd[n];
+        u64 fwd_shoup[n];
+        u64 inv[n];
+        u64 inv_shoup[n];
+        u64 inv_last;        // inv[1] * n^{-1}, last inverse stage
+        u64 inv_last_shoup;
+    };
+
+    static constexpr Tables make_tables() {
+        Tables t{};
+        u64 p = 1, pi = 1;
+        for (size_t k = 0; k < n; ++k) {
+            size_t r = ce_bitrev(k, LOGN);
+            t.fwd[r] = p;
+            t.inv[r] = pi;
+            p = ce_mul_mod(p, psi, Q);
+            pi = ce_mul_mod(pi, psi_inv, Q);
+        }
+        for (size_t k = 0; k < n; ++k) {
+            t.fwd_shoup[k] = ce_shoup(t.fwd[k], Q);
+            t.inv_shoup[k] = ce_shoup(t.inv[k], Q);
+        }
+        t.inv_last = ce_mul_mod(t.inv[1], n_inv, Q);
+        t.inv_last_shoup = ce_shoup(t.inv_last, Q);
+        return t;
+    }
+
+    static constexpr Tables tables = make_tables();
+
+    // In place on n coefficients: natural -> bit-reversed evaluations and
+    // back, outputs in [0, q); inverse inputs must be below 2q.
+    static void forward(u64* a);
+    static void inverse(u64* a);
+};
+
+// Registry entry for one compiled-in Ntt<Q, LOGN>.
+struct FixedNtt {
+    size_t n;
+    u64 mod;
+    void (*forward)(u64*);
+    void (*inverse)(u64*);
+};
+
+// The specialized instance for (n, mod), or nullptr if none is registered.
+const FixedNtt* find_fixed_ntt(size_t n, u64 mod);
+
+// Negacyclic transforms selected by runtime parameters: the specialized
+// instance when (n, mod) is registered, otherwise the generic kernels with
+// cached_plan(n, mod) (which must exist).
+void ntt_negacyclic(u64* a, size_t n, u64 mod);
+void intt_negacyclic(u64* a, size_t n, u64 mod);
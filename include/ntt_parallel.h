@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "ntt_plan.h"
+#include "thread_pool.h"
+using u64 = uint64_t;
+
+// Multi-threaded negacyclic transforms on a caller-owned ThreadPool. The
+// thread count is the pool's size(); results are bit-for-bit those of the
+// single-threaded ntt_negacyclic / intt_negacyclic, since every butterfly is
+// computed by the same kernel and only the assignment to threads changes.
+
+// One transform split across the pool. The first log2(P) stages are divided
+// into P butterfly ranges with a barrier after each stage; after that the P
+// sub-blocks are independent and each is finished by one task. Falls back to
+// the serial transform for small n or a one-thread pool.
+void ntt_negacyclic(u64* a, size_t n, const NttPlan& plan, ThreadPool& pool);
+void intt_negacyclic(u64* a, size_t n, const NttPlan& plan, ThreadPool& pool);
+void ntt_negacyclic(std::vector<u64>& a, const NttPlan& plan, ThreadPool& pool);
+void intt_negacyclic(std::vector<u64>& a, const NttPlan& plan, ThreadPool& pool);
+
+// 'count' independent transforms of plan.n coefficients stored back to back
+// (a[i * plan.n + j]); one task per polynomial.
+void ntt_negacyclic_batch(u64* a, size_t count, const NttPlan& plan, ThreadPool& pool);
+void intt_negacyclic_batch(u64* a, size_t count, const NttPlan& plan, ThreadPool& pool);
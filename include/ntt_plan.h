@@ -0,0 +1,140 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include "montgomery.h"
+#include "aligned_vector.h"
+using u64 = uint64_t;
+using u32 = uint32_t;
+
+// Storage for one NttPlan table: either owned (an aligned vector, filled by
+// NttPlan::init) or a read-only view of memory that outlives the plan, such
+// as a mapped plan file (plan_file.h). Copying a view copies the pointer.
+template <class T>
+class PlanTable {
+public:
+    const T* data() const { return view_ ? view_ : own_.data(); }
+    size_t size() const { return view_ ? view_size_ : own_.size(); }
+    bool empty() const { return size() == 0; }
+    bool is_view() const { return view_ != nullptr; }
+    const T& operator[](size_t i) const { return data()[i]; }
+    T& operator[](size_t i) {
+        assert(!view_);
+        return own_[i];
+    }
+    void assign(size_t count, T value) {
+        view_ = nullptr;
+        view_size_ = 0;
+        own_.assign(count, value);
+    }
+    void clear() { assign(0, T()); }
+    void set_view(const T* p, size_t count) {
+        own_ = aligned_vector<T>();
+        view_ = p;
+        view_size_ = count;
+    }
+
+private:
+    aligned_vector<T> own_;
+    const T* view_ = nullptr;
+    size_t view_size_ = 0;
+};
+
+// Precomputed state for one (n, mod, root) parameter set.
+// Build it once and reuse it: the transforms that take a plan do no
+// allocation and no root arithmetic per call.
+// The lazy kernels keep values in [0, 4*mod), so mod must be below 2^62.
+struct NttPlan {
+    size_t n = 0;
+    unsigned log_n = 0;
+    u64 mod = 0;
+    u64 root = 0;        // primitive n-th root of unity
+    u64 psi = 0;         // primitive 2n-th root (0 if 2n does not divide mod-1)
+    u64 n_inv = 0;       // n^{-1} mod mod
+    u64 n_inv_mont = 0;  // n^{-1} in Montgomery form
+    u64 n_inv_shoup = 0; // Shoup quotient of n_inv
+    Montgomery mont;
+    // Kernel selection, set at init by tune_apply (autotune.h): AVX2 when
+    // the host has it, the cache-blocked schedule from BLOCKED_MIN_N and no
+    // batch interleaving, unless the host's tuning profile says otherwise.
+    bool use_avx2 = false;
+    bool blocked = false;
+    size_t blocked_tile = size_t(1) << 12;  // shape of the blocked schedule:
+    size_t blocked_group = 4;               // tile size, stages fused per group
+    size_t batch_interleave_min = 0;  // see ntt_negacyclic_batch
+
+    // Stage-ordered twiddles: entry [len + j] is root^{(n / (2*len)) * j},
+    // so the layer with half-size len reads tw[len .. 2*len) contiguously.
+    // Entry 0 is unused. Tables are 64-byte aligned for the AVX2 kernels.
+    PlanTable<u64> fwd_tw;
+    PlanTable<u64> inv_tw;
+    PlanTable<u64> fwd_tw_mont;  // fwd_tw in Montgomery form
+    // Shoup quotients floor(w * 2^64 / mod) matching fwd_tw / inv_tw.
+    PlanTable<u64> fwd_tw_shoup;
+    PlanTable<u64> inv_tw_shoup;
+
+    // Cyclic tables for the permutation-free pair ntt_to_bitrev /
+    // intt_from_bitrev, in the same [m + i] layout as the negacyclic ones:
+    // block i of the stage with m blocks uses root^{(n / 2m) * bitrev(i)}
+    // (bitrev over log2(m) bits), and its inverse.
+    PlanTable<u64> br_fwd_tw;
+    PlanTable<u64> br_fwd_tw_shoup;
+    PlanTable<u64> br_inv_tw;
+    PlanTable<u64> br_inv_tw_shoup;
+
+    // Negacyclic tables (Z_q[X]/(X^n+1)), filled only when psi exists.
+    // nega_fwd_tw[k] = psi^{bitrev(k)}, nega_inv_tw[k] = psi^{-bitrev(k)},
+    // indexed [m + i] for block i of the stage with m blocks.
+    PlanTable<u64> nega_fwd_tw;
+    PlanTable<u64> nega_fwd_tw_shoup;
+    PlanTable<u64> nega_inv_tw;
+    PlanTable<u64> nega_inv_tw_shoup;
+    u64 nega_inv_last = 0;        // nega_inv_tw[1] * n^{-1}, last inverse layer
+    u64 nega_inv_last_shoup = 0;
+
+    // 32-bit path, set up when mod < 2^31: u32 copies of the br_* and nega_*
+    // tables with 32-bit Shoup quotients, used by the u32 overloads in ntt.h
+    // (half the memory traffic, 8 SIMD lanes instead of 4).
+    bool narrow = false;
+    PlanTable<u32> br_fwd_tw32;
+    PlanTable<u32> br_fwd_tw32_shoup;
+    PlanTable<u32> br_inv_tw32;
+    PlanTable<u32> br_inv_tw32_shoup;
+    PlanTable<u32> nega_fwd_tw32;
+    PlanTable<u32> nega_fwd_tw32_shoup;
+    PlanTable<u32> nega_inv_tw32;
+    PlanTable<u32> nega_inv_tw32_shoup;
+    u32 n_inv32_shoup = 0;
+    u32 nega_inv_last32_shoup = 0;
+
+    NttPlan() = default;
+    // Roots chosen automatically: psi = g^{(mod-1)/2n} for the smallest
+    // quadratic non-residue g, root = psi^2 (or g^{(mod-1)/n} if no psi).
+    NttPlan(size_t n, u64 mod);
+    NttPlan(size_t n, u64 mod, u64 root);
+    void init(size_t n, u64 mod, u64 root);
+
+    bool has_negacyclic() const { return psi != 0; }
+};
+
+// Primitive 'order'-th root of unity mod a prime, for power-of-two 'order':
+// g^{(mod-1)/order} with g the smallest quadratic non-residue. Returns 0 if
+// order does not divide mod-1. Deterministic, so plans built independently
+// for the same (n, mod) agree.
+u64 find_root_of_unity(size_t order, u64 mod);
+
+// Process-wide plan cache keyed by (n, mod), built with NttPlan(n, mod) on
+// first use and kept for the life of the process. Returns nullptr when mod
+// has no primitive n-th root of unity (or is not a usable prime).
+// Thread-safe; the returned plan is immutable. preload_plan_file
+// (plan_file.h) fills it from disk instead.
+const NttPlan* cached_plan(size_t n, u64 mod);
+
+// Deterministic Miller-Rabin, exact for all 64-bit inputs.
+bool is_prime_u64(u64 x);
+
+// The 'count' largest primes below 2^bits with p = 1 (mod 2n), i.e. primes
+// that support negacyclic transforms of size n, in descending order.
+// bits must be at most 62.
+std::vector<u64> generate_ntt_primes(unsigned bits, size_t count, size_t n);
@@ -2,8 +2,51 @@
 #pragma once
 #include <vector>
 #include <cstdint>
+#include <cstddef>
 using u64 = uint64_t;
+using u32 = uint32_t;
 
-#ifdef __AVX2__
+// AVX2 kernels. They are always declared and always linked; on hosts (or
+// compilers) without AVX2 they fall back to the scalar code, so callers only
+// need cpu_has_avx2() to decide whether calling them is worthwhile.
+
+// Montgomery-domain transform matching ntt_montgomery_core: bit-reverses,
+// runs 4-lane lazy Montgomery butterflies and returns values in [0, mod).
 void ntt_avx2_core(std::vector<u64>& a, const std::vector<u64>& mroots, u64 mod);
-#endif
+void ntt_avx2_core(u64* a, size_t n, const u64* mroots, u64 mod);
+
+// Harvey DIT layers over bit-reversed input with stage-ordered Shoup
+// twiddles (tw[len + j], tws[len + j]); values stay in [0, 4*mod).
+void dit_layers_shoup_avx2(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod);
+
+// Negacyclic-style Cooley-Tukey (natural -> bit-reversed, [0, 4q) out) and
+// Gentleman-Sande (bit-reversed -> natural, n^{-1} folded into the last
+// stage, [0, q) out) over bit-reversed twiddle tables tw[m + i].
+void ct_forward_shoup_avx2(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod);
+void gs_inverse_shoup_avx2(u64* a, size_t n, const u64* tw, const u64* tws,
+                           u64 last_w, u64 last_ws, u64 n_inv, u64 n_inv_shoup, u64 mod);
+
+// Single stages restricted to butterflies [k0, k1) (see ntt_kernels.h), the
+// final folded GS stage restricted to j in [j0, j1), and a run of cnt DIT
+// butterflies (x[j], x[j + len]) with twiddles w[j]; building blocks for the
+// multi-threaded (ntt_parallel.cpp) and cache-blocked (ntt_blocked.cpp)
+// transforms.
+void dit_run_shoup_avx2(u64* x, size_t len, const u64* w, const u64* ws, size_t cnt, u64 mod);
+void ct_stage_shoup_range_avx2(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                               const u64* tw, const u64* tws, u64 mod);
+void gs_stage_shoup_range_avx2(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                               const u64* tw, const u64* tws, u64 mod);
+void gs_last_stage_shoup_range_avx2(u64* a, size_t n, size_t j0, size_t j1, u64 last_w, u64 last_ws,
+                                    u64 n_inv, u64 n_inv_shoup, u64 mod);
+
+// a[i] <- a[i] mod q for a[i] in [0, 4q).
+void reduce_4q_avx2(u64* a, size_t n, u64 mod);
+
+// a[i] <- a[i] * w mod q (fully reduced), Shoup quotient wp, any a[i].
+void mul_scalar_shoup_avx2(u64* a, size_t n, u64 w, u64 wp, u64 mod);
+
+// 32-bit path (mod < 2^31): the CT/GS pair on u32 coefficients with 8-lane
+// Shoup butterflies. Values stay in [0, mod); inputs must be in [0, mod).
+void ct_forward_shoup32_avx2(u32* a, size_t n, const u32* tw, const u32* tws, u32 mod);
+void gs_inverse_shoup32_avx2(u32* a, size_t n, const u32* tw, const u32* tws,
+                             u32 last_w, u32 last_ws, u32 n_inv, u32 n_inv_shoup, u32 mod);
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "ntt_plan.h"
+using u64 = uint64_t;
+using u32 = uint32_t;
+
+// Precomputed NttPlan tables on disk, so that processes start without
+// recomputing roots and Shoup quotients. Plans read from the file view the
+// tables in place: the file is mapped read-only and shared, so every process
+// on a host uses the same page-cache copy, and loading a plan costs O(1)
+// whatever its size.
+//
+// Format (native byte order, all offsets from the start of the file):
+//   header     64 bytes: magic "HEPLANS\0", version, byte-order mark, entry count
+//   directory  one 128-byte PlanFileEntry per plan
+//   tables     per entry, in NttPlan member order, each n values starting on
+//              a 64-byte boundary; negacyclic tables only when psi != 0,
+//              u32 tables only when the plan is narrow
+// A reader rejects files with another version or byte order; regenerate
+// them with he_plan_gen (tools/he_plan_gen.cpp) after upgrading. It also
+// rejects entries whose modulus is even or below 3 or whose roots are not
+// reduced.
+
+static const u32 PLAN_FILE_VERSION = 1;
+
+// Writes NttPlan(n, mod) for each (n, mod) pair (or the given plans). The
+// file is written next to 'path' and renamed into place, so readers never
+// map a partial file. Returns false on I/O errors.
+bool write_plan_file(const char* path, const std::vector<std::pair<size_t, u64>>& params);
+bool write_plan_file(const char* path, const std::vector<const NttPlan*>& plans);
+
+// Read-only mapping of a plan file.
+class PlanFile {
+public:
+    PlanFile() = default;
+    ~PlanFile();
+    PlanFile(const PlanFile&) = delete;
+    PlanFile& operator=(const PlanFile&) = delete;
+
+    // Maps 'path'. Returns false, leaving the object closed, when the file is
+    // missing or unreadable, has the wrong magic, version or byte order, or
+    // is shorter than its directory says.
+    bool open(const char* path);
+    void close();
+    bool is_open() const { return base_ != nullptr; }
+
+    size_t size() const { return count_; }
+    size_t n(size_t i) const;
+    u64 mod(size_t i) const;
+    // Index of the plan for (n, mod), or size() when the file has none.
+    size_t find(size_t n, u64 mod) const;
+    // Plan i with its tables viewing the mapping; valid while this stays open.
+    void get(size_t i, NttPlan& out) const;
+
+private:
+    const unsigned char* base_ = nullptr;
+    size_t bytes_ = 0;
+    size_t count_ = 0;
+};
+
+// Maps 'path' for the rest of the process and adds its plans to the
+// cached_plan cache, where RnsBase also finds them; (n, mod) pairs already
+// cached are left alone, and a file that adds none is unmapped again.
+// Returns the number of plans added (0 when the file cannot be used, in
+// which case plans are built as usual).
+size_t preload_plan_file(const char* path);
@@ -4,4 +4,24 @@
 #include <cstdint>
 using u64 = uint64_t;
 
+#include "ntt_plan.h"
+
 std::vector<u64> poly_mul_naive(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod);
+
+// Full product in Z_q[X] (length A.size() + B.size() - 1, empty if either
+// operand is empty) for any mod < 2^62 and coefficients in [0, mod).
+// poly_mul picks schoolbook, Karatsuba or NTT convolution by operand size;
+// the individual algorithms are exposed for testing and benchmarking.
+// poly_mul_ntt needs a prime mod with a 2^k-th root of unity for the padded
+// length and falls back to Karatsuba otherwise.
+std::vector<u64> poly_mul(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod);
+std::vector<u64> poly_mul_schoolbook(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod);
+std::vector<u64> poly_mul_karatsuba(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod);
+std::vector<u64> poly_mul_ntt(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod);
+
+// Product in Z_q[X]/(X^n + 1) via the negacyclic transforms; A and B have
+// plan.n coefficients in [0, mod).
+std::vector<u64> poly_mul_negacyclic(const std::vector<u64>& A, const std::vector<u64>& B, const NttPlan& plan);
+// Same on caller memory: A, B and out hold plan.n coefficients, tmp is
+// plan.n words of scratch. out may alias A or B. Allocates nothing.
+void poly_mul_negacyclic(const u64* A, const u64* B, u64* out, u64* tmp, const NttPlan& plan);
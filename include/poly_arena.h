@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using u64 = uint64_t;
+
+// Recycling pool of 64-byte aligned u64 buffers for polynomials and RNS
+// limb sets, meant to be paired with the pointer + length transforms.
+//
+// Storage is carved from large slabs. A released buffer goes on a free list
+// for its size (linked through its first word), and the next acquire of
+// that size pops it, so once the pool has seen the working set acquire and
+// release are a few loads and stores with no malloc. Sizes are rounded up
+// to whole cache lines; requests larger than a slab get a slab of their
+// own, leaving the current slab in use. Memory returns to the system only
+// when the arena is destroyed.
+// Not thread-safe: use one arena per thread.
+class PolyArena {
+public:
+    explicit PolyArena(size_t slab_words = size_t(1) << 20);
+    ~PolyArena();
+    PolyArena(const PolyArena&) = delete;
+    PolyArena& operator=(const PolyArena&) = delete;
+
+    // Uninitialized, 64-byte aligned buffer of at least 'words' u64.
+    u64* acquire(size_t words);
+    // Return a buffer from acquire(words); 'words' must match.
+    void release(u64* p, size_t words);
+
+    size_t slab_count() const { return slabs_.size(); }
+    size_t reserved_bytes() const { return reserved_words_ * sizeof(u64); }
+
+private:
+    struct FreeList {
+        size_t words;
+        u64* head;
+    };
+
+    u64* new_slab(size_t words);
+
+    std::vector<u64*> slabs_;
+    std::vector<FreeList> free_;  // one per size class seen, searched linearly
+    size_t slab_words_;
+    u64* cur_ = nullptr;          // bump pointer into the newest slab
+    size_t left_ = 0;
+    size_t reserved_words_ = 0;
+};
+
+// Move-only owner of one arena buffer; releases it on destruction.
+class PolyBuf {
+public:
+    PolyBuf() = default;
+    PolyBuf(PolyArena& arena, size_t words) : arena_(&arena), p_(arena.acquire(words)), words_(words) {}
+    ~PolyBuf() { reset(); }
+    PolyBuf(PolyBuf&& o) noexcept : arena_(o.arena_), p_(o.p_), words_(o.words_) { o.p_ = nullptr; }
+    PolyBuf& operator=(PolyBuf&& o) noexcept {
+        if (this != &o) {
+            reset();
+            arena_ = o.arena_;
+            p_ = o.p_;
+            words_ = o.words_;
+            o.p_ = nullptr;
+        }
+        return *this;
+    }
+    PolyBuf(const PolyBuf&) = delete;
+    PolyBuf& operator=(const PolyBuf&) = delete;
+
+    u64* data() { return p_; }
+    const u64* data() const { return p_; }
+    size_t size() const { return words_; }
+    u64& operator[](size_t i) { return p_[i]; }
+    const u64& operator[](size_t i) const { return p_[i]; }
+
+    void reset() {
+        if (p_) arena_->release(p_, words_);
+        p_ = nullptr;
+    }
+
+private:
+    PolyArena* arena_ = nullptr;
+    u64* p_ = nullptr;
+    size_t words_ = 0;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ntt_plan.h"
+#include "aligned_vector.h"
+using u64 = uint64_t;
+
+// Asynchronous execution of per-polynomial operation chains, so that a
+// request thread does not block on its transforms and the steps of many
+// requests overlap on a fixed set of workers.
+//
+// A job owns one polynomial of plan.n coefficients and a program of steps
+// (negacyclic forward / inverse transform, pointwise product, sum or
+// difference with a shared operand) applied in order; submit returns a
+// future for the final coefficients. Scheduling:
+//
+//  - each worker takes the job at the front of the ready queue and runs its
+//    next step; a job that has more steps goes back to the front, so jobs
+//    already started finish before new ones begin;
+//  - a transform step takes along up to max_batch - 1 other ready jobs
+//    whose next step is the same transform on the same plan, and runs them
+//    back to back (through the interleaved batch kernels when the plan's
+//    tuning, plan.batch_interleave_min, asks for it at that count);
+//  - at most max_pending jobs are in flight: submit blocks and try_submit
+//    fails while the queue is full;
+//  - a step that throws (e.g. bad_alloc) completes every job it was run
+//    for with that exception, through the futures.
+
+enum PolyStepKind : unsigned {
+    STEP_NTT,  // ntt_negacyclic: coefficients -> evaluations
+    STEP_INTT, // intt_negacyclic
+    STEP_MUL,  // a = a * operand (pointwise)
+    STEP_ADD,  // a = a + operand
+    STEP_SUB,  // a = a - operand
+};
+
+// 'operand' (STEP_MUL / ADD / SUB only) holds plan.n residues in [0, mod)
+// and is shared, e.g. one key by many jobs; it must not change while jobs
+// use it.
+struct PolyStep {
+    PolyStepKind kind;
+    std::shared_ptr<const aligned_vector<u64>> operand;
+};
+
+using PolyFuture = std::future<aligned_vector<u64>>;
+
+class PolyQueue {
+public:
+    // 'workers' threads (0: std::thread::hardware_concurrency()).
+    explicit PolyQueue(size_t workers = 0, size_t max_pending = 256, size_t max_batch = 16);
+    // Runs every job already submitted, then stops the workers.
+    ~PolyQueue();
+    PolyQueue(const PolyQueue&) = delete;
+    PolyQueue& operator=(const PolyQueue&) = delete;
+
+    // 'data' holds plan.n residues in [0, mod); 'plan' must have negacyclic
+    // tables and outlive the job (cached_plan and RnsBase plans do).
+    PolyFuture submit(aligned_vector<u64> data, const NttPlan& plan, std::vector<PolyStep> steps);
+    // Same without blocking: false (and 'data' left alone) when full.
+    bool try_submit(aligned_vector<u64>& data, const NttPlan& plan, std::vector<PolyStep>& steps, PolyFuture& out);
+
+    // Blocks until every submitted job has completed.
+    void wait_idle();
+    size_t pending() const;
+    size_t workers() const { return workers_.size(); }
+
+private:
+    struct Job {
+        aligned_vector<u64> data;
+        const NttPlan* plan;
+        std::vector<PolyStep> steps;
+        size_t next = 0;
+        std::promise<aligned_vector<u64>> done;
+    };
+
+    PolyFuture enqueue(aligned_vector<u64>& data, const NttPlan& plan, std::vector<PolyStep>& steps);
+    void worker_loop();
+    void run_step(std::vector<std::unique_ptr<Job>>& batch, aligned_vector<u64>& scratch);
+
+    const size_t max_pending_, max_batch_;
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_;   // ready jobs or stop
+    std::condition_variable space_;  // in-flight count dropped
+    std::condition_variable idle_;   // nothing in flight
+    std::deque<std::unique_ptr<Job>> ready_;
+    size_t in_flight_ = 0;
+    bool stop_ = false;
+};
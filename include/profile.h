@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+using u64 = uint64_t;
+
+// Opt-in instrumentation of the transform hot paths. Build with HE_PROFILE=1
+// (CMake: -DHE_PROFILE=ON) to compile the probes in; otherwise every
+// HE_PROF_* macro expands to nothing and the query functions below report
+// no data.
+//
+// Each probe adds its wall time and a call to its stage. Probes nest: an
+// entry point includes its phases, and butterflies include their layers.
+// With counters enabled (profile_set_counters, or HE_PROFILE_COUNTERS=1 in
+// the environment) every probe also reads cycles, instructions and cache
+// misses through perf_event_open on Linux. That read is a system call per
+// probe edge, so use counters on large transforms.
+//
+// Layers are numbered in execution order (layer 0 runs first). They are
+// recorded by the scalar and AVX2 64-bit drivers; a radix-4 pass counts
+// under the first of its two layers. The cache-blocked, fixed,
+// interleaved and 32-bit kernels mix or fuse layers, so they report only
+// their phase.
+
+static const unsigned PROF_MAX_LAYERS = 32;
+
+enum ProfStage : unsigned {
+    // entry points
+    PROF_NTT,                 // ntt (root vector or plan)
+    PROF_INTT,
+    PROF_NTT_MONTGOMERY,
+    PROF_NTT_TO_BITREV,       // u64 and u32
+    PROF_INTT_FROM_BITREV,
+    PROF_NTT_NEGACYCLIC,      // u64, u32 and Ntt<Q, LOGN>
+    PROF_INTT_NEGACYCLIC,
+    // phases
+    PROF_BIT_REVERSE,         // bit_reverse_permute
+    PROF_TO_MONT,
+    PROF_FROM_MONT,
+    PROF_BUTTERFLIES,         // all layers of one transform
+    PROF_FINAL_REDUCE,        // [0, 4q) -> [0, q) pass
+    PROF_SCALE,               // separate n^{-1} pass (cyclic inverse)
+    // butterfly layers 0..PROF_MAX_LAYERS-1
+    PROF_LAYER_0,
+    PROF_STAGE_COUNT = PROF_LAYER_0 + PROF_MAX_LAYERS
+};
+
+struct ProfileStats {
+    const char* stage;   // "ntt", "bit_reverse", "layer 3", ...
+    u64 calls = 0;
+    u64 ns = 0;          // wall time, summed over calls
+    // perf_event_open counts, 0 when counters were off or unavailable
+    u64 cycles = 0;
+    u64 instructions = 0;
+    u64 cache_misses = 0;
+};
+
+// true when the library was built with HE_PROFILE
+bool profile_compiled_in();
+// Stages with at least one call, in ProfStage order.
+std::vector<ProfileStats> profile_stats();
+void profile_reset();
+// Turns hardware counters on or off for all threads; returns whether they
+// are on (false when perf_event_open is refused, e.g. by
+// perf_event_paranoid, or off Linux).
+bool profile_set_counters(bool on);
+// Table of profile_stats() with per-call averages.
+void profile_dump(FILE* out);
+
+#if HE_PROFILE
+// RAII probe; use the macros below.
+class ProfScope {
+public:
+    explicit ProfScope(unsigned stage);
+    ~ProfScope();
+    ProfScope(const ProfScope&) = delete;
+    ProfScope& operator=(const ProfScope&) = delete;
+
+private:
+    unsigned stage_;
+    bool counted_;
+    u64 t0_;
+    u64 c0_[3];
+};
+
+#define HE_PROF_CAT2(a, b) a##b
+#define HE_PROF_CAT(a, b) HE_PROF_CAT2(a, b)
+#define HE_PROF_SCOPE(stage) ProfScope HE_PROF_CAT(he_prof_, __LINE__)(stage)
+#define HE_PROF_LAYER(s) \
+    ProfScope HE_PROF_CAT(he_prof_, __LINE__)(PROF_LAYER_0 + ((unsigned)(s) < PROF_MAX_LAYERS ? (unsigned)(s) : PROF_MAX_LAYERS - 1))
+#else
+#define HE_PROF_SCOPE(stage) ((void)0)
+#define HE_PROF_LAYER(s) ((void)0)
+#endif
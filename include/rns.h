@@ -0,0 +1,118 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "ntt_plan.h"
+#include "aligned_vector.h"
+using u64 = uint64_t;
+
+class ThreadPool;
+struct FixedNtt;
+
+// RNS basis for ring dimension n: L primes q_0..q_{L-1}, each with its own
+// NttPlan, plus the CRT constants for Q = q_0 * ... * q_{L-1}.
+// Multi-word integers are little-endian arrays of 64-bit words.
+struct RnsBase {
+    size_t n = 0;
+    std::vector<u64> moduli;
+    std::vector<NttPlan> plans;
+    // compiled-in Ntt<q_i, log n> when registered (see ntt_fixed.h), else
+    // nullptr; rns_ntt / rns_intt prefer it over plans[i] for whole limbs
+    std::vector<const FixedNtt*> fixed;
+
+    size_t words = 0;                // 64-bit words needed to hold Q
+    std::vector<u64> Q;              // words
+    std::vector<u64> qhat;           // L x words, qhat_i = Q / q_i
+    std::vector<u64> qhat_inv;       // qhat_i^{-1} mod q_i
+    std::vector<u64> qhat_inv_shoup;
+    std::vector<u64> word_pow;       // L x words, 2^{64k} mod q_i
+    std::vector<u64> word_pow_shoup;
+
+    RnsBase() = default;
+    // Every modulus must be a distinct prime with q_i = 1 (mod 2n).
+    RnsBase(size_t n, const std::vector<u64>& moduli);
+    void init(size_t n, const std::vector<u64>& moduli);
+
+    size_t size() const { return moduli.size(); }
+};
+
+// Polynomial in RNS form, stored limb-major in one contiguous 64-byte aligned
+// buffer: data[i * n + j] is coefficient j modulo q_i.
+struct RnsPoly {
+    const RnsBase* base = nullptr;
+    aligned_vector<u64> data;
+    bool ntt_form = false;  // limbs hold negacyclic evaluations (bit-reversed)
+
+    RnsPoly() = default;
+    explicit RnsPoly(const RnsBase& b);
+
+    u64* limb(size_t i) { return data.data() + i * base->n; }
+    const u64* limb(size_t i) const { return data.data() + i * base->n; }
+};
+
+// Negacyclic forward/inverse transform of every limb.
+void rns_ntt(RnsPoly& a);
+void rns_intt(RnsPoly& a);
+// Same, on a pool: limbs run as independent tasks, or one after another with
+// each transform split across the pool when there are fewer limbs than threads.
+void rns_ntt(RnsPoly& a, ThreadPool& pool);
+void rns_intt(RnsPoly& a, ThreadPool& pool);
+
+// Limb-by-limb pointwise ops; out may alias a or b. rns_mul needs both
+// operands in NTT form (it is the dyadic product).
+void rns_add(const RnsPoly& a, const RnsPoly& b, RnsPoly& out);
+void rns_sub(const RnsPoly& a, const RnsPoly& b, RnsPoly& out);
+void rns_negate(const RnsPoly& a, RnsPoly& out);
+void rns_mul(const RnsPoly& a, const RnsPoly& b, RnsPoly& out);
+
+// Full ring product in Z_Q[X]/(X^n + 1) of coefficient-form operands:
+// forward transforms, dyadic product and inverse transform for all limbs.
+void rns_multiply(const RnsPoly& a, const RnsPoly& b, RnsPoly& out);
+
+// The same operations on caller-owned limb buffers of size() * n words in
+// the RnsPoly layout (e.g. from a PolyArena), with no allocation: 'tmp' is
+// scratch of the same size for rns_multiply. out may alias a (and, for the
+// pointwise ops, b).
+void rns_ntt(const RnsBase& B, u64* data);
+void rns_intt(const RnsBase& B, u64* data);
+void rns_ntt(const RnsBase& B, u64* data, ThreadPool& pool);
+void rns_intt(const RnsBase& B, u64* data, ThreadPool& pool);
+void rns_add(const RnsBase& B, const u64* a, const u64* b, u64* out);
+void rns_sub(const RnsBase& B, const u64* a, const u64* b, u64* out);
+void rns_negate(const RnsBase& B, const u64* a, u64* out);
+void rns_mul(const RnsBase& B, const u64* a, const u64* b, u64* out);
+void rns_multiply(const RnsBase& B, const u64* a, const u64* b, u64* out, u64* tmp);
+
+// Fused products, limb by limb so each limb's operands, accumulators and
+// transforms stay in cache together. Products are summed in 128-bit lazy
+// accumulators and reduced once per coefficient, and in coefficient form the
+// whole sum costs one inverse transform per limb. All operands must share
+// the base and the form; outputs come back in that form (coefficient inputs
+// are transformed internally, NTT-form inputs are not transformed at all).
+//
+// out = sum_k a[k] * b[k]
+void rns_inner_product(const std::vector<RnsPoly>& a, const std::vector<RnsPoly>& b, RnsPoly& out);
+// Tensor product of (a0, a1) and (b0, b1):
+// c0 = a0 * b0, c1 = a0 * b1 + a1 * b0, c2 = a1 * b1
+void rns_tensor(const RnsPoly& a0, const RnsPoly& a1, const RnsPoly& b0, const RnsPoly& b1,
+                RnsPoly& c0, RnsPoly& c1, RnsPoly& c2);
+// Buffer forms: 'scratch' is 4 * n words (unused for NTT-form inputs by
+// rns_tensor). Outputs may alias inputs.
+void rns_inner_product(const RnsBase& B, const u64* const* a, const u64* const* b, size_t count,
+                       bool ntt_form, u64* out, u64* scratch);
+void rns_tensor(const RnsBase& B, const u64* a0, const u64* a1, const u64* b0, const u64* b1,
+                bool ntt_form, u64* c0, u64* c1, u64* c2, u64* scratch);
+
+// Galois automorphism sigma_k (see galois.h) of every limb, in place, in
+// whichever form the limbs are in: an index permutation in NTT form, a
+// signed permutation in coefficient form. No transforms are run.
+void rns_automorphism(RnsPoly& a, size_t k);
+// Buffer forms; the out-of-place one needs out not to alias in.
+void rns_automorphism(const RnsBase& B, u64* data, bool ntt_form, size_t k);
+void rns_automorphism(const RnsBase& B, const u64* in, bool ntt_form, size_t k, u64* out);
+
+// CRT: 'in' holds n integers of in_words words each (coefficient-major);
+// each is reduced modulo every q_i. Values need not be below Q.
+void rns_decompose(const u64* in, size_t in_words, RnsPoly& out);
+// Inverse CRT: writes n integers in [0, Q) of base->words words each.
+void rns_compose(const RnsPoly& in, std::vector<u64>& out);
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "rns.h"
+using u64 = uint64_t;
+
+// Basis changes that stay in residue form: fast base conversion (basis
+// extension), rescaling by the last prime and BGV modulus switching. They
+// work on the limb-major buffers of rns.h, RNS_CONV_TILE coefficients at a
+// time, so a tile's residues in every limb stay in L1 while the limbs are
+// combined. Per-basis constants are computed once, when the converter or
+// rescaler is built.
+
+static const size_t RNS_CONV_TILE = 256;  // coefficients per tile
+
+// Fast base conversion from 'from' (q_0..q_{L-1}, product Q) to 'to'
+// (p_0..p_{K-1}), same n:
+//   y_i = [x_i * qhat_i^{-1}]_{q_i},   out_j = sum_i y_i * [qhat_i]_{p_j} mod p_j
+// Each output is a K x L matrix-vector product per coefficient, summed in a
+// 128-bit accumulator that is reduced once (every 15 terms for L > 15). The
+// result is x + e*Q for some 0 <= e < L, the usual approximate conversion
+// of BEHZ / HPS; it is exact when e = 0 is known (e.g. small x).
+struct BaseConverter {
+    const RnsBase* from = nullptr;
+    const RnsBase* to = nullptr;
+    std::vector<u64> qhat_mod_p;  // K x L, row j holds [qhat_i]_{p_j}
+    // per p_j: 2^64 mod p_j and Shoup quotients, for the 128-bit reduction
+    std::vector<u64> r64, r64_shoup, one_shoup;
+
+    BaseConverter() = default;
+    BaseConverter(const RnsBase& from, const RnsBase& to);
+    void init(const RnsBase& from, const RnsBase& to);
+};
+
+// Coefficient-form limbs: 'in' has from->size() limbs and 'out' to->size()
+// limbs of n words. 'scratch' is from->size() * RNS_CONV_TILE words.
+void rns_base_convert(const BaseConverter& C, const u64* in, u64* out, u64* scratch);
+void rns_base_convert(const BaseConverter& C, const RnsPoly& in, RnsPoly& out);
+
+// Division by the last prime q_L of 'from', leaving a polynomial over 'to'
+// (the first L-1 moduli of 'from', same n):
+//   out_i = (x_i - d) * q_L^{-1} mod q_i,   d = t * [x_L * t^{-1}]_{q_L}
+// with the bracket lifted to (-q_L/2, q_L/2]. d = x (mod q_L), so the
+// division is exact. With t = 1 this is the CKKS rescale, out = round(x /
+// q_L). With t > 1 (a BGV plaintext modulus coprime to q_L) also d = 0 (mod
+// t), so out = x * q_L^{-1} (mod t): BGV modulus switching.
+struct RnsRescaler {
+    const RnsBase* from = nullptr;
+    const RnsBase* to = nullptr;
+    u64 t = 1;
+    u64 t_inv = 1, t_inv_shoup = 0;  // t^{-1} mod q_L
+    // per q_i, i < L-1
+    std::vector<u64> last_inv, last_inv_shoup;  // q_L^{-1} mod q_i
+    std::vector<u64> last_mod;                  // q_L mod q_i
+    std::vector<u64> t_mod, t_mod_shoup;        // t mod q_i
+    std::vector<u64> one_shoup;                 // Shoup quotient of 1 mod q_i
+
+    RnsRescaler() = default;
+    RnsRescaler(const RnsBase& from, const RnsBase& to, u64 t = 1);
+    void init(const RnsBase& from, const RnsBase& to, u64 t = 1);
+};
+
+// 'in' has from->size() limbs, 'out' to->size() limbs; out may alias in.
+// NTT-form input gives NTT-form output: the last limb takes one inverse
+// transform and the correction d one forward transform per remaining limb.
+// 'scratch' is 2 * n words.
+void rns_rescale(const RnsRescaler& R, const u64* in, bool ntt_form, u64* out, u64* scratch);
+void rns_rescale(const RnsRescaler& R, const RnsPoly& in, RnsPoly& out);
@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+using u64 = uint64_t;
+
+struct RnsPoly;
+
+// Compact polynomial serialization. Residues modulo q are stored at
+// coeff_bits(q) = ceil(log2 q) bits each, so a 31-bit limb takes 31 bits
+// per coefficient instead of 64.
+//
+// Stream layout (little-endian):
+//   "HEPK"  u8 version  u8 flags (bit 0: NTT form)  u16 limb count L
+//   u32 n   L x u64 moduli
+//   L limbs, each n coefficients bit-packed LSB first and padded to a byte
+// The writers stream limb by limb in chunks of SERIAL_CHUNK coefficients
+// and never build the whole blob; the readers unpack straight into the
+// destination words.
+
+static const uint8_t SERIAL_VERSION = 1;
+static const size_t SERIAL_CHUNK = 4096;  // coefficients per write / read
+
+// Bits per residue modulo mod: the bit length of mod - 1 (at least 1).
+unsigned coeff_bits(u64 mod);
+// Bytes of 'count' packed values of 'bits' bits.
+inline size_t packed_bytes(size_t count, unsigned bits) { return (count * bits + 7) / 8; }
+
+// Bit-pack values below 2^bits (bits in [1, 64]), LSB first: value i takes
+// bits [i*bits, (i+1)*bits) of the byte string. Writes exactly
+// packed_bytes(count, bits) bytes; with AVX2, eight values (exactly 'bits'
+// bytes) are assembled per step. unpack_bits reads exactly as many bytes.
+void pack_bits(const u64* in, size_t count, unsigned bits, uint8_t* out);
+void unpack_bits(const uint8_t* in, size_t count, unsigned bits, u64* out);
+
+struct PolyHeader {
+    size_t n = 0;
+    std::vector<u64> moduli;
+    bool ntt_form = false;
+
+    PolyHeader() = default;
+    PolyHeader(size_t n_, const std::vector<u64>& moduli_, bool ntt_form_)
+        : n(n_), moduli(moduli_), ntt_form(ntt_form_) {}
+    explicit PolyHeader(const RnsPoly& a);
+
+    size_t header_bytes() const { return 12 + 8 * moduli.size(); }
+    size_t payload_bytes() const;
+    size_t total_bytes() const { return header_bytes() + payload_bytes(); }
+};
+
+// Streaming endpoints. A writer consumes all 'len' bytes or returns false;
+// a reader fills exactly 'len' bytes or returns false (error or end of
+// input). The coders below make one call per header and per chunk.
+using ByteWriter = std::function<bool(const void* p, size_t len)>;
+using ByteReader = std::function<bool(void* p, size_t len)>;
+
+// File descriptor endpoints; retry on EINTR and partial transfers.
+ByteWriter fd_writer(int fd);
+ByteReader fd_reader(int fd);
+// Appends to 'out', which must outlive the writer.
+ByteWriter buffer_writer(std::vector<uint8_t>& out);
+// Reads [p, p + len) front to back; the reader keeps its own position.
+ByteReader buffer_reader(const uint8_t* p, size_t len);
+
+// Writes header and limbs; 'data' is limb-major, moduli.size() * n words
+// (the RnsPoly layout), residues in [0, q_i).
+bool write_poly(const ByteWriter& w, const PolyHeader& h, const u64* data);
+bool write_poly(const ByteWriter& w, const RnsPoly& a);
+
+// Reads and checks a header: magic, version, n a power of two, 1 to 1024
+// moduli each in [2, 2^62).
+bool read_poly_header(const ByteReader& r, PolyHeader& h);
+// Reads the limbs that follow a header into caller storage of
+// moduli.size() * n words (e.g. an arena buffer). Fails on short input or
+// on any value not below its modulus.
+bool read_poly_data(const ByteReader& r, const PolyHeader& h, u64* data);
+// Header and limbs into 'out', whose base must have the same n and moduli;
+// sets out.ntt_form from the header.
+bool read_poly(const ByteReader& r, RnsPoly& out);
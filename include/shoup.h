@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+using u64 = uint64_t;
+using u128 = __uint128_t;
+
+// Shoup multiplication by a fixed operand w < mod.
+// Precompute wp = floor(w * 2^64 / mod) once per constant; afterwards
+// x * w mod mod needs one high multiply and two low multiplies, no division.
+// Requires mod < 2^63; x may be any 64-bit value.
+
+static inline u64 shoup_precompute(u64 w, u64 mod) {
+    return (u64)(((u128)w << 64) / mod);
+}
+
+// Result in [0, 2*mod).
+static inline u64 shoup_mul_lazy(u64 x, u64 w, u64 wp, u64 mod) {
+    u64 q = (u64)(((u128)x * wp) >> 64);
+    return x * w - q * mod;
+}
+
+// Result in [0, mod).
+static inline u64 shoup_mul(u64 x, u64 w, u64 wp, u64 mod) {
+    u64 r = shoup_mul_lazy(x, w, wp, mod);
+    return (r >= mod) ? r - mod : r;
+}
+
+// 32-bit variants for mod < 2^31 (u32 coefficient storage): wp =
+// floor(w * 2^32 / mod), x any 32-bit value, lazy result in [0, 2*mod).
+using u32 = uint32_t;
+
+static inline u32 shoup_precompute32(u32 w, u32 mod) {
+    return (u32)(((u64)w << 32) / mod);
+}
+
+static inline u32 shoup_mul_lazy32(u32 x, u32 w, u32 wp, u32 mod) {
+    u32 q = (u32)(((u64)x * wp) >> 32);
+    return x * w - q * mod;
+}
+
+static inline u32 shoup_mul32(u32 x, u32 w, u32 wp, u32 mod) {
+    u32 r = shoup_mul_lazy32(x, w, wp, mod);
+    return (r >= mod) ? r - mod : r;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "ntt_plan.h"
+using u64 = uint64_t;
+
+struct RnsPoly;
+
+// Ternary operands (coefficients in {-1, 0, 1}: secret keys, encryption
+// randomness) multiplied against dense polynomials without a transform.
+// s * b is the signed sum of the rotations X^k * b over the nonzero s_k, so
+// it takes weight(s) * n modular additions and no products: cheaper than
+// the three transforms of an NTT product while the weight stays below
+// about TERNARY_SPARSE_PER_LOG * log2(n).
+//
+// A TernaryPoly keeps both forms: the packed 2-bit encoding (for storage)
+// and the index lists of the +1 and -1 coefficients (for multiplication).
+
+static const size_t TERNARY_SPARSE_PER_LOG = 12;
+
+struct TernaryPoly {
+    size_t n = 0;
+    // 2 bits per coefficient, coefficient j in bits 2*(j%4) of byte j/4:
+    // 0 -> 0, 1 -> +1, 2 -> -1 (3 is invalid)
+    std::vector<uint8_t> packed;
+    std::vector<uint32_t> plus, minus;  // ascending indices of +1 / -1
+
+    size_t weight() const { return plus.size() + minus.size(); }
+    int coeff(size_t j) const {
+        unsigned c = (packed[j / 4] >> (2 * (j % 4))) & 3;
+        return c == 1 ? 1 : c == 2 ? -1 : 0;
+    }
+};
+
+// Builders; each returns false (leaving 'out' unspecified) on a coefficient
+// outside {-1, 0, 1}: a residue other than 0, 1, mod-1, or the code 3.
+// 'packed' holds (n + 3) / 4 bytes, unused high bits zero.
+bool ternary_from_signed(const int8_t* s, size_t n, TernaryPoly& out);
+bool ternary_from_residues(const u64* a, size_t n, u64 mod, TernaryPoly& out);
+bool ternary_from_packed(const uint8_t* packed, size_t n, TernaryPoly& out);
+// Coefficients as residues mod 'mod' (n words).
+void ternary_to_residues(const TernaryPoly& s, u64 mod, u64* out);
+
+// Whether the rotation sums beat the NTT product for this weight and n.
+bool ternary_prefers_sparse(size_t weight, size_t n);
+
+// out = s * b in Z_q[X]/(X^n + 1) (negacyclic) or Z_q[X]/(X^n - 1)
+// (cyclic), by rotation sums only: b has s.n coefficients in [0, mod),
+// mod < 2^62. 'scratch' is 4 * s.n words; out may alias b. Allocates
+// nothing.
+void poly_mul_ternary_negacyclic(const TernaryPoly& s, const u64* b, u64* out, u64* scratch, u64 mod);
+void poly_mul_ternary_cyclic(const TernaryPoly& s, const u64* b, u64* out, u64* scratch, u64 mod);
+
+// Same products, taking the rotation sums when ternary_prefers_sparse and
+// the plan's transforms otherwise (negacyclic: plan.has_negacyclic()).
+// s.n == plan.n, 'scratch' is 4 * plan.n words, out may alias b.
+void poly_mul_negacyclic(const TernaryPoly& s, const u64* b, u64* out, u64* scratch, const NttPlan& plan);
+void poly_mul_cyclic(const TernaryPoly& s, const u64* b, u64* out, u64* scratch, const NttPlan& plan);
+std::vector<u64> poly_mul_negacyclic(const TernaryPoly& s, const std::vector<u64>& b, const NttPlan& plan);
+std::vector<u64> poly_mul_cyclic(const TernaryPoly& s, const std::vector<u64>& b, const NttPlan& plan);
+
+// out = s * b over every limb of b's base; out takes b's base and form and
+// may alias b. Coefficient-form limbs use the rule above; NTT-form limbs
+// always transform s (one forward NTT per limb) and multiply pointwise,
+// since the rotation sums would need b back in coefficient form.
+void rns_mul_ternary(const TernaryPoly& s, const RnsPoly& b, RnsPoly& out);
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool for data-parallel loops. Workers are started once
+// and sleep between jobs, so a parallel_for costs a wake-up, not a thread
+// spawn. The calling thread takes part in every job.
+//
+// Scheduling is work-stealing over index ranges: each participant starts
+// with a contiguous slice of [0, count) and pops indices from its front;
+// when it runs dry it steals the back half of another participant's slice.
+// Which thread runs an index never affects results, only timing.
+class ThreadPool {
+public:
+    // 'threads' is the total number of participants including the caller;
+    // 0 means std::thread::hardware_concurrency().
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return slots_.size(); }
+
+    // Runs fn(i) for every i in [0, count) and returns when all are done.
+    // Calls from inside a running job execute serially on the calling
+    // thread; calls from several outside threads are serialized.
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+    // [begin, end) packed as two 32-bit halves so owner pops and thief
+    // splits are single compare-and-swaps
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> range{0};
+    };
+
+    void worker_loop(size_t id);
+    void run_slots(size_t id);
+    bool pop(size_t id, size_t& index);
+    bool steal(size_t id);
+
+    std::vector<Slot> slots_;
+    std::vector<std::thread> workers_;
+    std::mutex job_mutex_;  // one job at a time
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t)>* job_ = nullptr;
+    uint64_t generation_ = 0;
+    size_t busy_ = 0;
+    bool stop_ = false;
+};
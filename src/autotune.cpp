@@ -0,0 +1,333 @@
+#include "autotune.h"
+#include "ntt.h"
+#include "ntt_batch.h"
+#include "ntt_blocked.h"
+#include "cpu_features.h"
+#include "aligned_vector.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <unistd.h>
+
+using u64 = uint64_t;
+using u32 = uint32_t;
+
+// Table keyed by (log2 n, width).
+static std::mutex tune_mu;
+static std::map<std::pair<unsigned, unsigned>, TuneChoice> tune_table;
+
+// Set while this thread calibrates, so the plans it builds take the
+// defaults instead of recursing into another calibration.
+static thread_local bool calibrating = false;
+
+static unsigned log2_of(size_t n) {
+    unsigned l = 0;
+    while ((size_t(1) << l) < n) ++l;
+    return l;
+}
+
+static std::pair<unsigned, unsigned> tune_key(size_t n, u64 mod) {
+    return std::make_pair(log2_of(n), tune_width(mod));
+}
+
+static std::string host_cpu_name() {
+    std::string name;
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386))
+    unsigned int r[4];
+    if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004) {
+        for (unsigned leaf = 0x80000002; leaf <= 0x80000004; ++leaf) {
+            __get_cpuid(leaf, &r[0], &r[1], &r[2], &r[3]);
+            name.append(reinterpret_cast<const char*>(r), sizeof r);
+        }
+    }
+#endif
+    name = name.c_str();  // drop the NUL padding
+    size_t b = name.find_first_not_of(' '), e = name.find_last_not_of(' ');
+    return b == std::string::npos ? std::string("unknown") : name.substr(b, e - b + 1);
+}
+
+unsigned tune_width(u64 mod) {
+    return mod < (u64(1) << 31) ? 32 : 64;
+}
+
+bool tune_lookup(size_t n, u64 mod, TuneChoice& out) {
+    std::lock_guard<std::mutex> lock(tune_mu);
+    auto it = tune_table.find(tune_key(n, mod));
+    if (it == tune_table.end()) return false;
+    out = it->second;
+    return true;
+}
+
+void tune_set(size_t n, u64 mod, const TuneChoice& c) {
+    assert(c.blocked_tile >= BLOCKED_TILE_MIN && (c.blocked_tile & (c.blocked_tile - 1)) == 0);
+    assert(c.blocked_group >= 1);
+    std::lock_guard<std::mutex> lock(tune_mu);
+    tune_table[tune_key(n, mod)] = c;
+}
+
+void tune_clear() {
+    std::lock_guard<std::mutex> lock(tune_mu);
+    tune_table.clear();
+}
+
+// --- HE_TUNE_FILE ---
+
+static const char* auto_path() {
+    static const char* path = [] {
+        const char* e = getenv("HE_TUNE_FILE");
+        return e && *e ? e : nullptr;
+    }();
+    return path;
+}
+
+// Loads HE_TUNE_FILE once; then calibrates keys the profile lacks, one
+// calibration at a time so they do not disturb each other's timings.
+static void auto_tune(size_t n, u64 mod) {
+    const char* path = auto_path();
+    if (!path || calibrating) return;
+    static std::once_flag loaded;
+    std::call_once(loaded, [path] { tune_load(path); });
+    TuneChoice c;
+    if (tune_lookup(n, mod, c)) return;
+    static std::mutex calib_mu;
+    std::lock_guard<std::mutex> lock(calib_mu);
+    if (tune_lookup(n, mod, c)) return;
+    tune_calibrate(n, mod);
+    tune_save(path);
+}
+
+void tune_apply(NttPlan& plan) {
+    plan.use_avx2 = host_has_avx2();
+    plan.blocked = plan.n >= BLOCKED_MIN_N;
+    plan.blocked_tile = BLOCKED_TILE_N;
+    plan.blocked_group = BLOCKED_GROUP;
+    plan.batch_interleave_min = 0;
+    auto_tune(plan.n, plan.mod);
+    TuneChoice c;
+    if (calibrating || !tune_lookup(plan.n, plan.mod, c)) return;
+    plan.use_avx2 = c.avx2 && host_has_avx2();
+    plan.blocked = c.blocked;
+    plan.blocked_tile = c.blocked_tile;
+    plan.blocked_group = c.blocked_group;
+    plan.batch_interleave_min = c.batch_interleave_min;
+}
+
+// --- calibration ---
+
+// Best of several trials of the mean time per call, in seconds; each trial
+// runs at least 2^16 coefficients' worth of calls.
+template <class F>
+static double best_time(size_t n, F f) {
+    const size_t reps = std::max<size_t>(1, (size_t(1) << 16) / n);
+    double best = 1e30;
+    f();  // warm the tables and caches
+    for (int trial = 0; trial < 5; ++trial) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < reps; ++r) f();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, s / reps);
+    }
+    return best;
+}
+
+// Batch timings stop here: larger transforms are far from the short
+// stages that interleaving speeds up, and a batch of them takes too long
+// to time at startup.
+static const size_t TUNE_BATCH_MAX_N = size_t(1) << 14;
+static const double TUNE_MARGIN = 0.97;
+// Blocked shapes tried around the defaults of ntt_blocked.h.
+static const size_t TUNE_TILES[] = {size_t(1) << 11, size_t(1) << 12, size_t(1) << 13};
+static const size_t TUNE_GROUPS[] = {2, 3, 4};
+
+TuneChoice tune_calibrate(size_t n, u64 mod) {
+    struct Guard {
+        bool old = calibrating;
+        Guard() { calibrating = true; }
+        ~Guard() { calibrating = old; }
+    } guard;
+
+    NttPlan plan(n, mod);
+    const bool nega = plan.has_negacyclic();
+    std::mt19937_64 rng(n ^ mod);
+    aligned_vector<u64> a(n);
+    for (auto& x : a) x = rng() % mod;
+    // a forward and inverse pair leaves 'a' as it was, so every trial sees
+    // the same data
+    auto pair = [&] {
+        if (nega) {
+            ntt_negacyclic(a.data(), n, plan);
+            intt_negacyclic(a.data(), n, plan);
+        } else {
+            ntt_to_bitrev(a.data(), n, plan);
+            intt_from_bitrev(a.data(), n, plan);
+        }
+    };
+    aligned_vector<u32> a32(plan.narrow ? n : 0);
+    for (auto& x : a32) x = (u32)(rng() % mod);
+    auto pair32 = [&] {
+        if (nega) {
+            ntt_negacyclic(a32.data(), n, plan);
+            intt_negacyclic(a32.data(), n, plan);
+        } else {
+            ntt_to_bitrev(a32.data(), n, plan);
+            intt_from_bitrev(a32.data(), n, plan);
+        }
+    };
+
+    // the built-in defaults first; another variant has to beat them by
+    // TUNE_MARGIN, so timing noise does not flip a choice between near ties
+    TuneChoice best;
+    best.avx2 = host_has_avx2();
+    best.blocked = n >= BLOCKED_MIN_N;
+    best.blocked_tile = BLOCKED_TILE_N;
+    best.blocked_group = BLOCKED_GROUP;
+    plan.use_avx2 = best.avx2;
+    plan.blocked = best.blocked;
+    plan.blocked_tile = best.blocked_tile;
+    plan.blocked_group = best.blocked_group;
+    if (plan.narrow) {
+        // width 32: avx2 selects the u32 kernels, which have no blocked
+        // schedule, so it is timed on u32 storage; blocked then on the u64
+        // path, the only one it affects
+        if (host_has_avx2()) {
+            double def = best_time(n, pair32) * TUNE_MARGIN;
+            plan.use_avx2 = !best.avx2;
+            if (best_time(n, pair32) < def) best.avx2 = plan.use_avx2;
+            plan.use_avx2 = best.avx2;
+        }
+        double def = best_time(n, pair) * TUNE_MARGIN;
+        plan.blocked = !best.blocked;
+        if (best_time(n, pair) < def) best.blocked = plan.blocked;
+    } else {
+        double best_s = best_time(n, pair) * TUNE_MARGIN;
+        for (int avx2 = 0; avx2 <= (host_has_avx2() ? 1 : 0); ++avx2) {
+            for (int blocked = 0; blocked <= 1; ++blocked) {
+                plan.use_avx2 = avx2 != 0;
+                plan.blocked = blocked != 0;
+                if (plan.use_avx2 == best.avx2 && plan.blocked == best.blocked) continue;
+                double s = best_time(n, pair);
+                if (s < best_s) {
+                    best_s = s;
+                    best.avx2 = plan.use_avx2;
+                    best.blocked = plan.blocked;
+                }
+            }
+        }
+    }
+    plan.use_avx2 = best.avx2;
+    plan.blocked = best.blocked;
+
+    // blocked shape: the tile first with the default group, then the group
+    // with the best tile (n is at least 2^17 here, so every pair is slow
+    // enough that the full grid would cost too much at startup)
+    if (best.blocked && n >= BLOCKED_MIN_N) {
+        double shape_s = best_time(n, pair) * TUNE_MARGIN;
+        auto try_shape = [&](size_t tile, size_t group) {
+            if (tile == best.blocked_tile && group == best.blocked_group) return;
+            plan.blocked_tile = tile;
+            plan.blocked_group = group;
+            double s = best_time(n, pair);
+            if (s < shape_s) {
+                shape_s = s;
+                best.blocked_tile = tile;
+                best.blocked_group = group;
+            }
+        };
+        for (size_t tile : TUNE_TILES) try_shape(tile, best.blocked_group);
+        for (size_t group : TUNE_GROUPS) try_shape(best.blocked_tile, group);
+        plan.blocked_tile = best.blocked_tile;
+        plan.blocked_group = best.blocked_group;
+    }
+
+    // smallest tested batch from which interleaving wins
+    if (nega && n <= TUNE_BATCH_MAX_N) {
+        for (size_t count : {size_t(4), size_t(16)}) {
+            aligned_vector<u64> batch(count * n);
+            for (auto& x : batch) x = rng() % mod;
+            auto run = [&] {
+                ntt_negacyclic_batch(batch.data(), count, plan);
+                intt_negacyclic_batch(batch.data(), count, plan);
+            };
+            plan.batch_interleave_min = 0;
+            double plain = best_time(count * n, run);
+            plan.batch_interleave_min = count;
+            double inter = best_time(count * n, run);
+            if (inter < plain * TUNE_MARGIN) {
+                best.batch_interleave_min = count;
+                break;
+            }
+        }
+    }
+    tune_set(n, mod, best);
+    return best;
+}
+
+// --- profile file ---
+
+bool tune_load(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    std::map<std::pair<unsigned, unsigned>, TuneChoice> table;
+    char line[256];
+    unsigned version = 0;
+    bool ok = fgets(line, sizeof line, f) && sscanf(line, "he-tune %u", &version) == 1 &&
+              version == TUNE_FILE_VERSION;
+    ok = ok && fgets(line, sizeof line, f) && strncmp(line, "cpu ", 4) == 0;
+    if (ok) {
+        std::string cpu(line + 4);
+        while (!cpu.empty() && (cpu.back() == '\n' || cpu.back() == '\r')) cpu.pop_back();
+        ok = cpu == host_cpu_name();
+    }
+    while (ok && fgets(line, sizeof line, f)) {
+        unsigned log_n, width, avx2, blocked, log_tile, group;
+        unsigned long inter;
+        ok = sscanf(line, "%u %u %u %u %lu %u %u", &log_n, &width, &avx2, &blocked, &inter, &log_tile, &group) == 7 &&
+             log_n < 64 && (width == 32 || width == 64) && avx2 <= 1 && blocked <= 1 &&
+             log_tile < 32 && (size_t(1) << log_tile) >= BLOCKED_TILE_MIN && group >= 1 && group <= 16;
+        if (ok) {
+            TuneChoice c;
+            c.avx2 = avx2 != 0;
+            c.blocked = blocked != 0;
+            c.batch_interleave_min = inter;
+            c.blocked_tile = size_t(1) << log_tile;
+            c.blocked_group = group;
+            table[std::make_pair(log_n, width)] = c;
+        }
+    }
+    fclose(f);
+    if (!ok) return false;
+    std::lock_guard<std::mutex> lock(tune_mu);
+    tune_table.swap(table);
+    return true;
+}
+
+bool tune_save(const char* path) {
+    std::map<std::pair<unsigned, unsigned>, TuneChoice> table;
+    {
+        std::lock_guard<std::mutex> lock(tune_mu);
+        table = tune_table;
+    }
+    // private temporary renamed over 'path', as for plan files
+    std::string tmp = std::string(path) + ".tmp." + std::to_string((long)getpid());
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) return false;
+    bool ok = fprintf(f, "he-tune %u\ncpu %s\n", TUNE_FILE_VERSION, host_cpu_name().c_str()) > 0;
+    for (const auto& e : table) {
+        const TuneChoice& c = e.second;
+        ok = ok && fprintf(f, "%u %u %d %d %lu %u %u\n", e.first.first, e.first.second, c.avx2 ? 1 : 0,
+                           c.blocked ? 1 : 0, (unsigned long)c.batch_interleave_min, log2_of(c.blocked_tile),
+                           (unsigned)c.blocked_group) > 0;
+    }
+    ok = fclose(f) == 0 && ok;
+    if (ok) ok = rename(tmp.c_str(), path) == 0;
+    if (!ok) unlink(tmp.c_str());
+    return ok;
+}
@@ -0,0 +1,164 @@
+#include "galois.h"
+#include "cpu_features.h"
+#include "simd_avx2.h"
+#include <cassert>
+#include <map>
+#include <memory>
+#include <mutex>
+
+using u64 = uint64_t;
+using u32 = uint32_t;
+
+static size_t bitrev(size_t x, unsigned bits) {
+    size_t r = 0;
+    for (unsigned b = 0; b < bits; ++b) r |= ((x >> b) & 1) << (bits - 1 - b);
+    return r;
+}
+
+// Marks one index per nontrivial cycle of j -> src[j] (NEG bit ignored).
+static std::vector<u32> cycle_leaders(const u32* src, size_t n) {
+    std::vector<u32> leaders;
+    std::vector<bool> seen(n, false);
+    for (size_t s = 0; s < n; ++s) {
+        if (seen[s]) continue;
+        size_t j = s, len = 0;
+        do {
+            seen[j] = true;
+            j = src[j] & ~GaloisTable::NEG;
+            ++len;
+        } while (j != s);
+        if (len > 1 || (src[s] & GaloisTable::NEG)) leaders.push_back((u32)s);
+    }
+    return leaders;
+}
+
+GaloisTable::GaloisTable(size_t n_, size_t k_) : n(n_), k(k_), ntt_src(n_), coeff_src(n_) {
+    assert(n >= 2 && (n & (n - 1)) == 0 && n < (size_t(1) << 31));
+    assert((k & 1) && k < 2 * n);
+    const size_t two_n = 2 * n, mask = two_n - 1;
+    unsigned log_n = 0;
+    while ((size_t(1) << log_n) < n) ++log_n;
+
+    // slot j evaluates at psi^{2 bitrev(j) + 1}; sigma_k moves that point to
+    // psi^{(2 bitrev(j) + 1) k}, which is slot bitrev(((..) - 1) / 2)
+    for (size_t j = 0; j < n; ++j) {
+        size_t e = ((2 * bitrev(j, log_n) + 1) * k) & mask;
+        ntt_src[j] = (u32)bitrev((e - 1) / 2, log_n);
+    }
+
+    // coefficient i lands on i*k mod 2n, so j is fed by i = j * k^{-1} mod
+    // 2n; i >= n stands for -X^{i - n}. k^{-1} = k^{n-1} (the odd residues
+    // mod 2n form a group of order n).
+    size_t k_inv = 1, b = k, e = n - 1;
+    while (e) {
+        if (e & 1) k_inv = (k_inv * b) & mask;
+        b = (b * b) & mask;
+        e >>= 1;
+    }
+    for (size_t j = 0; j < n; ++j) {
+        size_t i = (j * k_inv) & mask;
+        coeff_src[j] = i < n ? (u32)i : (u32)(i - n) | NEG;
+    }
+
+    ntt_cycles = cycle_leaders(ntt_src.data(), n);
+    coeff_cycles = cycle_leaders(coeff_src.data(), n);
+}
+
+const GaloisTable* cached_galois_table(size_t n, size_t k) {
+    static std::mutex mu;
+    static std::map<std::pair<size_t, size_t>, std::unique_ptr<GaloisTable>> cache;
+    std::lock_guard<std::mutex> lock(mu);
+    auto key = std::make_pair(n, k);
+    auto it = cache.find(key);
+    if (it != cache.end()) return it->second.get();
+    GaloisTable* t = new GaloisTable(n, k);
+    cache.emplace(key, std::unique_ptr<GaloisTable>(t));
+    return t;
+}
+
+size_t galois_element(size_t n, long long step) {
+    // 5 has order n/2 modulo 2n
+    const size_t two_n = 2 * n, half = n / 2;
+    long long r = step % (long long)half;
+    size_t e = (size_t)(r < 0 ? r + (long long)half : r);
+    size_t g = 1;
+    for (size_t i = 0; i < e; ++i) g = (g * 5) & (two_n - 1);
+    return g;
+}
+
+size_t galois_conjugate(size_t n) {
+    return 2 * n - 1;
+}
+
+// --- evaluation domain ---
+
+void automorphism_ntt(const u64* in, u64* out, size_t n, size_t k) {
+    assert(in != out);
+    const u32* src = cached_galois_table(n, k)->ntt_src.data();
+    for (size_t j = 0; j < n; ++j) out[j] = in[src[j]];
+}
+
+void automorphism_ntt(u64* a, size_t n, size_t k) {
+    const GaloisTable* t = cached_galois_table(n, k);
+    const u32* src = t->ntt_src.data();
+    for (u32 s : t->ntt_cycles) {
+        u64 first = a[s];
+        size_t j = s;
+        for (size_t nxt = src[j]; nxt != s; j = nxt, nxt = src[j]) a[j] = a[nxt];
+        a[j] = first;
+    }
+}
+
+// --- coefficient domain ---
+
+static void automorphism_coeff_scalar(const u64* in, u64* out, const u32* src, size_t n, u64 mod) {
+    for (size_t j = 0; j < n; ++j) {
+        u32 s = src[j];
+        u64 x = in[s & ~GaloisTable::NEG];
+        out[j] = (s & GaloisTable::NEG) && x ? mod - x : x;
+    }
+}
+
+#if HE_HAVE_AVX2_KERNELS
+
+static HE_TARGET_AVX2 void automorphism_coeff_avx2(const u64* in, u64* out, const u32* src, size_t n, u64 mod) {
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m128i idx_mask = _mm_set1_epi32((int)~GaloisTable::NEG);
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + j));
+        // NEG is the sign bit: widen it into a 64-bit lane mask
+        __m256i neg = _mm256_cvtepi32_epi64(_mm_srai_epi32(s, 31));
+        __m256i x = _mm256_i32gather_epi64((const long long*)in, _mm_and_si128(s, idx_mask), 8);
+        __m256i nx = csub(_mm256_sub_epi64(vq, x), vq);
+        _mm256_storeu_si256((__m256i*)(out + j), _mm256_blendv_epi8(x, nx, neg));
+    }
+    automorphism_coeff_scalar(in, out + j, src + j, n - j, mod);
+}
+
+#endif
+
+void automorphism_coeff(const u64* in, u64* out, size_t n, size_t k, u64 mod) {
+    assert(in != out);
+    const u32* src = cached_galois_table(n, k)->coeff_src.data();
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        automorphism_coeff_avx2(in, out, src, n, mod);
+        return;
+    }
+#endif
+    automorphism_coeff_scalar(in, out, src, n, mod);
+}
+
+void automorphism_coeff(u64* a, size_t n, size_t k, u64 mod) {
+    const GaloisTable* t = cached_galois_table(n, k);
+    const u32* src = t->coeff_src.data();
+    auto take = [&](u32 s, u64 x) { return (s & GaloisTable::NEG) && x ? mod - x : x; };
+    for (u32 c : t->coeff_cycles) {
+        u64 first = a[c];
+        size_t j = c;
+        size_t nxt = src[j] & ~GaloisTable::NEG;
+        for (; nxt != c; j = nxt, nxt = src[j] & ~GaloisTable::NEG) a[j] = take(src[j], a[nxt]);
+        a[j] = take(src[j], first);
+    }
+}
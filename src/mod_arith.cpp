@@ -1,12 +1,16 @@
-\
-#include <bits/stdc++.h>
+#include "mod_arith.h"
+#include "shoup.h"
+#include "cpu_features.h"
+#include "simd_avx2.h"
+#include <cassert>
+
 using u64 = uint64_t;
 using u128 = __uint128_t;
 
 u64 add_mod(u64 a, u64 b, u64 mod) {
+    // one subtraction suffices for a, b < mod, also when a + b wraps
     u64 r = a + b;
     if (r >= mod || r < a) r -= mod;
-    if (r >= mod) r %= mod;
     return r;
 }
 u64 sub_mod(u64 a, u64 b, u64 mod) {
@@ -16,3 +20,303 @@ u64 mul_mod(u64 a, u64 b, u64 mod) {
     u128 t = (u128)a * (u128)b;
     return (u64)(t % mod);
 }
+
+Barrett::Barrett(u64 m) : mod(m) {
+    assert(m >= 2 && m < (u64(1) << 62));
+    bits = 0;
+    while (bits < 64 && (m >> bits)) ++bits;
+    mu = (u64)(((u128)1 << (2 * bits)) / m);
+}
+
+// --- scalar array kernels ---
+
+static void add_mod_scalar(const u64* a, const u64* b, u64* out, size_t n, u64 mod) {
+    for (size_t i = 0; i < n; ++i) {
+        u64 s = a[i] + b[i];
+        out[i] = s >= mod ? s - mod : s;
+    }
+}
+
+static void sub_mod_scalar(const u64* a, const u64* b, u64* out, size_t n, u64 mod) {
+    for (size_t i = 0; i < n; ++i) out[i] = a[i] >= b[i] ? a[i] - b[i] : a[i] + mod - b[i];
+}
+
+static void negate_mod_scalar(const u64* a, u64* out, size_t n, u64 mod) {
+    for (size_t i = 0; i < n; ++i) out[i] = a[i] ? mod - a[i] : 0;
+}
+
+static void mul_scalar_mod_scalar(const u64* a, u64 c, u64 cs, u64* out, size_t n, u64 mod) {
+    for (size_t i = 0; i < n; ++i) out[i] = shoup_mul(a[i], c, cs, mod);
+}
+
+static void mul_mod_scalar(const u64* a, const u64* b, u64* out, size_t n, const Barrett& B) {
+    for (size_t i = 0; i < n; ++i) out[i] = B.mul(a[i], b[i]);
+}
+
+// Barrett::mul for mod < 2^31: z < 2^62 and q1 < 2^32, so every product fits
+// in 64 bits.
+static void mul_mod_scalar32(const u32* a, const u32* b, u32* out, size_t n, const Barrett& B) {
+    const u64 mod = B.mod, mu = B.mu;
+    const unsigned s1 = B.bits - 1, s3 = B.bits + 1;
+    for (size_t i = 0; i < n; ++i) {
+        u64 z = (u64)a[i] * b[i];
+        u64 q3 = ((z >> s1) * mu) >> s3;
+        u64 r = z - q3 * mod;
+        if (r >= 2 * mod) r -= 2 * mod;
+        out[i] = (u32)(r >= mod ? r - mod : r);
+    }
+}
+
+static void fma_mod_scalar(const u64* a, const u64* b, u64* acc, size_t n, const Barrett& B) {
+    const u64 mod = B.mod;
+    for (size_t i = 0; i < n; ++i) {
+        u64 s = acc[i] + B.mul(a[i], b[i]);
+        acc[i] = s >= mod ? s - mod : s;
+    }
+}
+
+static void fma_scalar_mod_scalar(const u64* a, u64 c, u64 cs, u64* acc, size_t n, u64 mod) {
+    for (size_t i = 0; i < n; ++i) {
+        u64 s = acc[i] + shoup_mul(a[i], c, cs, mod);
+        acc[i] = s >= mod ? s - mod : s;
+    }
+}
+
+#if HE_HAVE_AVX2_KERNELS
+
+// Barrett product of 4 lane pairs (see Barrett::mul); sh1 = bits - 1,
+// sh2 = 65 - bits and sh3 = bits + 1 are the shift counts for the 128-bit
+// shifts assembled from 64-bit halves, sh4 = 63 - bits.
+struct BarrettVec {
+    __m256i q, q2, mu;
+    __m128i sh1, sh2, sh3, sh4;
+};
+
+static inline HE_TARGET_AVX2 BarrettVec barrett_vec(const Barrett& B) {
+    BarrettVec v;
+    v.q = _mm256_set1_epi64x((long long)B.mod);
+    v.q2 = _mm256_set1_epi64x((long long)(2 * B.mod));
+    v.mu = _mm256_set1_epi64x((long long)B.mu);
+    v.sh1 = _mm_cvtsi32_si128((int)B.bits - 1);
+    v.sh2 = _mm_cvtsi32_si128(65 - (int)B.bits);
+    v.sh3 = _mm_cvtsi32_si128((int)B.bits + 1);
+    v.sh4 = _mm_cvtsi32_si128(63 - (int)B.bits);
+    return v;
+}
+
+static inline HE_TARGET_AVX2 __m256i barrett_mul4(__m256i a, __m256i b, const BarrettVec& v) {
+    __m256i lo, hi;
+    mul64_full(a, b, lo, hi);
+    // q1 = z >> (bits - 1) < 2^(bits + 1)
+    __m256i q1 = _mm256_or_si256(_mm256_srl_epi64(lo, v.sh1), _mm256_sll_epi64(hi, v.sh2));
+    __m256i plo, phi;
+    mul64_full(q1, v.mu, plo, phi);
+    // q3 = (q1 * mu) >> (bits + 1)
+    __m256i q3 = _mm256_or_si256(_mm256_srl_epi64(plo, v.sh3), _mm256_sll_epi64(phi, v.sh4));
+    __m256i r = _mm256_sub_epi64(lo, mul64_lo(q3, v.q));
+    return csub(csub(r, v.q2), v.q);
+}
+
+static HE_TARGET_AVX2 void add_mod_avx2(const u64* a, const u64* b, u64* out, size_t n, u64 mod) {
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(out + i), csub(_mm256_add_epi64(x, y), vq));
+    }
+    add_mod_scalar(a + i, b + i, out + i, n - i, mod);
+}
+
+static HE_TARGET_AVX2 void sub_mod_avx2(const u64* a, const u64* b, u64* out, size_t n, u64 mod) {
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i d = _mm256_add_epi64(_mm256_sub_epi64(x, y), vq);
+        _mm256_storeu_si256((__m256i*)(out + i), csub(d, vq));
+    }
+    sub_mod_scalar(a + i, b + i, out + i, n - i, mod);
+}
+
+static HE_TARGET_AVX2 void negate_mod_avx2(const u64* a, u64* out, size_t n, u64 mod) {
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        // q - a is in (0, q], and maps a = 0 to q, which csub turns into 0
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        _mm256_storeu_si256((__m256i*)(out + i), csub(_mm256_sub_epi64(vq, x), vq));
+    }
+    negate_mod_scalar(a + i, out + i, n - i, mod);
+}
+
+static HE_TARGET_AVX2 void mul_scalar_mod_avx2(const u64* a, u64 c, u64 cs, u64* out, size_t n, u64 mod) {
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i vc = _mm256_set1_epi64x((long long)c);
+    const __m256i vcs = _mm256_set1_epi64x((long long)cs);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        _mm256_storeu_si256((__m256i*)(out + i), csub(shoup_mul_lazy4(x, vc, vcs, vq), vq));
+    }
+    mul_scalar_mod_scalar(a + i, c, cs, out + i, n - i, mod);
+}
+
+static HE_TARGET_AVX2 void mul_mod_avx2(const u64* a, const u64* b, u64* out, size_t n, const Barrett& B) {
+    const BarrettVec v = barrett_vec(B);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(out + i), barrett_mul4(x, y, v));
+    }
+    mul_mod_scalar(a + i, b + i, out + i, n - i, B);
+}
+
+static HE_TARGET_AVX2 void fma_mod_avx2(const u64* a, const u64* b, u64* acc, size_t n, const Barrett& B) {
+    const BarrettVec v = barrett_vec(B);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i s = _mm256_loadu_si256((const __m256i*)(acc + i));
+        s = _mm256_add_epi64(s, barrett_mul4(x, y, v));
+        _mm256_storeu_si256((__m256i*)(acc + i), csub(s, v.q));
+    }
+    fma_mod_scalar(a + i, b + i, acc + i, n - i, B);
+}
+
+static HE_TARGET_AVX2 void fma_scalar_mod_avx2(const u64* a, u64 c, u64 cs, u64* acc, size_t n, u64 mod) {
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i vc = _mm256_set1_epi64x((long long)c);
+    const __m256i vcs = _mm256_set1_epi64x((long long)cs);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i s = _mm256_loadu_si256((const __m256i*)(acc + i));
+        s = _mm256_add_epi64(s, csub(shoup_mul_lazy4(x, vc, vcs, vq), vq));
+        _mm256_storeu_si256((__m256i*)(acc + i), csub(s, vq));
+    }
+    fma_scalar_mod_scalar(a + i, c, cs, acc + i, n - i, mod);
+}
+
+// z < q^2 < 2^62 in each 64-bit lane -> z mod q
+static inline HE_TARGET_AVX2 __m256i barrett_reduce32(__m256i z, __m256i vq, __m256i v2q, __m256i vmu,
+                                                      __m128i sh1, __m128i sh3) {
+    __m256i q1 = _mm256_srl_epi64(z, sh1);
+    __m256i q3 = _mm256_srl_epi64(_mm256_mul_epu32(q1, vmu), sh3);
+    __m256i r = _mm256_sub_epi64(z, _mm256_mul_epu32(q3, vq));
+    return csub(csub(r, v2q), vq);
+}
+
+// 8 x u32: even and odd lanes are multiplied as 64-bit products by
+// _mm256_mul_epu32 and Barrett-reduced separately; for bits <= 31 every
+// factor (q1, mu, q3) fits the 32-bit multiplier inputs.
+static HE_TARGET_AVX2 void mul_mod_avx2_32(const u32* a, const u32* b, u32* out, size_t n, const Barrett& B) {
+    const __m256i vq = _mm256_set1_epi64x((long long)B.mod);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * B.mod));
+    const __m256i vmu = _mm256_set1_epi64x((long long)B.mu);
+    const __m128i sh1 = _mm_cvtsi32_si128((int)B.bits - 1);
+    const __m128i sh3 = _mm_cvtsi32_si128((int)B.bits + 1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i even = barrett_reduce32(_mm256_mul_epu32(x, y), vq, v2q, vmu, sh1, sh3);
+        __m256i odd = barrett_reduce32(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32)),
+                                       vq, v2q, vmu, sh1, sh3);
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_or_si256(even, _mm256_slli_epi64(odd, 32)));
+    }
+    mul_mod_scalar32(a + i, b + i, out + i, n - i, B);
+}
+
+#endif
+
+// --- dispatch ---
+
+void add_mod_array(const u64* a, const u64* b, u64* out, size_t n, u64 mod) {
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        add_mod_avx2(a, b, out, n, mod);
+        return;
+    }
+#endif
+    add_mod_scalar(a, b, out, n, mod);
+}
+
+void sub_mod_array(const u64* a, const u64* b, u64* out, size_t n, u64 mod) {
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        sub_mod_avx2(a, b, out, n, mod);
+        return;
+    }
+#endif
+    sub_mod_scalar(a, b, out, n, mod);
+}
+
+void negate_mod_array(const u64* a, u64* out, size_t n, u64 mod) {
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        negate_mod_avx2(a, out, n, mod);
+        return;
+    }
+#endif
+    negate_mod_scalar(a, out, n, mod);
+}
+
+void mul_scalar_mod_array(const u64* a, u64 c, u64* out, size_t n, u64 mod) {
+    const u64 cs = shoup_precompute(c, mod);
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        mul_scalar_mod_avx2(a, c, cs, out, n, mod);
+        return;
+    }
+#endif
+    mul_scalar_mod_scalar(a, c, cs, out, n, mod);
+}
+
+void mul_mod_array(const u64* a, const u64* b, u64* out, size_t n, u64 mod) {
+    const Barrett B(mod);
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        mul_mod_avx2(a, b, out, n, B);
+        return;
+    }
+#endif
+    mul_mod_scalar(a, b, out, n, B);
+}
+
+void mul_mod_array(const u32* a, const u32* b, u32* out, size_t n, u32 mod) {
+    const Barrett B(mod);
+#if HE_HAVE_AVX2_KERNELS
+    // mu < 2^32 unless mod is a power of two
+    if (host_has_avx2() && (B.mu >> 32) == 0) {
+        mul_mod_avx2_32(a, b, out, n, B);
+        return;
+    }
+#endif
+    mul_mod_scalar32(a, b, out, n, B);
+}
+
+void fma_mod_array(const u64* a, const u64* b, u64* acc, size_t n, u64 mod) {
+    const Barrett B(mod);
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        fma_mod_avx2(a, b, acc, n, B);
+        return;
+    }
+#endif
+    fma_mod_scalar(a, b, acc, n, B);
+}
+
+void fma_scalar_mod_array(const u64* a, u64 c, u64* acc, size_t n, u64 mod) {
+    const u64 cs = shoup_precompute(c, mod);
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        fma_scalar_mod_avx2(a, c, cs, acc, n, mod);
+        return;
+    }
+#endif
+    fma_scalar_mod_scalar(a, c, cs, acc, n, mod);
+}
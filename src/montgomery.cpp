@@ -20,18 +20,17 @@ void Montgomery::init(u64 m) {
     }
     ninv = (~inv) + 1; // ninv = -inv mod 2^64
     rmask = ~0ULL;
+    // R mod N, then R^2 mod N: the only divisions this context ever does
+    u64 r1 = (u64)(((__uint128_t)1 << 64) % mod);
+    r2 = (u64)((__uint128_t)r1 * r1 % mod);
     // quick sanity
     // (mod * ninv) % (1ULL<<64) should be 2^64 - 1
     // but we'll skip assert to avoid UB
 }
 
 u64 Montgomery::to_mont(u64 a) const {
-    // returns (a * R) mod mod; since R = 2^64, (a * R) % mod == (a << 64) % mod -> use mul by R%mod
-    // compute (a * R) mod mod = (a * (2^64 mod mod)) mod mod
-    // 2^64 mod mod can be computed as ( ( (u128)1 << 64 ) % mod ), but that's zero in 64-bit arithmetic.
-    // Simpler: to convert, compute (a * (R % mod)) % mod, with R%mod = (-mod) % mod ??? To avoid complexity, use regular multiplication by R via u128 then mod
-    __uint128_t t = ( __uint128_t)a * (__uint128_t(1) << 64);
-    return (u64)(t % mod);
+    // (a * R) mod N = REDC(a * R^2); no division once r2 is known
+    return mul(a, r2);
 }
 
 u64 Montgomery::from_mont(u64 a) const {
@@ -48,6 +47,12 @@ u64 Montgomery::mul(u64 a, u64 b) const {
     return res;
 }
 
+u64 Montgomery::mul_lazy(u64 a, u64 b) const {
+    __uint128_t t = (__uint128_t)a * (__uint128_t)b;
+    u64 m = (u64)t * ninv;
+    return (u64)((t + (__uint128_t)m * (__uint128_t)mod) >> 64);
+}
+
 u64 Montgomery::add(u64 a, u64 b) const {
     u64 s = a + b;
     if (s >= mod || s < a) s -= mod;
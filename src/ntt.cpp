@@ -1,5 +1,9 @@
 \
 #include "ntt.h"
+#include "shoup.h"
+#include "ntt_kernels.h"
+#include "ntt_blocked.h"
+#include "profile.h"
 #include <algorithm>
 #include <cassert>
 #include <cmath>
@@ -22,14 +26,62 @@ static u64 mod_pow(u64 a, u64 e, u64 mod) {
 
 // Bit reversal permutation
 void bit_reverse_permute(std::vector<u64>& a) {
-    size_t n = a.size();
-    unsigned int bits = 0;
-    while ((1u << bits) < n) ++bits;
-    for (size_t i = 1, j = 0; i < n; ++i) {
-        size_t bit = n >> 1;
-        for (; j & bit; bit >>= 1) j ^= bit;
-        j ^= bit;
-        if (i < j) std::swap(a[i], a[j]);
+    bit_reverse_permute(a.data(), a.size());
+}
+
+static size_t reverse_bits(size_t x, unsigned bits) {
+    size_t r = 0;
+    for (unsigned b = 0; b < bits; ++b) r |= ((x >> b) & 1) << (bits - 1 - b);
+    return r;
+}
+
+// Blocked in place (COBRA-style). An index is split as [hi | mid | lo] with
+// BR_TILE_BITS-bit hi and lo, and reversal maps (hi, mid, lo) to
+// (rev(lo), rev(mid), rev(hi)). For each pair mid, rev(mid) both 2^b x 2^b
+// tiles are read row by row into buffers and written back row by row, so
+// every cache line moved is used whole instead of one element per line.
+static const unsigned BR_TILE_BITS = 3;
+
+void bit_reverse_permute(u64* a, size_t n) {
+    HE_PROF_SCOPE(PROF_BIT_REVERSE);
+    unsigned bits = 0;
+    while ((size_t(1) << bits) < n) ++bits;
+    const unsigned B = BR_TILE_BITS;
+    const size_t T = size_t(1) << B;
+    if (bits < 2 * B + 2) {
+        for (size_t i = 1, j = 0; i < n; ++i) {
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) j ^= bit;
+            j ^= bit;
+            if (i < j) std::swap(a[i], a[j]);
+        }
+        return;
+    }
+    const unsigned mb = bits - 2 * B;
+    const unsigned hi_shift = mb + B;
+    size_t rev_lo[T];
+    for (size_t x = 0; x < T; ++x) rev_lo[x] = reverse_bits(x, B);
+    u64 t1[T * T], t2[T * T];
+    for (size_t mid = 0; mid < (size_t(1) << mb); ++mid) {
+        size_t rmid = reverse_bits(mid, mb);
+        if (rmid < mid) continue;
+        // t[rev(hi) * T + lo] = a[hi | mid | lo]
+        for (size_t hi = 0; hi < T; ++hi) {
+            const u64* row = a + (hi << hi_shift) + (mid << B);
+            const u64* rrow = a + (hi << hi_shift) + (rmid << B);
+            u64* d1 = t1 + rev_lo[hi] * T;
+            u64* d2 = t2 + rev_lo[hi] * T;
+            for (size_t lo = 0; lo < T; ++lo) d1[lo] = row[lo];
+            for (size_t lo = 0; lo < T; ++lo) d2[lo] = rrow[lo];
+        }
+        // a[rev(lo) | rev(mid) | rev(hi)] = a[hi | mid | lo], and the same
+        // for the rev(mid) tile (a no-op duplicate when mid == rev(mid))
+        for (size_t lo = 0; lo < T; ++lo) {
+            u64* row = a + (rev_lo[lo] << hi_shift) + (rmid << B);
+            u64* rrow = a + (rev_lo[lo] << hi_shift) + (mid << B);
+            for (size_t h = 0; h < T; ++h) row[h] = t1[h * T + lo];
+            for (size_t h = 0; h < T; ++h) rrow[h] = t2[h * T + lo];
+        }
     }
 }
 
@@ -43,9 +95,12 @@ std::vector<u64> compute_roots(u64 root, size_t n, u64 mod) {
 
 // In-place iterative Cooley-Tukey NTT (assumes n is power of two)
 void ntt(std::vector<u64>& a, const std::vector<u64>& roots, u64 mod) {
+    HE_PROF_SCOPE(PROF_NTT);
     size_t n = a.size();
     bit_reverse_permute(a);
+    HE_PROF_SCOPE(PROF_BUTTERFLIES);
     for (size_t len = 1; len < n; len <<= 1) {
+        HE_PROF_LAYER(__builtin_ctzll(len));
         for (size_t i = 0; i < n; i += 2 * len) {
             for (size_t j = 0; j < len; ++j) {
                 u64 u = a[i + j];
@@ -62,95 +117,338 @@ void ntt(std::vector<u64>& a, const std::vector<u64>& roots, u64 mod) {
 
 // Inverse NTT using modular inverse of n and reversed roots
 void intt(std::vector<u64>& a, const std::vector<u64>& roots, u64 mod) {
+    HE_PROF_SCOPE(PROF_INTT);
     size_t n = a.size();
     // compute inverse roots (conjugate)
     std::vector<u64> inv_roots(n);
     for (size_t i = 0; i < n; ++i) inv_roots[i] = roots[(n - i) % n];
     bit_reverse_permute(a);
-    for (size_t len = 1; len < n; len <<= 1) {
-        for (size_t i = 0; i < n; i += 2 * len) {
-            for (size_t j = 0; j < len; ++j) {
-                u64 u = a[i + j];
-                u64 v = (u128)a[i + j + len] * inv_roots[n / (2*len) * j] % mod;
-                u64 x = u + v;
-                if (x >= mod) x -= mod;
-                a[i + j] = x;
-                u64 y = (u >= v) ? u - v : u + mod - v;
-                a[i + j + len] = y;
+    {
+        HE_PROF_SCOPE(PROF_BUTTERFLIES);
+        for (size_t len = 1; len < n; len <<= 1) {
+            HE_PROF_LAYER(__builtin_ctzll(len));
+            for (size_t i = 0; i < n; i += 2 * len) {
+                for (size_t j = 0; j < len; ++j) {
+                    u64 u = a[i + j];
+                    u64 v = (u128)a[i + j + len] * inv_roots[n / (2*len) * j] % mod;
+                    u64 x = u + v;
+                    if (x >= mod) x -= mod;
+                    a[i + j] = x;
+                    u64 y = (u >= v) ? u - v : u + mod - v;
+                    a[i + j + len] = y;
+                }
             }
         }
     }
     // multiply by n^{-1}
+    HE_PROF_SCOPE(PROF_SCALE);
     u64 n_inv = mod_pow(n, mod - 2, mod);
     for (size_t i = 0; i < n; ++i) a[i] = (u128)a[i] * n_inv % mod;
 }
 
 
+// --- Plan-based transforms ---
+// Same transforms as above, but twiddles, n^{-1} and the Montgomery context
+// all come from a precomputed NttPlan, so nothing is allocated or derived
+// per call.
+
+void ntt(u64* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_NTT);
+    assert(n == plan.n);
+    u64 mod = plan.mod;
+    bit_reverse_permute(a, n);
+    {
+        HE_PROF_SCOPE(PROF_BUTTERFLIES);
+        if (plan.blocked) dit_layers_blocked(a, n, plan.fwd_tw.data(), plan.fwd_tw_shoup.data(), mod, plan.use_avx2,
+                                             plan.blocked_tile, plan.blocked_group);
+        else if (plan.use_avx2) dit_layers_shoup_avx2(a, n, plan.fwd_tw.data(), plan.fwd_tw_shoup.data(), mod);
+        else dit_layers_shoup(a, n, plan.fwd_tw.data(), plan.fwd_tw_shoup.data(), mod);
+    }
+    HE_PROF_SCOPE(PROF_FINAL_REDUCE);
+    if (plan.use_avx2) reduce_4q_avx2(a, n, mod);
+    else reduce_4q_array(a, n, mod);
+}
+
+void intt(u64* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_INTT);
+    assert(n == plan.n);
+    u64 mod = plan.mod;
+    bit_reverse_permute(a, n);
+    {
+        HE_PROF_SCOPE(PROF_BUTTERFLIES);
+        if (plan.blocked) dit_layers_blocked(a, n, plan.inv_tw.data(), plan.inv_tw_shoup.data(), mod, plan.use_avx2,
+                                             plan.blocked_tile, plan.blocked_group);
+        else if (plan.use_avx2) dit_layers_shoup_avx2(a, n, plan.inv_tw.data(), plan.inv_tw_shoup.data(), mod);
+        else dit_layers_shoup(a, n, plan.inv_tw.data(), plan.inv_tw_shoup.data(), mod);
+    }
+    // scaling by n^{-1} doubles as the final correction pass
+    HE_PROF_SCOPE(PROF_SCALE);
+    if (plan.use_avx2) mul_scalar_shoup_avx2(a, n, plan.n_inv, plan.n_inv_shoup, mod);
+    else mul_scalar_shoup_array(a, n, plan.n_inv, plan.n_inv_shoup, mod);
+}
+
+void ntt(std::vector<u64>& a, const NttPlan& plan) {
+    ntt(a.data(), a.size(), plan);
+}
+
+void intt(std::vector<u64>& a, const NttPlan& plan) {
+    intt(a.data(), a.size(), plan);
+}
+
+// --- Permutation-free transforms ---
+// Cooley-Tukey (natural -> bit-reversed) and Gentleman-Sande (bit-reversed ->
+// natural) over [m + i]-indexed twiddle tables. The negacyclic and cyclic
+// pairs share these drivers and differ only in the tables.
+
+static void ct_forward_tables(u64* a, size_t n, const u64* tw, const u64* tws, const NttPlan& plan) {
+    u64 mod = plan.mod;
+    if (plan.blocked) {
+        // the blocked schedule fuses the final reduction into its last stage
+        HE_PROF_SCOPE(PROF_BUTTERFLIES);
+        ct_forward_blocked(a, n, tw, tws, mod, plan.use_avx2, plan.blocked_tile, plan.blocked_group);
+        return;
+    }
+    {
+        HE_PROF_SCOPE(PROF_BUTTERFLIES);
+        if (plan.use_avx2) ct_forward_shoup_avx2(a, n, tw, tws, mod);
+        else ct_forward_shoup(a, n, tw, tws, mod);
+    }
+    HE_PROF_SCOPE(PROF_FINAL_REDUCE);
+    if (plan.use_avx2) reduce_4q_avx2(a, n, mod);
+    else reduce_4q_array(a, n, mod);
+}
+
+static void gs_inverse_tables(u64* a, size_t n, const u64* tw, const u64* tws,
+                              u64 last_w, u64 last_ws, const NttPlan& plan) {
+    // n^{-1} is folded into the last stage, so there is no separate scale
+    HE_PROF_SCOPE(PROF_BUTTERFLIES);
+    if (plan.blocked) {
+        gs_inverse_blocked(a, n, tw, tws, last_w, last_ws, plan.n_inv, plan.n_inv_shoup, plan.mod, plan.use_avx2,
+                           plan.blocked_tile, plan.blocked_group);
+        return;
+    }
+    if (plan.use_avx2) {
+        gs_inverse_shoup_avx2(a, n, tw, tws, last_w, last_ws, plan.n_inv, plan.n_inv_shoup, plan.mod);
+        return;
+    }
+    gs_inverse_shoup(a, n, tw, tws, last_w, last_ws, plan.n_inv, plan.n_inv_shoup, plan.mod);
+}
+
+void ntt_to_bitrev(u64* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_NTT_TO_BITREV);
+    assert(n == plan.n);
+    ct_forward_tables(a, n, plan.br_fwd_tw.data(), plan.br_fwd_tw_shoup.data(), plan);
+}
+
+void intt_from_bitrev(u64* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_INTT_FROM_BITREV);
+    assert(n == plan.n);
+    // the last stage's twiddle is 1, so only n^{-1} is folded into it
+    gs_inverse_tables(a, n, plan.br_inv_tw.data(), plan.br_inv_tw_shoup.data(),
+                      plan.n_inv, plan.n_inv_shoup, plan);
+}
+
+void ntt_to_bitrev(std::vector<u64>& a, const NttPlan& plan) {
+    ntt_to_bitrev(a.data(), a.size(), plan);
+}
+
+void intt_from_bitrev(std::vector<u64>& a, const NttPlan& plan) {
+    intt_from_bitrev(a.data(), a.size(), plan);
+}
+
+// 32-bit storage (plan.narrow): the same CT/GS pair on u32 coefficients.
+void ntt_to_bitrev(u32* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_NTT_TO_BITREV);
+    HE_PROF_SCOPE(PROF_BUTTERFLIES);
+    assert(n == plan.n && plan.narrow);
+    if (plan.use_avx2) ct_forward_shoup32_avx2(a, n, plan.br_fwd_tw32.data(), plan.br_fwd_tw32_shoup.data(), (u32)plan.mod);
+    else ct_forward_shoup32(a, n, plan.br_fwd_tw32.data(), plan.br_fwd_tw32_shoup.data(), (u32)plan.mod);
+}
+
+void intt_from_bitrev(u32* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_INTT_FROM_BITREV);
+    HE_PROF_SCOPE(PROF_BUTTERFLIES);
+    assert(n == plan.n && plan.narrow);
+    const u32 mod = (u32)plan.mod, n_inv = (u32)plan.n_inv;
+    if (plan.use_avx2) {
+        gs_inverse_shoup32_avx2(a, n, plan.br_inv_tw32.data(), plan.br_inv_tw32_shoup.data(),
+                                n_inv, plan.n_inv32_shoup, n_inv, plan.n_inv32_shoup, mod);
+    } else {
+        gs_inverse_shoup32(a, n, plan.br_inv_tw32.data(), plan.br_inv_tw32_shoup.data(),
+                           n_inv, plan.n_inv32_shoup, n_inv, plan.n_inv32_shoup, mod);
+    }
+}
+
+void ntt_to_bitrev(std::vector<u32>& a, const NttPlan& plan) {
+    ntt_to_bitrev(a.data(), a.size(), plan);
+}
+
+void intt_from_bitrev(std::vector<u32>& a, const NttPlan& plan) {
+    intt_from_bitrev(a.data(), a.size(), plan);
+}
+
+// --- Negacyclic transforms for Z_q[X]/(X^n + 1) ---
+// psi (a primitive 2n-th root) is merged into the bit-reversed twiddle
+// tables, so there is no pre/post multiplication by psi powers, no zero
+// padding and no bit_reverse_permute: the forward transform leaves its output
+// in bit-reversed order and the inverse consumes exactly that order.
+
+void ntt_negacyclic(u64* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_NTT_NEGACYCLIC);
+    assert(n == plan.n && plan.has_negacyclic());
+    ct_forward_tables(a, n, plan.nega_fwd_tw.data(), plan.nega_fwd_tw_shoup.data(), plan);
+}
+
+void intt_negacyclic(u64* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_INTT_NEGACYCLIC);
+    assert(n == plan.n && plan.has_negacyclic());
+    gs_inverse_tables(a, n, plan.nega_inv_tw.data(), plan.nega_inv_tw_shoup.data(),
+                      plan.nega_inv_last, plan.nega_inv_last_shoup, plan);
+}
+
+void ntt_negacyclic(std::vector<u64>& a, const NttPlan& plan) {
+    ntt_negacyclic(a.data(), a.size(), plan);
+}
+
+void intt_negacyclic(std::vector<u64>& a, const NttPlan& plan) {
+    intt_negacyclic(a.data(), a.size(), plan);
+}
+
+void ntt_negacyclic(u32* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_NTT_NEGACYCLIC);
+    HE_PROF_SCOPE(PROF_BUTTERFLIES);
+    assert(n == plan.n && plan.has_negacyclic() && plan.narrow);
+    if (plan.use_avx2) ct_forward_shoup32_avx2(a, n, plan.nega_fwd_tw32.data(), plan.nega_fwd_tw32_shoup.data(), (u32)plan.mod);
+    else ct_forward_shoup32(a, n, plan.nega_fwd_tw32.data(), plan.nega_fwd_tw32_shoup.data(), (u32)plan.mod);
+}
+
+void intt_negacyclic(u32* a, size_t n, const NttPlan& plan) {
+    HE_PROF_SCOPE(PROF_INTT_NEGACYCLIC);
+    HE_PROF_SCOPE(PROF_BUTTERFLIES);
+    assert(n == plan.n && plan.has_negacyclic() && plan.narrow);
+    const u32 mod = (u32)plan.mod;
+    if (plan.use_avx2) {
+        gs_inverse_shoup32_avx2(a, n, plan.nega_inv_tw32.data(), plan.nega_inv_tw32_shoup.data(),
+                                (u32)plan.nega_inv_last, plan.nega_inv_last32_shoup,
+                                (u32)plan.n_inv, plan.n_inv32_shoup, mod);
+    } else {
+        gs_inverse_shoup32(a, n, plan.nega_inv_tw32.data(), plan.nega_inv_tw32_shoup.data(),
+                           (u32)plan.nega_inv_last, plan.nega_inv_last32_shoup,
+                           (u32)plan.n_inv, plan.n_inv32_shoup, mod);
+    }
+}
+
+void ntt_negacyclic(std::vector<u32>& a, const NttPlan& plan) {
+    ntt_negacyclic(a.data(), a.size(), plan);
+}
+
+void intt_negacyclic(std::vector<u32>& a, const NttPlan& plan) {
+    intt_negacyclic(a.data(), a.size(), plan);
+}
+
+
 // --- Montgomery + lazy variant additions ---
 #include "montgomery.h"
 
-// A variant of NTT that uses Montgomery multiplication and lite lazy reduction.
+// Harvey DIT layers with lazy Montgomery twiddle products; values stay in
+// [0, 4*mod) between layers exactly as in dit_layers_shoup, radix-4 pairs
+// included.
+// 'natural_roots' selects the table layout: w[step * j] for a natural-order
+// root table (root-vector API) or w[len + j] for a stage-ordered plan table.
+static inline void dit_bfly_mont(u64& x, u64& y, u64 w, u64 two_q, const Montgomery& M) {
+    u64 u = x - (two_q & (0 - (u64)(x >= two_q)));  // branch-free, as in ntt_kernels.cpp
+    u64 t = M.mul_lazy(y, w);
+    x = u + t;
+    y = u - t + two_q;
+}
+
+static void dit_layers_mont(u64* a, size_t n, const u64* w, bool natural_roots,
+                            const Montgomery& M) {
+    const u64 two_q = 2 * M.mod;
+    HE_PROF_SCOPE(PROF_BUTTERFLIES);
+    size_t len = 1;
+    for (; 4 * len <= n; len <<= 2) {
+        HE_PROF_LAYER(__builtin_ctzll(len));
+        // layer len uses w1[s1 * j]; layer 2len uses w2[s2 * j] and w2[s2 * (j + len)]
+        const size_t s1 = natural_roots ? n / (2 * len) : 1;
+        const size_t s2 = natural_roots ? n / (4 * len) : 1;
+        const u64* w1 = natural_roots ? w : w + len;
+        const u64* w2 = natural_roots ? w : w + 2 * len;
+        for (size_t i = 0; i < n; i += 4 * len) {
+            u64* x = a + i;
+            for (size_t j = 0; j < len; ++j) {
+                u64 a0 = x[j], a1 = x[j + len], a2 = x[j + 2 * len], a3 = x[j + 3 * len];
+                dit_bfly_mont(a0, a1, w1[s1 * j], two_q, M);
+                dit_bfly_mont(a2, a3, w1[s1 * j], two_q, M);
+                dit_bfly_mont(a0, a2, w2[s2 * j], two_q, M);
+                dit_bfly_mont(a1, a3, w2[s2 * (j + len)], two_q, M);
+                x[j] = a0;
+                x[j + len] = a1;
+                x[j + 2 * len] = a2;
+                x[j + 3 * len] = a3;
+            }
+        }
+    }
+    // odd log2(n): the last layer (len = n/2, one block, step 1) on its own
+    if (len < n) {
+        HE_PROF_LAYER(__builtin_ctzll(len));
+        const u64* wl = natural_roots ? w : w + len;
+        for (size_t j = 0; j < len; ++j) dit_bfly_mont(a[j], a[j + len], wl[j], two_q, M);
+    }
+}
+
+// A variant of NTT that uses Montgomery multiplication and lazy reduction.
 // This function assumes 'roots' are given in standard representation (not Montgomery).
 void ntt_montgomery(std::vector<u64>& a, const std::vector<u64>& roots, u64 mod) {
+    HE_PROF_SCOPE(PROF_NTT_MONTGOMERY);
     size_t n = a.size();
-    // initialize montgomery context
     Montgomery M(mod);
-    // convert a into Montgomery domain: a * R mod mod
-    for (size_t i = 0; i < n; ++i) {
-        a[i] = M.to_mont(a[i]);
-    }
-    // precompute roots in Montgomery domain
     std::vector<u64> mroots(n);
-    for (size_t i = 0; i < n; ++i) mroots[i] = M.to_mont(roots[i]);
+    {
+        // convert a and the roots into Montgomery domain (REDC by R^2, no division)
+        HE_PROF_SCOPE(PROF_TO_MONT);
+        for (size_t i = 0; i < n; ++i) a[i] = M.to_mont(a[i]);
+        for (size_t i = 0; i < n; ++i) mroots[i] = M.to_mont(roots[i]);
+    }
 
-    // bit reverse
     bit_reverse_permute(a);
+    dit_layers_mont(a.data(), n, mroots.data(), true, M);
+    // from_mont maps [0, 4q) straight to [0, q), so it is also the final correction
+    HE_PROF_SCOPE(PROF_FROM_MONT);
+    for (size_t i = 0; i < n; ++i) a[i] = M.from_mont(a[i]);
+}
 
-    // iterative Cooley-Tukey with Montgomery mul and lazy reduction
-    for (size_t len = 1; len < n; len <<= 1) {
-        size_t step = n / (2 * len);
-        for (size_t i = 0; i < n; i += 2 * len) {
-            for (size_t j = 0; j < len; ++j) {
-                u64 u = a[i + j];
-                // v = a[i+j+len] * w  (w in montgomery)
-                u64 v = M.mul(a[i + j + len], mroots[step * j]);
-                // now allow lazy sums: u + v may be up to 2*mod-2, since u and v are montgomery residues < mod
-                u64 x = u + v;
-                if (x >= mod) x -= mod; // reduce if exceeded mod
-                a[i + j] = x;
-                // y = u - v mod
-                u64 y = (u >= v) ? (u - v) : (u + mod - v);
-                a[i + j + len] = y;
-            }
-        }
-    }
-    // convert back from Montgomery domain: multiply by 1 (Montgomery reduction)
-    for (size_t i = 0; i < n; ++i) {
-        a[i] = M.from_mont(a[i]);
+// Montgomery variant using the plan's precomputed Montgomery twiddles.
+void ntt_montgomery(u64* a, size_t n, const NttPlan& plan) {
+    assert(n == plan.n);
+    HE_PROF_SCOPE(PROF_NTT_MONTGOMERY);
+    const Montgomery& M = plan.mont;
+    {
+        HE_PROF_SCOPE(PROF_TO_MONT);
+        for (size_t i = 0; i < n; ++i) a[i] = M.to_mont(a[i]);
     }
+    bit_reverse_permute(a, n);
+    dit_layers_mont(a, n, plan.fwd_tw_mont.data(), false, M);
+    HE_PROF_SCOPE(PROF_FROM_MONT);
+    for (size_t i = 0; i < n; ++i) a[i] = M.from_mont(a[i]);
 }
 
+void ntt_montgomery(std::vector<u64>& a, const NttPlan& plan) {
+    ntt_montgomery(a.data(), a.size(), plan);
+}
 
 // Core NTT loop assuming 'a' and 'mroots' are already in Montgomery domain.
 // Does NOT perform conversions; useful for microbenching the transform itself.
+// Output is fully reduced to [0, mod), still in Montgomery domain.
+void ntt_montgomery_core(u64* a, size_t n, const u64* mroots, u64 mod) {
+    Montgomery M(mod);
+    bit_reverse_permute(a, n);
+    dit_layers_mont(a, n, mroots, true, M);
+    reduce_4q_array(a, n, mod);
+}
+
 void ntt_montgomery_core(std::vector<u64>& a, const std::vector<u64>& mroots, u64 mod) {
-    size_t n = a.size();
-    // bit reverse
-    bit_reverse_permute(a);
-    for (size_t len = 1; len < n; len <<= 1) {
-        size_t step = n / (2 * len);
-        for (size_t i = 0; i < n; i += 2 * len) {
-            for (size_t j = 0; j < len; ++j) {
-                u64 u = a[i + j];
-                u64 v = ( (__uint128_t)a[i + j + len] * mroots[step * j] ) % mod; // mroots assumed mont, but here still use mul mod as safe placeholder
-                u64 x = u + v;
-                if (x >= mod) x -= mod;
-                a[i + j] = x;
-                u64 y = (u >= v) ? (u - v) : (u + mod - v);
-                a[i + j + len] = y;
-            }
-        }
-    }
+    ntt_montgomery_core(a.data(), a.size(), mroots.data(), mod);
 }
 
 
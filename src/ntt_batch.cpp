@@ -0,0 +1,137 @@
+#include "ntt_batch.h"
+#include "ntt.h"
+#include "ntt_kernels.h"
+#include "ntt_simd.h"
+#include "aligned_vector.h"
+#include <cassert>
+
+using u64 = uint64_t;
+
+// A group of L interleaved transforms of size n is laid out like one array of
+// size L*n in which the stage with m blocks has half-size L*t instead of t:
+// butterfly (j, j + t) of lane l sits at (L*j + l, L*(j + t) + l). Block i
+// of that stage still uses twiddle tw[m + i], so the existing range kernels
+// run the batch unchanged on the wide array, stopping after the stage with
+// n/2 blocks. With L = 4, t' = 4t >= 4 in every stage, which is exactly the
+// condition for the AVX2 range kernels to take their vector path.
+
+static void ct_interleaved(u64* a, size_t groups, const u64* tw, const u64* tws, const NttPlan& plan) {
+    const size_t n = plan.n, N = NTT_BATCH_LANES * n;
+    for (size_t g = 0; g < groups; ++g) {
+        u64* x = a + g * N;
+        for (size_t m = 1; m < n; m <<= 1) {
+            if (plan.use_avx2) ct_stage_shoup_range_avx2(x, N, m, 0, N / 2, tw, tws, plan.mod);
+            else ct_stage_shoup_range(x, N, m, 0, N / 2, tw, tws, plan.mod);
+        }
+        if (plan.use_avx2) reduce_4q_avx2(x, N, plan.mod);
+        else reduce_4q_array(x, N, plan.mod);
+    }
+}
+
+static void gs_interleaved(u64* a, size_t groups, const u64* tw, const u64* tws,
+                           u64 last_w, u64 last_ws, const NttPlan& plan) {
+    const size_t n = plan.n, N = NTT_BATCH_LANES * n;
+    for (size_t g = 0; g < groups; ++g) {
+        u64* x = a + g * N;
+        for (size_t m = n / 2; m > 1; m >>= 1) {
+            if (plan.use_avx2) gs_stage_shoup_range_avx2(x, N, m, 0, N / 2, tw, tws, plan.mod);
+            else gs_stage_shoup_range(x, N, m, 0, N / 2, tw, tws, plan.mod);
+        }
+        if (plan.use_avx2) {
+            gs_last_stage_shoup_range_avx2(x, N, 0, N / 2, last_w, last_ws, plan.n_inv, plan.n_inv_shoup, plan.mod);
+        } else {
+            gs_last_stage_shoup_range(x, N, 0, N / 2, last_w, last_ws, plan.n_inv, plan.n_inv_shoup, plan.mod);
+        }
+    }
+}
+
+void batch_interleave(const u64* const* in, size_t count, size_t n, u64* out) {
+    const size_t L = NTT_BATCH_LANES;
+    const size_t groups = (count + L - 1) / L;
+    for (size_t g = 0; g < groups; ++g) {
+        u64* dst = out + g * L * n;
+        for (size_t l = 0; l < L; ++l) {
+            size_t p = g * L + l;
+            if (p < count) {
+                const u64* src = in[p];
+                for (size_t j = 0; j < n; ++j) dst[j * L + l] = src[j];
+            } else {
+                for (size_t j = 0; j < n; ++j) dst[j * L + l] = 0;
+            }
+        }
+    }
+}
+
+void batch_deinterleave(const u64* in, size_t count, size_t n, u64* const* out) {
+    const size_t L = NTT_BATCH_LANES;
+    for (size_t p = 0; p < count; ++p) {
+        const u64* src = in + (p / L) * L * n + p % L;
+        u64* dst = out[p];
+        for (size_t j = 0; j < n; ++j) dst[j] = src[j * L];
+    }
+}
+
+// The contiguous forms, one group of lane pointers at a time.
+void batch_interleave(const u64* in, size_t count, size_t n, u64* out) {
+    const size_t L = NTT_BATCH_LANES;
+    for (size_t p = 0; p < count; p += L) {
+        const u64* lanes[NTT_BATCH_LANES];
+        const size_t k = count - p < L ? count - p : L;
+        for (size_t l = 0; l < k; ++l) lanes[l] = in + (p + l) * n;
+        batch_interleave(lanes, k, n, out + p * n);
+    }
+}
+
+void batch_deinterleave(const u64* in, size_t count, size_t n, u64* out) {
+    const size_t L = NTT_BATCH_LANES;
+    for (size_t p = 0; p < count; p += L) {
+        u64* lanes[NTT_BATCH_LANES];
+        const size_t k = count - p < L ? count - p : L;
+        for (size_t l = 0; l < k; ++l) lanes[l] = out + (p + l) * n;
+        batch_deinterleave(in + p * n, k, n, lanes);
+    }
+}
+
+void ntt_negacyclic_interleaved(u64* a, size_t groups, const NttPlan& plan) {
+    assert(plan.has_negacyclic());
+    ct_interleaved(a, groups, plan.nega_fwd_tw.data(), plan.nega_fwd_tw_shoup.data(), plan);
+}
+
+void intt_negacyclic_interleaved(u64* a, size_t groups, const NttPlan& plan) {
+    assert(plan.has_negacyclic());
+    gs_interleaved(a, groups, plan.nega_inv_tw.data(), plan.nega_inv_tw_shoup.data(),
+                   plan.nega_inv_last, plan.nega_inv_last_shoup, plan);
+}
+
+void ntt_to_bitrev_interleaved(u64* a, size_t groups, const NttPlan& plan) {
+    ct_interleaved(a, groups, plan.br_fwd_tw.data(), plan.br_fwd_tw_shoup.data(), plan);
+}
+
+void intt_from_bitrev_interleaved(u64* a, size_t groups, const NttPlan& plan) {
+    gs_interleaved(a, groups, plan.br_inv_tw.data(), plan.br_inv_tw_shoup.data(),
+                   plan.n_inv, plan.n_inv_shoup, plan);
+}
+
+// Leading whole groups of a contiguous batch through the interleaved
+// kernels when the plan is tuned for it; returns how many were done.
+static size_t batch_via_interleaved(u64* a, size_t count, const NttPlan& plan, bool inverse) {
+    if (!plan.batch_interleave_min || count < plan.batch_interleave_min) return 0;
+    const size_t done = count / NTT_BATCH_LANES * NTT_BATCH_LANES;
+    if (!done) return 0;
+    aligned_vector<u64> t(done * plan.n);
+    batch_interleave(a, done, plan.n, t.data());
+    if (inverse) intt_negacyclic_interleaved(t.data(), done / NTT_BATCH_LANES, plan);
+    else ntt_negacyclic_interleaved(t.data(), done / NTT_BATCH_LANES, plan);
+    batch_deinterleave(t.data(), done, plan.n, a);
+    return done;
+}
+
+void ntt_negacyclic_batch(u64* a, size_t count, const NttPlan& plan) {
+    for (size_t i = batch_via_interleaved(a, count, plan, false); i < count; ++i)
+        ntt_negacyclic(a + i * plan.n, plan.n, plan);
+}
+
+void intt_negacyclic_batch(u64* a, size_t count, const NttPlan& plan) {
+    for (size_t i = batch_via_interleaved(a, count, plan, true); i < count; ++i)
+        intt_negacyclic(a + i * plan.n, plan.n, plan);
+}
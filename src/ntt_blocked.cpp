@@ -0,0 +1,129 @@
+#include "ntt_blocked.h"
+#include "ntt_kernels.h"
+#include "ntt_simd.h"
+
+using u64 = uint64_t;
+
+static const size_t BLOCKED_RUN = BLOCKED_TILE_MIN;
+
+static inline void ct_run(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                          const u64* tw, const u64* tws, u64 mod, bool avx2) {
+    if (avx2) ct_stage_shoup_range_avx2(a, n, m, k0, k1, tw, tws, mod);
+    else ct_stage_shoup_range(a, n, m, k0, k1, tw, tws, mod);
+}
+
+static inline void gs_run(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                          const u64* tw, const u64* tws, u64 mod, bool avx2) {
+    if (avx2) gs_stage_shoup_range_avx2(a, n, m, k0, k1, tw, tws, mod);
+    else gs_stage_shoup_range(a, n, m, k0, k1, tw, tws, mod);
+}
+
+void ct_forward_blocked(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod, bool avx2,
+                        size_t tile, size_t group) {
+    // long-stride stages: m blocks of size n/m > tile
+    size_t m = 1;
+    while (n / m > tile) {
+        size_t r = 1;
+        while (r < group && (n / m >> (r + 1)) >= tile) ++r;
+        const size_t t_min = n / (2 * (m << (r - 1)));
+        for (size_t b = 0; b < m; ++b) {
+            for (size_t j0 = 0; j0 < t_min; j0 += BLOCKED_RUN) {
+                for (size_t s = 0; s < r; ++s) {
+                    size_t mm = m << s, t = n / (2 * mm);
+                    for (size_t i = b << s; i < (b + 1) << s; ++i) {
+                        for (size_t c = 0; c < t; c += t_min) {
+                            size_t k = i * t + c + j0;
+                            ct_run(a, n, mm, k, k + BLOCKED_RUN, tw, tws, mod, avx2);
+                        }
+                    }
+                }
+            }
+        }
+        m <<= r;
+    }
+    // short-stride stages, one tile at a time, then the final reduction
+    const size_t half = n / (2 * m);
+    for (size_t b = 0; b < m; ++b) {
+        for (size_t mm = m; mm < n; mm <<= 1) ct_run(a, n, mm, b * half, (b + 1) * half, tw, tws, mod, avx2);
+        if (avx2) reduce_4q_avx2(a + 2 * b * half, 2 * half, mod);
+        else reduce_4q_array(a + 2 * b * half, 2 * half, mod);
+    }
+}
+
+void gs_inverse_blocked(u64* a, size_t n, const u64* tw, const u64* tws,
+                        u64 last_w, u64 last_ws, u64 n_inv, u64 n_inv_shoup, u64 mod, bool avx2,
+                        size_t tile, size_t group) {
+    if (n <= tile) {
+        if (avx2) gs_inverse_shoup_avx2(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
+        else gs_inverse_shoup(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
+        return;
+    }
+    // short-stride stages tile by tile: stages n/2 down to m
+    size_t m = n / tile;
+    const size_t half = n / (2 * m);
+    for (size_t b = 0; b < m; ++b) {
+        for (size_t mm = n / 2; mm >= m; mm >>= 1) gs_run(a, n, mm, b * half, (b + 1) * half, tw, tws, mod, avx2);
+    }
+    // long-stride stages m/2 .. 1 in groups; the stage with one block is the
+    // folded last stage
+    while (m > 1) {
+        size_t r = 1;
+        while (r < group && (m >> (r + 1)) >= 1) ++r;
+        const size_t m0 = m >> r;
+        const size_t t_min = n / m;
+        for (size_t b = 0; b < m0; ++b) {
+            for (size_t j0 = 0; j0 < t_min; j0 += BLOCKED_RUN) {
+                for (size_t s = r; s-- > 0;) {
+                    size_t mm = m0 << s, t = n / (2 * mm);
+                    for (size_t i = b << s; i < (b + 1) << s; ++i) {
+                        for (size_t c = 0; c < t; c += t_min) {
+                            size_t k = i * t + c + j0;
+                            if (mm > 1) {
+                                gs_run(a, n, mm, k, k + BLOCKED_RUN, tw, tws, mod, avx2);
+                            } else if (avx2) {
+                                gs_last_stage_shoup_range_avx2(a, n, k, k + BLOCKED_RUN, last_w, last_ws,
+                                                               n_inv, n_inv_shoup, mod);
+                            } else {
+                                gs_last_stage_shoup_range(a, n, k, k + BLOCKED_RUN, last_w, last_ws,
+                                                          n_inv, n_inv_shoup, mod);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        m = m0;
+    }
+}
+
+void dit_layers_blocked(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod, bool avx2,
+                        size_t tile, size_t group) {
+    // DIT twiddles depend only on the offset inside a block, so the first
+    // log2(tile) layers are just the full transform of each tile
+    if (tile > n) tile = n;
+    for (size_t off = 0; off < n; off += tile) {
+        if (avx2) dit_layers_shoup_avx2(a + off, tile, tw, tws, mod);
+        else dit_layers_shoup(a + off, tile, tw, tws, mod);
+    }
+    size_t len = tile;
+    while (len < n) {
+        size_t r = 1;
+        while (r < group && (len << (r + 1)) <= n) ++r;
+        const size_t span = len << r;
+        for (size_t g = 0; g < n; g += span) {
+            for (size_t j0 = 0; j0 < len; j0 += BLOCKED_RUN) {
+                for (size_t s = 0; s < r; ++s) {
+                    size_t L = len << s;
+                    for (size_t blk = g; blk < g + span; blk += 2 * L) {
+                        for (size_t c = 0; c < L; c += len) {
+                            size_t j = c + j0;
+                            if (avx2) dit_run_shoup_avx2(a + blk + j, L, tw + L + j, tws + L + j, BLOCKED_RUN, mod);
+                            else dit_run_shoup(a + blk + j, L, tw + L + j, tws + L + j, BLOCKED_RUN, mod);
+                        }
+                    }
+                }
+            }
+        }
+        len = span;
+    }
+}
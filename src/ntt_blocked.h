@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+using u64 = uint64_t;
+
+// Cache-blocked drivers for transforms larger than L2 (internal, not
+// installed). They run the same butterflies as the breadth-first loops, in
+// an order that keeps the working set small:
+//
+//  - the stages whose butterfly blocks fit in 'tile' elements run
+//    depth-first, one tile at a time, entirely in cache;
+//  - the remaining (long-stride) stages are fused in groups of up to
+//    'group', processed column by column: a column is 2^r runs of
+//    BLOCKED_RUN consecutive elements spaced by the group's smallest stride,
+//    and is closed under every butterfly of the group, so it is loaded once
+//    per group instead of once per stage.
+//
+// Twiddles come from the existing stage-ordered tables; within a stage each
+// block (CT/GS) or run (DIT) reads them contiguously. 'avx2' selects the
+// 4-lane kernels. Results are identical to the unblocked loops for every
+// tile (a power of two, at least BLOCKED_TILE_MIN) and group >= 1; the plan
+// carries both (plan.blocked_tile / blocked_group), tuned per host.
+
+// Transforms at or above this size take the blocked path.
+static const size_t BLOCKED_MIN_N = size_t(1) << 17;
+
+// Default shape. A tile of 2^12 coefficients (32 KiB) stays in L1 for all
+// of its stages; groups of four stages over runs of 64 coefficients touch
+// 16 x 512 bytes per column. Chosen with bench/bench_ntt.cpp on a 48 KiB
+// L1 / 2 MiB L2 core.
+static const size_t BLOCKED_TILE_N = size_t(1) << 12;
+static const size_t BLOCKED_GROUP = 4;
+// A tile must hold at least one run of each column.
+static const size_t BLOCKED_TILE_MIN = 64;
+
+// Negacyclic CT, natural -> bit-reversed, output fully reduced to [0, q).
+void ct_forward_blocked(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod, bool avx2,
+                        size_t tile, size_t group);
+// Negacyclic GS, bit-reversed -> natural with n^{-1} folded in, [0, q) out.
+void gs_inverse_blocked(u64* a, size_t n, const u64* tw, const u64* tws,
+                        u64 last_w, u64 last_ws, u64 n_inv, u64 n_inv_shoup, u64 mod, bool avx2,
+                        size_t tile, size_t group);
+// Cyclic DIT layers over bit-reversed input, stage-ordered tw[len + j];
+// values left in [0, 4q) like dit_layers_shoup.
+void dit_layers_blocked(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod, bool avx2,
+                        size_t tile, size_t group);
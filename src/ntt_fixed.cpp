@@ -0,0 +1,283 @@
+#include "ntt_fixed.h"
+#include "ntt.h"
+#include "ntt_kernels.h"
+#include "shoup.h"
+#include "cpu_features.h"
+#include "simd_avx2.h"
+#include "profile.h"
+#include <cassert>
+
+using u64 = uint64_t;
+
+// Stage S of the forward transform has m = 2^S blocks of half-size
+// t = n >> (S + 1); the inverse walks the same stages from S = LOGN - 1 down
+// to 0, the last one with n^{-1} folded in. Each stage is its own template
+// instance, so t, the block count and q are immediates in every loop.
+
+template <u64 Q, unsigned LOGN, unsigned S>
+static void ct_stages_scalar(u64* a, const u64* tw, const u64* tws) {
+    constexpr size_t n = size_t(1) << LOGN, m = size_t(1) << S, t = n >> (S + 1);
+    constexpr u64 two_q = 2 * Q;
+    for (size_t i = 0; i < m; ++i) {
+        const u64 w = tw[m + i], ws = tws[m + i];
+        u64* x = a + 2 * i * t;
+        u64* y = x + t;
+        for (size_t j = 0; j < t; ++j) {
+            u64 u = x[j];
+            if (u >= two_q) u -= two_q;
+            u64 v = shoup_mul_lazy(y[j], w, ws, Q);
+            u64 s = u + v, d = u - v + two_q;
+            if (S + 1 == LOGN) {
+                s = reduce_4q(s, Q);
+                d = reduce_4q(d, Q);
+            }
+            x[j] = s;
+            y[j] = d;
+        }
+    }
+    if constexpr (S + 1 < LOGN) ct_stages_scalar<Q, LOGN, S + 1>(a, tw, tws);
+}
+
+template <u64 Q, unsigned LOGN, unsigned S>
+static void gs_stages_scalar(u64* a, const u64* tw, const u64* tws) {
+    constexpr size_t n = size_t(1) << LOGN, m = size_t(1) << S, t = n >> (S + 1);
+    constexpr u64 two_q = 2 * Q;
+    using N = Ntt<Q, LOGN>;
+    if constexpr (S == 0) {
+        const u64 lw = N::tables.inv_last, lws = N::tables.inv_last_shoup;
+        for (size_t j = 0; j < t; ++j) {
+            u64 u = a[j], v = a[j + t];
+            a[j] = shoup_mul(u + v, N::n_inv, N::n_inv_shoup, Q);
+            a[j + t] = shoup_mul(u - v + two_q, lw, lws, Q);
+        }
+    } else {
+        for (size_t i = 0; i < m; ++i) {
+            const u64 w = tw[m + i], ws = tws[m + i];
+            u64* x = a + 2 * i * t;
+            u64* y = x + t;
+            for (size_t j = 0; j < t; ++j) {
+                u64 u = x[j], v = y[j];
+                u64 s = u + v;
+                if (s >= two_q) s -= two_q;
+                x[j] = s;
+                y[j] = shoup_mul_lazy(u - v + two_q, w, ws, Q);
+            }
+        }
+        gs_stages_scalar<Q, LOGN, S - 1>(a, tw, tws);
+    }
+}
+
+#if HE_HAVE_AVX2_KERNELS
+
+template <u64 Q>
+static inline HE_TARGET_AVX2 void ct_bfly4(__m256i& x, __m256i& y, __m256i w, __m256i ws, bool reduce) {
+    const __m256i vq = _mm256_set1_epi64x((long long)Q);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * Q));
+    __m256i u = csub(x, v2q);
+    __m256i v = shoup_mul_lazy4(y, w, ws, vq);
+    x = _mm256_add_epi64(u, v);
+    y = _mm256_add_epi64(_mm256_sub_epi64(u, v), v2q);
+    if (reduce) {
+        x = csub(csub(x, v2q), vq);
+        y = csub(csub(y, v2q), vq);
+    }
+}
+
+template <u64 Q>
+static inline HE_TARGET_AVX2 void gs_bfly4(__m256i& x, __m256i& y, __m256i w, __m256i ws) {
+    const __m256i vq = _mm256_set1_epi64x((long long)Q);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * Q));
+    __m256i s = csub(_mm256_add_epi64(x, y), v2q);
+    __m256i d = _mm256_add_epi64(_mm256_sub_epi64(x, y), v2q);
+    x = s;
+    y = shoup_mul_lazy4(d, w, ws, vq);
+}
+
+// Butterflies of the t = 2 and t = 1 stages regrouped from two vectors
+// p = (p0..p3), (p4..p7):
+//   t = 2: x = (p0 p1 p4 p5), y = (p2 p3 p6 p7), blocks (i i i+1 i+1)
+//   t = 1: x = (p0 p4 p2 p6), y = (p1 p5 p3 p7), blocks (i i+2 i+1 i+3)
+// The lane twiddles are a shuffle of the contiguous table entries.
+template <size_t T>
+static inline HE_TARGET_AVX2 void split8(__m256i v0, __m256i v1, __m256i& x, __m256i& y) {
+    if (T == 2) {
+        x = _mm256_permute2x128_si256(v0, v1, 0x20);
+        y = _mm256_permute2x128_si256(v0, v1, 0x31);
+    } else {
+        x = _mm256_unpacklo_epi64(v0, v1);
+        y = _mm256_unpackhi_epi64(v0, v1);
+    }
+}
+
+template <size_t T>
+static inline HE_TARGET_AVX2 void join8(__m256i x, __m256i y, __m256i& v0, __m256i& v1) {
+    if (T == 2) {
+        v0 = _mm256_permute2x128_si256(x, y, 0x20);
+        v1 = _mm256_permute2x128_si256(x, y, 0x31);
+    } else {
+        v0 = _mm256_unpacklo_epi64(x, y);
+        v1 = _mm256_unpackhi_epi64(x, y);
+    }
+}
+
+template <size_t T>
+static inline HE_TARGET_AVX2 __m256i lane_twiddles(const u64* w) {
+    if (T == 2) return _mm256_permute4x64_epi64(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)w)), 0x50);
+    return _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i*)w), 0xD8);
+}
+
+template <u64 Q, unsigned LOGN, unsigned S>
+static HE_TARGET_AVX2 void ct_stages_avx2(u64* a, const u64* tw, const u64* tws) {
+    constexpr size_t n = size_t(1) << LOGN, m = size_t(1) << S, t = n >> (S + 1);
+    constexpr bool last = S + 1 == LOGN;
+    if constexpr (t >= 4) {
+        for (size_t i = 0; i < m; ++i) {
+            const __m256i w = _mm256_set1_epi64x((long long)tw[m + i]);
+            const __m256i ws = _mm256_set1_epi64x((long long)tws[m + i]);
+            u64* xp = a + 2 * i * t;
+            u64* yp = xp + t;
+            for (size_t j = 0; j < t; j += 4) {
+                __m256i x = _mm256_loadu_si256((const __m256i*)(xp + j));
+                __m256i y = _mm256_loadu_si256((const __m256i*)(yp + j));
+                ct_bfly4<Q>(x, y, w, ws, false);
+                _mm256_storeu_si256((__m256i*)(xp + j), x);
+                _mm256_storeu_si256((__m256i*)(yp + j), y);
+            }
+        }
+    } else {
+        // 8 coefficients (4 / t blocks) per step
+        for (size_t i = 0; i < m; i += 4 / t) {
+            u64* p = a + 2 * i * t;
+            __m256i x, y;
+            split8<t>(_mm256_loadu_si256((const __m256i*)p), _mm256_loadu_si256((const __m256i*)(p + 4)), x, y);
+            ct_bfly4<Q>(x, y, lane_twiddles<t>(tw + m + i), lane_twiddles<t>(tws + m + i), last);
+            __m256i v0, v1;
+            join8<t>(x, y, v0, v1);
+            _mm256_storeu_si256((__m256i*)p, v0);
+            _mm256_storeu_si256((__m256i*)(p + 4), v1);
+        }
+    }
+    if constexpr (!last) ct_stages_avx2<Q, LOGN, S + 1>(a, tw, tws);
+}
+
+template <u64 Q, unsigned LOGN, unsigned S>
+static HE_TARGET_AVX2 void gs_stages_avx2(u64* a, const u64* tw, const u64* tws) {
+    constexpr size_t n = size_t(1) << LOGN, m = size_t(1) << S, t = n >> (S + 1);
+    using N = Ntt<Q, LOGN>;
+    if constexpr (S == 0) {
+        const __m256i vq = _mm256_set1_epi64x((long long)Q);
+        const __m256i v2q = _mm256_set1_epi64x((long long)(2 * Q));
+        const __m256i lw = _mm256_set1_epi64x((long long)N::tables.inv_last);
+        const __m256i lws = _mm256_set1_epi64x((long long)N::tables.inv_last_shoup);
+        const __m256i ni = _mm256_set1_epi64x((long long)N::n_inv);
+        const __m256i nis = _mm256_set1_epi64x((long long)N::n_inv_shoup);
+        for (size_t j = 0; j < t; j += 4) {
+            __m256i u = _mm256_loadu_si256((const __m256i*)(a + j));
+            __m256i v = _mm256_loadu_si256((const __m256i*)(a + j + t));
+            __m256i s = _mm256_add_epi64(u, v);
+            __m256i d = _mm256_add_epi64(_mm256_sub_epi64(u, v), v2q);
+            _mm256_storeu_si256((__m256i*)(a + j), csub(shoup_mul_lazy4(s, ni, nis, vq), vq));
+            _mm256_storeu_si256((__m256i*)(a + j + t), csub(shoup_mul_lazy4(d, lw, lws, vq), vq));
+        }
+    } else {
+        if constexpr (t >= 4) {
+            for (size_t i = 0; i < m; ++i) {
+                const __m256i w = _mm256_set1_epi64x((long long)tw[m + i]);
+                const __m256i ws = _mm256_set1_epi64x((long long)tws[m + i]);
+                u64* xp = a + 2 * i * t;
+                u64* yp = xp + t;
+                for (size_t j = 0; j < t; j += 4) {
+                    __m256i x = _mm256_loadu_si256((const __m256i*)(xp + j));
+                    __m256i y = _mm256_loadu_si256((const __m256i*)(yp + j));
+                    gs_bfly4<Q>(x, y, w, ws);
+                    _mm256_storeu_si256((__m256i*)(xp + j), x);
+                    _mm256_storeu_si256((__m256i*)(yp + j), y);
+                }
+            }
+        } else {
+            for (size_t i = 0; i < m; i += 4 / t) {
+                u64* p = a + 2 * i * t;
+                __m256i x, y;
+                split8<t>(_mm256_loadu_si256((const __m256i*)p), _mm256_loadu_si256((const __m256i*)(p + 4)), x, y);
+                gs_bfly4<Q>(x, y, lane_twiddles<t>(tw + m + i), lane_twiddles<t>(tws + m + i));
+                __m256i v0, v1;
+                join8<t>(x, y, v0, v1);
+                _mm256_storeu_si256((__m256i*)p, v0);
+                _mm256_storeu_si256((__m256i*)(p + 4), v1);
+            }
+        }
+        gs_stages_avx2<Q, LOGN, S - 1>(a, tw, tws);
+    }
+}
+
+#endif
+
+template <u64 Q, unsigned LOGN>
+void Ntt<Q, LOGN>::forward(u64* a) {
+    HE_PROF_SCOPE(PROF_NTT_NEGACYCLIC);
+    HE_PROF_SCOPE(PROF_BUTTERFLIES);
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        ct_stages_avx2<Q, LOGN, 0>(a, tables.fwd, tables.fwd_shoup);
+        return;
+    }
+#endif
+    ct_stages_scalar<Q, LOGN, 0>(a, tables.fwd, tables.fwd_shoup);
+}
+
+template <u64 Q, unsigned LOGN>
+void Ntt<Q, LOGN>::inverse(u64* a) {
+    HE_PROF_SCOPE(PROF_INTT_NEGACYCLIC);
+    HE_PROF_SCOPE(PROF_BUTTERFLIES);
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        gs_stages_avx2<Q, LOGN, LOGN - 1>(a, tables.inv, tables.inv_shoup);
+        return;
+    }
+#endif
+    gs_stages_scalar<Q, LOGN, LOGN - 1>(a, tables.inv, tables.inv_shoup);
+}
+
+// --- Registered parameter sets ---
+// Two 60-bit primes = 1 (mod 2^15) at n = 4096, 8192 and 16384. Adding a set
+// is one FIXED_NTT line; each costs 4n words of read-only tables.
+
+#define FIXED_NTT(Q, LOGN) {size_t(1) << (LOGN), (Q), &Ntt<(Q), (LOGN)>::forward, &Ntt<(Q), (LOGN)>::inverse}
+
+static const FixedNtt fixed_registry[] = {
+    FIXED_NTT(1152921504606748673ULL, 12),
+    FIXED_NTT(1152921504606683137ULL, 12),
+    FIXED_NTT(1152921504606748673ULL, 13),
+    FIXED_NTT(1152921504606683137ULL, 13),
+    FIXED_NTT(1152921504606748673ULL, 14),
+    FIXED_NTT(1152921504606683137ULL, 14),
+};
+
+#undef FIXED_NTT
+
+const FixedNtt* find_fixed_ntt(size_t n, u64 mod) {
+    for (const FixedNtt& f : fixed_registry) {
+        if (f.n == n && f.mod == mod) return &f;
+    }
+    return nullptr;
+}
+
+void ntt_negacyclic(u64* a, size_t n, u64 mod) {
+    if (const FixedNtt* f = find_fixed_ntt(n, mod)) {
+        f->forward(a);
+        return;
+    }
+    const NttPlan* plan = cached_plan(n, mod);
+    assert(plan && plan->has_negacyclic());
+    ntt_negacyclic(a, n, *plan);
+}
+
+void intt_negacyclic(u64* a, size_t n, u64 mod) {
+    if (const FixedNtt* f = find_fixed_ntt(n, mod)) {
+        f->inverse(a);
+        return;
+    }
+    const NttPlan* plan = cached_plan(n, mod);
+    assert(plan && plan->has_negacyclic());
+    intt_negacyclic(a, n, *plan);
+}
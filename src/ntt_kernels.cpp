@@ -0,0 +1,284 @@
+#include "ntt_kernels.h"
+#include "profile.h"
+
+using u64 = uint64_t;
+
+// x >= c ? x - c : x without a branch. The fused radix-4 loops hold enough
+// live values that the compiler otherwise emits a jump for some of these,
+// and on random residues it mispredicts half the time.
+static inline u64 csub_nb(u64 x, u64 c) {
+    return x - (c & (0 - (u64)(x >= c)));
+}
+
+// Harvey CT butterfly: x, y in [0, 4q) -> [0, 4q).
+static inline void ct_bfly(u64& x, u64& y, u64 w, u64 ws, u64 mod, u64 two_q) {
+    u64 u = csub_nb(x, two_q);
+    u64 v = shoup_mul_lazy(y, w, ws, mod);
+    x = u + v;
+    y = u - v + two_q;
+}
+
+// Harvey GS butterfly: x, y in [0, 2q) -> [0, 2q).
+static inline void gs_bfly(u64& x, u64& y, u64 w, u64 ws, u64 mod, u64 two_q) {
+    u64 u = x, v = y;
+    x = csub_nb(u + v, two_q);
+    y = shoup_mul_lazy(u - v + two_q, w, ws, mod);
+}
+
+void dit_layer_shoup(u64* a, size_t n, size_t len, const u64* w, const u64* ws, u64 mod) {
+    const u64 two_q = 2 * mod;
+    for (size_t i = 0; i < n; i += 2 * len) {
+        for (size_t j = 0; j < len; ++j) {
+            // x in [0, 2q) after one conditional subtract, t = w*y in [0, 2q),
+            // so x + t and x - t + 2q both land in [0, 4q)
+            u64 x = a[i + j];
+            if (x >= two_q) x -= two_q;
+            u64 t = shoup_mul_lazy(a[i + j + len], w[j], ws[j], mod);
+            a[i + j] = x + t;
+            a[i + j + len] = x - t + two_q;
+        }
+    }
+}
+
+void dit_run_shoup(u64* x, size_t len, const u64* w, const u64* ws, size_t cnt, u64 mod) {
+    const u64 two_q = 2 * mod;
+    u64* y = x + len;
+    for (size_t j = 0; j < cnt; ++j) {
+        u64 u = x[j];
+        if (u >= two_q) u -= two_q;
+        u64 t = shoup_mul_lazy(y[j], w[j], ws[j], mod);
+        x[j] = u + t;
+        y[j] = u - t + two_q;
+    }
+}
+
+void dit_layer4_shoup(u64* a, size_t n, size_t len, const u64* tw, const u64* tws, u64 mod) {
+    const u64 two_q = 2 * mod;
+    const u64 *w1 = tw + len, *ws1 = tws + len;
+    const u64 *w2 = tw + 2 * len, *ws2 = tws + 2 * len;
+    for (size_t i = 0; i < n; i += 4 * len) {
+        u64* x = a + i;
+        for (size_t j = 0; j < len; ++j) {
+            u64 a0 = x[j], a1 = x[j + len], a2 = x[j + 2 * len], a3 = x[j + 3 * len];
+            ct_bfly(a0, a1, w1[j], ws1[j], mod, two_q);
+            ct_bfly(a2, a3, w1[j], ws1[j], mod, two_q);
+            ct_bfly(a0, a2, w2[j], ws2[j], mod, two_q);
+            ct_bfly(a1, a3, w2[j + len], ws2[j + len], mod, two_q);
+            x[j] = a0;
+            x[j + len] = a1;
+            x[j + 2 * len] = a2;
+            x[j + 3 * len] = a3;
+        }
+    }
+}
+
+void dit_layers_shoup(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod) {
+    size_t len = 1;
+    for (; 4 * len <= n; len <<= 2) {
+        HE_PROF_LAYER(__builtin_ctzll(len));
+        dit_layer4_shoup(a, n, len, tw, tws, mod);
+    }
+    // odd log2(n): one radix-2 layer left
+    if (len < n) {
+        HE_PROF_LAYER(__builtin_ctzll(len));
+        dit_layer_shoup(a, n, len, tw + len, tws + len, mod);
+    }
+}
+
+void ct_stage_shoup_range(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                          const u64* tw, const u64* tws, u64 mod) {
+    const u64 two_q = 2 * mod;
+    size_t t = n / (2 * m);
+    size_t i = k0 / t, j = k0 % t;
+    for (size_t k = k0; k < k1; ++i, j = 0) {
+        u64 w = tw[m + i], ws = tws[m + i];
+        u64* x = a + 2 * i * t;
+        u64* y = x + t;
+        size_t j_end = (t - j < k1 - k) ? t : j + (k1 - k);
+        k += j_end - j;
+        for (; j < j_end; ++j) {
+            u64 u = x[j];
+            if (u >= two_q) u -= two_q;
+            u64 v = shoup_mul_lazy(y[j], w, ws, mod);
+            x[j] = u + v;
+            y[j] = u - v + two_q;
+        }
+    }
+}
+
+void ct_stage_shoup(u64* a, size_t n, size_t m, const u64* tw, const u64* tws, u64 mod) {
+    ct_stage_shoup_range(a, n, m, 0, n / 2, tw, tws, mod);
+}
+
+void ct_stage4_shoup(u64* a, size_t n, size_t m, const u64* tw, const u64* tws, u64 mod) {
+    const u64 two_q = 2 * mod;
+    const size_t t = n / (2 * m), h = t / 2;
+    for (size_t i = 0; i < m; ++i) {
+        const u64 w1 = tw[m + i], ws1 = tws[m + i];
+        const u64 w2 = tw[2 * m + 2 * i], ws2 = tws[2 * m + 2 * i];
+        const u64 w3 = tw[2 * m + 2 * i + 1], ws3 = tws[2 * m + 2 * i + 1];
+        u64* x = a + 2 * i * t;
+        for (size_t j = 0; j < h; ++j) {
+            u64 a0 = x[j], a1 = x[j + h], a2 = x[j + t], a3 = x[j + t + h];
+            ct_bfly(a0, a2, w1, ws1, mod, two_q);
+            ct_bfly(a1, a3, w1, ws1, mod, two_q);
+            ct_bfly(a0, a1, w2, ws2, mod, two_q);
+            ct_bfly(a2, a3, w3, ws3, mod, two_q);
+            x[j] = a0;
+            x[j + h] = a1;
+            x[j + t] = a2;
+            x[j + t + h] = a3;
+        }
+    }
+}
+
+void ct_forward_shoup(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod) {
+    size_t m = 1;
+    // an odd number of stages starts with one radix-2 stage
+    if (__builtin_ctzll(n) & 1) {
+        HE_PROF_LAYER(0);
+        ct_stage_shoup(a, n, 1, tw, tws, mod);
+        m = 2;
+    }
+    for (; m < n; m <<= 2) {
+        HE_PROF_LAYER(__builtin_ctzll(m));
+        ct_stage4_shoup(a, n, m, tw, tws, mod);
+    }
+}
+
+void gs_stage_shoup_range(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                          const u64* tw, const u64* tws, u64 mod) {
+    const u64 two_q = 2 * mod;
+    size_t t = n / (2 * m);
+    size_t i = k0 / t, j = k0 % t;
+    for (size_t k = k0; k < k1; ++i, j = 0) {
+        u64 w = tw[m + i], ws = tws[m + i];
+        u64* x = a + 2 * i * t;
+        u64* y = x + t;
+        size_t j_end = (t - j < k1 - k) ? t : j + (k1 - k);
+        k += j_end - j;
+        for (; j < j_end; ++j) {
+            // sum back to [0, 2q); the difference is < 4q, its product < 2q
+            u64 u = x[j], v = y[j];
+            u64 s = u + v;
+            if (s >= two_q) s -= two_q;
+            x[j] = s;
+            y[j] = shoup_mul_lazy(u - v + two_q, w, ws, mod);
+        }
+    }
+}
+
+void gs_stage_shoup(u64* a, size_t n, size_t m, const u64* tw, const u64* tws, u64 mod) {
+    gs_stage_shoup_range(a, n, m, 0, n / 2, tw, tws, mod);
+}
+
+void gs_stage4_shoup(u64* a, size_t n, size_t m, const u64* tw, const u64* tws, u64 mod) {
+    const u64 two_q = 2 * mod;
+    const size_t t = n / (2 * m);
+    for (size_t i = 0; i < m / 2; ++i) {
+        const u64 w1 = tw[m + 2 * i], ws1 = tws[m + 2 * i];
+        const u64 w2 = tw[m + 2 * i + 1], ws2 = tws[m + 2 * i + 1];
+        const u64 w3 = tw[m / 2 + i], ws3 = tws[m / 2 + i];
+        u64* x = a + 4 * i * t;
+        for (size_t j = 0; j < t; ++j) {
+            u64 a0 = x[j], a1 = x[j + t], a2 = x[j + 2 * t], a3 = x[j + 3 * t];
+            gs_bfly(a0, a1, w1, ws1, mod, two_q);
+            gs_bfly(a2, a3, w2, ws2, mod, two_q);
+            gs_bfly(a0, a2, w3, ws3, mod, two_q);
+            gs_bfly(a1, a3, w3, ws3, mod, two_q);
+            x[j] = a0;
+            x[j + t] = a1;
+            x[j + 2 * t] = a2;
+            x[j + 3 * t] = a3;
+        }
+    }
+}
+
+void gs_last_stage_shoup_range(u64* a, size_t n, size_t j0, size_t j1, u64 last_w, u64 last_ws,
+                               u64 n_inv, u64 n_inv_shoup, u64 mod) {
+    const u64 two_q = 2 * mod;
+    size_t t = n / 2;
+    for (size_t j = j0; j < j1; ++j) {
+        u64 u = a[j], v = a[j + t];
+        a[j] = shoup_mul(u + v, n_inv, n_inv_shoup, mod);
+        a[j + t] = shoup_mul(u - v + two_q, last_w, last_ws, mod);
+    }
+}
+
+void gs_last_stage_shoup(u64* a, size_t n, u64 last_w, u64 last_ws,
+                         u64 n_inv, u64 n_inv_shoup, u64 mod) {
+    gs_last_stage_shoup_range(a, n, 0, n / 2, last_w, last_ws, n_inv, n_inv_shoup, mod);
+}
+
+void gs_inverse_shoup(u64* a, size_t n, const u64* tw, const u64* tws,
+                      u64 last_w, u64 last_ws, u64 n_inv, u64 n_inv_shoup, u64 mod) {
+    // stages m = n/2 .. 2 in radix-4 pairs, plus one radix-2 stage when their
+    // number is odd; the folded last stage stays on its own
+    size_t m = n / 2;
+    for (; m >= 4; m >>= 2) {
+        HE_PROF_LAYER(__builtin_ctzll(n) - 1 - __builtin_ctzll(m));
+        gs_stage4_shoup(a, n, m, tw, tws, mod);
+    }
+    if (m == 2) {
+        HE_PROF_LAYER(__builtin_ctzll(n) - 2);
+        gs_stage_shoup(a, n, 2, tw, tws, mod);
+    }
+    HE_PROF_LAYER(__builtin_ctzll(n) - 1);
+    gs_last_stage_shoup(a, n, last_w, last_ws, n_inv, n_inv_shoup, mod);
+}
+
+void reduce_4q_array(u64* a, size_t n, u64 mod) {
+    for (size_t i = 0; i < n; ++i) a[i] = reduce_4q(a[i], mod);
+}
+
+void mul_scalar_shoup_array(u64* a, size_t n, u64 w, u64 wp, u64 mod) {
+    for (size_t i = 0; i < n; ++i) a[i] = shoup_mul(a[i], w, wp, mod);
+}
+
+// x < 2q -> x mod q without a branch (x - q wraps above x when x < q)
+static inline u32 csub32(u32 x, u32 mod) {
+    u32 y = x - mod;
+    return y < x ? y : x;
+}
+
+void ct_forward_shoup32(u32* a, size_t n, const u32* tw, const u32* tws, u32 mod) {
+    for (size_t m = 1; m < n; m <<= 1) {
+        size_t t = n / (2 * m);
+        for (size_t i = 0; i < m; ++i) {
+            u32 w = tw[m + i], ws = tws[m + i];
+            u32* x = a + 2 * i * t;
+            u32* y = x + t;
+            for (size_t j = 0; j < t; ++j) {
+                u32 u = x[j];
+                u32 v = shoup_mul32(y[j], w, ws, mod);
+                u32 s = u + v, d = u - v + mod;
+                x[j] = csub32(s, mod);
+                y[j] = csub32(d, mod);
+            }
+        }
+    }
+}
+
+void gs_inverse_shoup32(u32* a, size_t n, const u32* tw, const u32* tws,
+                        u32 last_w, u32 last_ws, u32 n_inv, u32 n_inv_shoup, u32 mod) {
+    for (size_t m = n / 2; m > 1; m >>= 1) {
+        size_t t = n / (2 * m);
+        for (size_t i = 0; i < m; ++i) {
+            u32 w = tw[m + i], ws = tws[m + i];
+            u32* x = a + 2 * i * t;
+            u32* y = x + t;
+            for (size_t j = 0; j < t; ++j) {
+                u32 u = x[j], v = y[j];
+                u32 s = u + v;
+                x[j] = csub32(s, mod);
+                y[j] = shoup_mul32(u - v + mod, w, ws, mod);
+            }
+        }
+    }
+    size_t t = n / 2;
+    for (size_t j = 0; j < t; ++j) {
+        u32 u = a[j], v = a[j + t];
+        a[j] = shoup_mul32(u + v, n_inv, n_inv_shoup, mod);
+        a[j + t] = shoup_mul32(u - v + mod, last_w, last_ws, mod);
+    }
+}
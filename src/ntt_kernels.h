@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "shoup.h"
+using u64 = uint64_t;
+
+// Internal scalar building blocks shared by the transform front-ends
+// (ntt.cpp) and the SIMD kernels (ntt_simd.cpp, which uses them for short
+// stages and as the fallback on hosts without AVX2). Not installed.
+//
+// All butterflies are Harvey-style with Shoup twiddles: values stay in
+// [0, 4*mod) (forward) or [0, 2*mod) (inverse) between stages.
+
+// [0, 4q) -> [0, q)
+static inline u64 reduce_4q(u64 x, u64 mod) {
+    if (x >= 2 * mod) x -= 2 * mod;
+    if (x >= mod) x -= mod;
+    return x;
+}
+
+// Radix-2 DIT layer with half-size len over bit-reversed data; w/ws point at
+// the stage-ordered twiddles of this layer (tw + len).
+void dit_layer_shoup(u64* a, size_t n, size_t len, const u64* w, const u64* ws, u64 mod);
+// cnt consecutive DIT butterflies (x[j], x[j + len]) with twiddles w[j].
+void dit_run_shoup(u64* x, size_t len, const u64* w, const u64* ws, size_t cnt, u64 mod);
+// Layers len and 2len fused (radix 4) over blocks of 4*len; tw/tws are the
+// whole stage-ordered tables. Needs 4*len <= n.
+void dit_layer4_shoup(u64* a, size_t n, size_t len, const u64* tw, const u64* tws, u64 mod);
+// All DIT layers: bit-reversed input, natural-order output, [0, 4q). Layers
+// run in radix-4 pairs, plus a final radix-2 layer when log2(n) is odd.
+void dit_layers_shoup(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod);
+
+// Cooley-Tukey stage with m blocks of size 2t (t = n / 2m): block i uses the
+// bit-reversed-order twiddle tw[m + i]. Natural input, bit-reversed output.
+void ct_stage_shoup(u64* a, size_t n, size_t m, const u64* tw, const u64* tws, u64 mod);
+// Stages m and 2m fused (radix 4): each group of four values is loaded once
+// and passes both stages in registers. Needs 4m <= n.
+void ct_stage4_shoup(u64* a, size_t n, size_t m, const u64* tw, const u64* tws, u64 mod);
+// All stages, in radix-4 pairs after one radix-2 stage when log2(n) is odd.
+void ct_forward_shoup(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod);
+// Butterflies k0..k1-1 of one stage (butterfly k is j = k % t of block
+// k / t); the whole stage is [0, n/2). Used to split a stage across threads.
+void ct_stage_shoup_range(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                          const u64* tw, const u64* tws, u64 mod);
+
+// Gentleman-Sande stage with m blocks of size 2t, undoing ct_stage_shoup
+// with the same m: block i uses inverse twiddle tw[m + i]. Inputs [0, 2q).
+void gs_stage_shoup(u64* a, size_t n, size_t m, const u64* tw, const u64* tws, u64 mod);
+// Stages m and m/2 fused (radix 4); needs m >= 2.
+void gs_stage4_shoup(u64* a, size_t n, size_t m, const u64* tw, const u64* tws, u64 mod);
+// Final GS stage (one block of size n) with n^{-1} folded in: outputs [0, q).
+void gs_last_stage_shoup(u64* a, size_t n, u64 last_w, u64 last_ws,
+                         u64 n_inv, u64 n_inv_shoup, u64 mod);
+void gs_stage_shoup_range(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                          const u64* tw, const u64* tws, u64 mod);
+void gs_last_stage_shoup_range(u64* a, size_t n, size_t j0, size_t j1, u64 last_w, u64 last_ws,
+                               u64 n_inv, u64 n_inv_shoup, u64 mod);
+void gs_inverse_shoup(u64* a, size_t n, const u64* tw, const u64* tws,
+                      u64 last_w, u64 last_ws, u64 n_inv, u64 n_inv_shoup, u64 mod);
+
+void reduce_4q_array(u64* a, size_t n, u64 mod);
+void mul_scalar_shoup_array(u64* a, size_t n, u64 w, u64 wp, u64 mod);
+
+// 32-bit kernels for mod < 2^31 (see NttPlan::narrow). Values are kept fully
+// reduced in [0, mod) between stages, since 4*mod may not fit in 32 bits;
+// inputs must be in [0, mod). Same [m + i] table layout as the 64-bit CT/GS.
+void ct_forward_shoup32(u32* a, size_t n, const u32* tw, const u32* tws, u32 mod);
+void gs_inverse_shoup32(u32* a, size_t n, const u32* tw, const u32* tws,
+                        u32 last_w, u32 last_ws, u32 n_inv, u32 n_inv_shoup, u32 mod);
@@ -0,0 +1,99 @@
+#include "ntt_parallel.h"
+#include "ntt.h"
+#include "ntt_kernels.h"
+#include "ntt_simd.h"
+#include <cassert>
+
+using u64 = uint64_t;
+
+// Below this size a transform is a few microseconds and a pool wake-up per
+// stage costs more than it saves.
+static const size_t PARALLEL_MIN_N = 1 << 12;
+
+// Tasks per transform: a power of two >= the pool size, and small enough
+// that every butterfly range spans whole 4-lane vectors (n / 2P >= 4).
+static size_t split_count(size_t n, const ThreadPool& pool) {
+    size_t P = 1;
+    while (P < pool.size()) P <<= 1;
+    while (P > 1 && n / (2 * P) < 4) P >>= 1;
+    return P;
+}
+
+static void ct_range(u64* a, size_t n, size_t m, size_t k0, size_t k1, const NttPlan& plan) {
+    const u64* tw = plan.nega_fwd_tw.data();
+    const u64* tws = plan.nega_fwd_tw_shoup.data();
+    if (plan.use_avx2) ct_stage_shoup_range_avx2(a, n, m, k0, k1, tw, tws, plan.mod);
+    else ct_stage_shoup_range(a, n, m, k0, k1, tw, tws, plan.mod);
+}
+
+static void gs_range(u64* a, size_t n, size_t m, size_t k0, size_t k1, const NttPlan& plan) {
+    const u64* tw = plan.nega_inv_tw.data();
+    const u64* tws = plan.nega_inv_tw_shoup.data();
+    if (plan.use_avx2) gs_stage_shoup_range_avx2(a, n, m, k0, k1, tw, tws, plan.mod);
+    else gs_stage_shoup_range(a, n, m, k0, k1, tw, tws, plan.mod);
+}
+
+void ntt_negacyclic(u64* a, size_t n, const NttPlan& plan, ThreadPool& pool) {
+    assert(n == plan.n && plan.has_negacyclic());
+    size_t P = split_count(n, pool);
+    if (n < PARALLEL_MIN_N || P == 1) {
+        ntt_negacyclic(a, n, plan);
+        return;
+    }
+    const size_t chunk = n / (2 * P);
+    // stages with m < P pair elements from different sub-blocks
+    for (size_t m = 1; m < P; m <<= 1) {
+        pool.parallel_for(P, [&](size_t b) { ct_range(a, n, m, b * chunk, (b + 1) * chunk, plan); });
+    }
+    // from m = P on, butterflies [b*chunk, (b+1)*chunk) stay inside a[2b*chunk, 2(b+1)*chunk)
+    pool.parallel_for(P, [&](size_t b) {
+        for (size_t m = P; m < n; m <<= 1) ct_range(a, n, m, b * chunk, (b + 1) * chunk, plan);
+        u64* sub = a + 2 * b * chunk;
+        if (plan.use_avx2) reduce_4q_avx2(sub, 2 * chunk, plan.mod);
+        else reduce_4q_array(sub, 2 * chunk, plan.mod);
+    });
+}
+
+void intt_negacyclic(u64* a, size_t n, const NttPlan& plan, ThreadPool& pool) {
+    assert(n == plan.n && plan.has_negacyclic());
+    size_t P = split_count(n, pool);
+    if (n < PARALLEL_MIN_N || P == 1) {
+        intt_negacyclic(a, n, plan);
+        return;
+    }
+    const size_t chunk = n / (2 * P);
+    pool.parallel_for(P, [&](size_t b) {
+        for (size_t m = n / 2; m >= P; m >>= 1) gs_range(a, n, m, b * chunk, (b + 1) * chunk, plan);
+    });
+    for (size_t m = P / 2; m > 1; m >>= 1) {
+        pool.parallel_for(P, [&](size_t b) { gs_range(a, n, m, b * chunk, (b + 1) * chunk, plan); });
+    }
+    pool.parallel_for(P, [&](size_t b) {
+        size_t j0 = b * chunk, j1 = j0 + chunk;
+        if (plan.use_avx2) {
+            gs_last_stage_shoup_range_avx2(a, n, j0, j1, plan.nega_inv_last, plan.nega_inv_last_shoup,
+                                           plan.n_inv, plan.n_inv_shoup, plan.mod);
+        } else {
+            gs_last_stage_shoup_range(a, n, j0, j1, plan.nega_inv_last, plan.nega_inv_last_shoup,
+                                      plan.n_inv, plan.n_inv_shoup, plan.mod);
+        }
+    });
+}
+
+void ntt_negacyclic(std::vector<u64>& a, const NttPlan& plan, ThreadPool& pool) {
+    ntt_negacyclic(a.data(), a.size(), plan, pool);
+}
+
+void intt_negacyclic(std::vector<u64>& a, const NttPlan& plan, ThreadPool& pool) {
+    intt_negacyclic(a.data(), a.size(), plan, pool);
+}
+
+void ntt_negacyclic_batch(u64* a, size_t count, const NttPlan& plan, ThreadPool& pool) {
+    const size_t n = plan.n;
+    pool.parallel_for(count, [&](size_t i) { ntt_negacyclic(a + i * n, n, plan); });
+}
+
+void intt_negacyclic_batch(u64* a, size_t count, const NttPlan& plan, ThreadPool& pool) {
+    const size_t n = plan.n;
+    pool.parallel_for(count, [&](size_t i) { intt_negacyclic(a + i * n, n, plan); });
+}
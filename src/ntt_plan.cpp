@@ -0,0 +1,223 @@
+#include "ntt_plan.h"
+#include "shoup.h"
+#include "autotune.h"
+#include "plan_cache.h"
+#include <cassert>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+using u64 = uint64_t;
+using u128 = __uint128_t;
+
+static u64 mod_pow(u64 a, u64 e, u64 mod) {
+    u128 res = 1;
+    u128 base = a % mod;
+    while (e) {
+        if (e & 1) res = (res * base) % mod;
+        base = (base * base) % mod;
+        e >>= 1;
+    }
+    return (u64)res;
+}
+
+// bit-reversal of the low 'bits' bits of x
+static size_t bit_reverse_index(size_t x, unsigned bits) {
+    size_t r = 0;
+    for (unsigned b = 0; b < bits; ++b) r |= ((x >> b) & 1) << (bits - 1 - b);
+    return r;
+}
+
+u64 find_root_of_unity(size_t order, u64 mod) {
+    if (order == 0 || (mod - 1) % order != 0) return 0;
+    if (order == 1) return 1;
+    // for a power-of-two order, g^{(mod-1)/order} has full order exactly when
+    // g is a non-residue, so no factorisation of mod-1 is needed
+    u64 g = 2;
+    while (mod_pow(g, (mod - 1) / 2, mod) != mod - 1) ++g;
+    return mod_pow(g, (mod - 1) / order, mod);
+}
+
+NttPlan::NttPlan(size_t n, u64 mod) {
+    u64 psi2n = find_root_of_unity(2 * n, mod);
+    u64 r = psi2n ? (u64)((u128)psi2n * psi2n % mod) : find_root_of_unity(n, mod);
+    assert(r != 0);
+    init(n, mod, r);
+}
+
+NttPlan::NttPlan(size_t n, u64 mod, u64 root) {
+    init(n, mod, root);
+}
+
+void NttPlan::init(size_t n_, u64 mod_, u64 root_) {
+    assert(n_ >= 2 && (n_ & (n_ - 1)) == 0);
+    assert(mod_ < (u64(1) << 62));
+    n = n_;
+    mod = mod_;
+    root = root_;
+    log_n = 0;
+    while ((size_t(1) << log_n) < n) ++log_n;
+    mont.init(mod);
+    tune_apply(*this);
+
+    // natural powers root^k, used only while building the stage tables
+    std::vector<u64> pw(n);
+    pw[0] = 1;
+    for (size_t i = 1; i < n; ++i) pw[i] = (u128)pw[i-1] * root % mod;
+
+    fwd_tw.assign(n, 0);
+    inv_tw.assign(n, 0);
+    fwd_tw_mont.assign(n, 0);
+    fwd_tw_shoup.assign(n, 0);
+    inv_tw_shoup.assign(n, 0);
+    for (size_t len = 1; len < n; len <<= 1) {
+        size_t step = n / (2 * len);
+        for (size_t j = 0; j < len; ++j) {
+            size_t k = step * j;
+            fwd_tw[len + j] = pw[k];
+            inv_tw[len + j] = pw[(n - k) % n];
+            fwd_tw_mont[len + j] = mont.to_mont(pw[k]);
+            fwd_tw_shoup[len + j] = shoup_precompute(fwd_tw[len + j], mod);
+            inv_tw_shoup[len + j] = shoup_precompute(inv_tw[len + j], mod);
+        }
+    }
+
+    br_fwd_tw.assign(n, 0);
+    br_fwd_tw_shoup.assign(n, 0);
+    br_inv_tw.assign(n, 0);
+    br_inv_tw_shoup.assign(n, 0);
+    for (unsigned s = 0; s < log_n; ++s) {
+        size_t m = size_t(1) << s;
+        for (size_t i = 0; i < m; ++i) {
+            size_t k = (n / (2 * m)) * bit_reverse_index(i, s);
+            br_fwd_tw[m + i] = pw[k];
+            br_inv_tw[m + i] = pw[(n - k) % n];
+            br_fwd_tw_shoup[m + i] = shoup_precompute(br_fwd_tw[m + i], mod);
+            br_inv_tw_shoup[m + i] = shoup_precompute(br_inv_tw[m + i], mod);
+        }
+    }
+
+    n_inv = mod_pow(n % mod, mod - 2, mod);
+    n_inv_mont = mont.to_mont(n_inv);
+    n_inv_shoup = shoup_precompute(n_inv, mod);
+
+    // Negacyclic tables with psi merged in: the forward Cooley-Tukey stage
+    // with m blocks uses psi^{bitrev(m + i)} for block i, which folds the
+    // pre-multiplication by psi^j into the butterflies.
+    psi = find_root_of_unity(2 * n, mod);
+    nega_fwd_tw.clear(); nega_fwd_tw_shoup.clear();
+    nega_inv_tw.clear(); nega_inv_tw_shoup.clear();
+    if (psi) {
+        u64 psi_inv = mod_pow(psi, 2 * n - 1, mod);
+        nega_fwd_tw.assign(n, 0);
+        nega_fwd_tw_shoup.assign(n, 0);
+        nega_inv_tw.assign(n, 0);
+        nega_inv_tw_shoup.assign(n, 0);
+        u64 p = 1, pi = 1;
+        for (size_t k = 0; k < n; ++k) {
+            size_t r = bit_reverse_index(k, log_n);
+            nega_fwd_tw[r] = p;
+            nega_inv_tw[r] = pi;
+            p = (u128)p * psi % mod;
+            pi = (u128)pi * psi_inv % mod;
+        }
+        for (size_t k = 0; k < n; ++k) {
+            nega_fwd_tw_shoup[k] = shoup_precompute(nega_fwd_tw[k], mod);
+            nega_inv_tw_shoup[k] = shoup_precompute(nega_inv_tw[k], mod);
+        }
+        nega_inv_last = (u128)nega_inv_tw[1] * n_inv % mod;
+        nega_inv_last_shoup = shoup_precompute(nega_inv_last, mod);
+    }
+
+    narrow = mod < (u64(1) << 31);
+    auto narrow_copy = [&](const PlanTable<u64>& src, PlanTable<u32>& w, PlanTable<u32>& ws) {
+        w.assign(src.size(), 0);
+        ws.assign(src.size(), 0);
+        for (size_t k = 0; k < src.size(); ++k) {
+            w[k] = (u32)src[k];
+            ws[k] = shoup_precompute32(w[k], (u32)mod);
+        }
+    };
+    br_fwd_tw32.clear(); br_fwd_tw32_shoup.clear(); br_inv_tw32.clear(); br_inv_tw32_shoup.clear();
+    nega_fwd_tw32.clear(); nega_fwd_tw32_shoup.clear(); nega_inv_tw32.clear(); nega_inv_tw32_shoup.clear();
+    if (narrow) {
+        narrow_copy(br_fwd_tw, br_fwd_tw32, br_fwd_tw32_shoup);
+        narrow_copy(br_inv_tw, br_inv_tw32, br_inv_tw32_shoup);
+        narrow_copy(nega_fwd_tw, nega_fwd_tw32, nega_fwd_tw32_shoup);
+        narrow_copy(nega_inv_tw, nega_inv_tw32, nega_inv_tw32_shoup);
+        n_inv32_shoup = shoup_precompute32((u32)n_inv, (u32)mod);
+        nega_inv_last32_shoup = shoup_precompute32((u32)nega_inv_last, (u32)mod);
+    }
+}
+
+// Shared by cached_plan and the plan-file preloader.
+static std::mutex cache_mu;
+static std::map<std::pair<size_t, u64>, std::unique_ptr<NttPlan>> plan_cache;
+
+const NttPlan* cached_plan(size_t n, u64 mod) {
+    auto key = std::make_pair(n, mod);
+    {
+        std::lock_guard<std::mutex> lock(cache_mu);
+        auto it = plan_cache.find(key);
+        if (it != plan_cache.end()) return it->second.get();
+    }
+    // built outside the lock, so that a large plan (or, with HE_TUNE_FILE, its
+    // calibration) does not stall lookups of other keys
+    std::unique_ptr<NttPlan> plan;
+    bool usable = n >= 2 && (n & (n - 1)) == 0 && mod < (u64(1) << 62) &&
+                  is_prime_u64(mod) && find_root_of_unity(n, mod) != 0;
+    if (usable) plan.reset(new NttPlan(n, mod));
+    std::lock_guard<std::mutex> lock(cache_mu);
+    // a plan another thread added meanwhile wins: callers may already hold it
+    return plan_cache.emplace(key, std::move(plan)).first->second.get();
+}
+
+const NttPlan* plan_cache_find(size_t n, u64 mod) {
+    std::lock_guard<std::mutex> lock(cache_mu);
+    auto it = plan_cache.find(std::make_pair(n, mod));
+    return it == plan_cache.end() ? nullptr : it->second.get();
+}
+
+bool plan_cache_insert(const NttPlan& plan) {
+    std::lock_guard<std::mutex> lock(cache_mu);
+    auto key = std::make_pair(plan.n, plan.mod);
+    if (plan_cache.count(key)) return false;
+    plan_cache.emplace(key, std::unique_ptr<NttPlan>(new NttPlan(plan)));
+    return true;
+}
+
+bool is_prime_u64(u64 x) {
+    if (x < 2) return false;
+    for (u64 p : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}) {
+        if (x % p == 0) return x == p;
+    }
+    u64 d = x - 1;
+    unsigned s = 0;
+    while ((d & 1) == 0) { d >>= 1; ++s; }
+    // these bases are a proven witness set for every x < 2^64
+    for (u64 a : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}) {
+        u64 y = mod_pow(a, d, x);
+        if (y == 1 || y == x - 1) continue;
+        bool composite = true;
+        for (unsigned r = 1; r < s; ++r) {
+            y = (u128)y * y % x;
+            if (y == x - 1) { composite = false; break; }
+        }
+        if (composite) return false;
+    }
+    return true;
+}
+
+std::vector<u64> generate_ntt_primes(unsigned bits, size_t count, size_t n) {
+    assert(bits <= 62 && n > 0);
+    std::vector<u64> primes;
+    const u64 step = 2 * (u64)n;
+    // largest candidate below 2^bits congruent to 1 mod 2n
+    u64 c = (((u64(1) << bits) - 1) / step) * step + 1;
+    if (c >= (u64(1) << bits)) c -= step;
+    for (; primes.size() < count && c > step; c -= step) {
+        if (is_prime_u64(c)) primes.push_back(c);
+    }
+    return primes;
+}
@@ -1,154 +1,602 @@
 
 #include "ntt_simd.h"
 #include "ntt.h"
-#include <immintrin.h>
+#include "montgomery.h"
+#include "shoup.h"
+#include "cpu_features.h"
+#include "ntt_kernels.h"
+#include "profile.h"
 #include <vector>
 #include <cstdint>
 #include <cassert>
-#include <iostream>
 
-// Improved AVX2-assisted 4-lane 64x64->128 multiply using _mm_mul_epu32 partial products,
-// then reconstructing full 128-bit results per lane and reducing modulo 'mod' using 128-bit ops.
-// This balances vector loads with scalar 128-bit combines for correctness.
+// AVX2 butterflies with every lane kept in registers: 64x64-bit products are
+// assembled from four _mm256_mul_epu32 partial products, reductions are Shoup
+// (plan tables) or Montgomery (root-vector API), and add/sub use the Harvey
+// lazy range [0, 4q) with branch-free conditional subtraction.
 
 using u64 = uint64_t;
 using u128 = __uint128_t;
 
-#ifdef __AVX2__
+#if HE_HAVE_AVX2_KERNELS
+#include "simd_avx2.h"
 
-// Helper: load 4 u64 into array (no alignment assumption)
-static inline void load4_u64(const uint64_t* p, uint64_t out[4]) {
-    out[0] = p[0]; out[1] = p[1]; out[2] = p[2]; out[3] = p[3];
+static void dit_layer_mont_scalar(u64* a, size_t n, size_t len, const u64* mroots, const Montgomery& M) {
+    const u64 two_q = 2 * M.mod;
+    size_t step = n / (2 * len);
+    for (size_t i = 0; i < n; i += 2 * len) {
+        for (size_t j = 0; j < len; ++j) {
+            u64 x = a[i + j];
+            if (x >= two_q) x -= two_q;
+            u64 t = M.mul_lazy(a[i + j + len], mroots[step * j]);
+            a[i + j] = x + t;
+            a[i + j + len] = x - t + two_q;
+        }
+    }
 }
 
-// Vector-assisted partial multiply: compute (a[i] * b[i]) % mod for i=0..3
-static inline void vec_mul64_mod_4(const uint64_t *a, const uint64_t *b, uint64_t mod, uint64_t out[4]) {
-    // Use 32-bit decomposition to compute partial products in parallel using _mm_mul_epu32.
-    // This produces low and some cross terms vectorized; final reconstruction uses 128-bit arithmetic per lane.
-    // Note: correctness prioritized over absolute vector-only implementation.
+// Harvey GS butterfly on 4 lanes: x, y in [0, 2q) -> [0, 2q).
+static inline HE_TARGET_AVX2 void gs_bfly4(__m256i& x, __m256i& y, __m256i w, __m256i wp,
+                                           __m256i vq, __m256i v2q) {
+    __m256i d = _mm256_add_epi64(_mm256_sub_epi64(x, y), v2q);
+    x = csub(_mm256_add_epi64(x, y), v2q);
+    y = shoup_mul_lazy4(d, w, wp, vq);
+}
 
-    // Extract 32-bit parts
-    uint32_t a_lo[4], a_hi[4], b_lo[4], b_hi[4];
-    for (int i = 0; i < 4; ++i) {
-        a_lo[i] = (uint32_t)(a[i] & 0xFFFFFFFFu);
-        a_hi[i] = (uint32_t)(a[i] >> 32);
-        b_lo[i] = (uint32_t)(b[i] & 0xFFFFFFFFu);
-        b_hi[i] = (uint32_t)(b[i] >> 32);
+static HE_TARGET_AVX2 void dit_layers_shoup_avx2_impl(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod) {
+    size_t len = 1;
+    // first two layers: a 4-lane vector would straddle butterfly blocks
+    for (; len < n && len < 4; len <<= 1) {
+        HE_PROF_LAYER(__builtin_ctzll(len));
+        dit_layer_shoup(a, n, len, tw + len, tws + len, mod);
     }
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * mod));
+    for (; len < n; len <<= 1) {
+        HE_PROF_LAYER(__builtin_ctzll(len));
+        const u64* w = tw + len;
+        const u64* ws = tws + len;
+        for (size_t i = 0; i < n; i += 2 * len) {
+            u64* x_ptr = a + i;
+            u64* y_ptr = a + i + len;
+            for (size_t j = 0; j < len; j += 4) {
+                __m256i x = _mm256_loadu_si256((const __m256i*)(x_ptr + j));
+                __m256i y = _mm256_loadu_si256((const __m256i*)(y_ptr + j));
+                // len + j is a multiple of 4 and the tables are 64-byte aligned
+                __m256i wv = _mm256_load_si256((const __m256i*)(w + j));
+                __m256i wpv = _mm256_load_si256((const __m256i*)(ws + j));
+                x = csub(x, v2q);
+                __m256i t = shoup_mul_lazy4(y, wv, wpv, vq);
+                _mm256_storeu_si256((__m256i*)(x_ptr + j), _mm256_add_epi64(x, t));
+                _mm256_storeu_si256((__m256i*)(y_ptr + j), _mm256_add_epi64(_mm256_sub_epi64(x, t), v2q));
+            }
+        }
+    }
+}
 
-    // Use _mm_mul_epu32 to compute pairs of 32-bit products (lanes 0&2 then 1&3).
-    __m128i alo = _mm_setr_epi32(a_lo[0], a_lo[1], a_lo[2], a_lo[3]);
-    __m128i ahi = _mm_setr_epi32(a_hi[0], a_hi[1], a_hi[2], a_hi[3]);
-    __m128i blo = _mm_setr_epi32(b_lo[0], b_lo[1], b_lo[2], b_lo[3]);
-    __m128i bhi = _mm_setr_epi32(b_hi[0], b_hi[1], b_hi[2], b_hi[3]);
-
-    // low*low products
-    __m128i p_lo = _mm_mul_epu32(alo, blo); // produces products for lanes 0 and 2 in 64-bit slots
-    __m128i alo_sh = _mm_shuffle_epi32(alo, _MM_SHUFFLE(2,3,0,1));
-    __m128i blo_sh = _mm_shuffle_epi32(blo, _MM_SHUFFLE(2,3,0,1));
-    __m128i p_lo_sh = _mm_mul_epu32(alo_sh, blo_sh); // lanes 1 and 3
-
-    // cross terms a_lo*b_hi and a_hi*b_lo
-    __m128i p_x1 = _mm_mul_epu32(alo, bhi);
-    __m128i p_x1_sh = _mm_mul_epu32(alo_sh, _mm_shuffle_epi32(bhi, _MM_SHUFFLE(2,3,0,1)));
-    __m128i p_x2 = _mm_mul_epu32(ahi, blo);
-    __m128i p_x2_sh = _mm_mul_epu32(_mm_shuffle_epi32(ahi, _MM_SHUFFLE(2,3,0,1)), blo_sh);
-
-    // high*high
-    __m128i p_hi = _mm_mul_epu32(ahi, bhi);
-    __m128i p_hi_sh = _mm_mul_epu32(_mm_shuffle_epi32(ahi, _MM_SHUFFLE(2,3,0,1)), _mm_shuffle_epi32(bhi, _MM_SHUFFLE(2,3,0,1)));
+static HE_TARGET_AVX2 void dit_run_shoup_avx2_impl(u64* x_ptr, size_t len, const u64* w, const u64* ws,
+                                                   size_t cnt, u64 mod) {
+    if (cnt % 4) {
+        dit_run_shoup(x_ptr, len, w, ws, cnt, mod);
+        return;
+    }
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * mod));
+    u64* y_ptr = x_ptr + len;
+    for (size_t j = 0; j < cnt; j += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(x_ptr + j));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(y_ptr + j));
+        __m256i wv = _mm256_loadu_si256((const __m256i*)(w + j));
+        __m256i wpv = _mm256_loadu_si256((const __m256i*)(ws + j));
+        x = csub(x, v2q);
+        __m256i t = shoup_mul_lazy4(y, wv, wpv, vq);
+        _mm256_storeu_si256((__m256i*)(x_ptr + j), _mm256_add_epi64(x, t));
+        _mm256_storeu_si256((__m256i*)(y_ptr + j), _mm256_add_epi64(_mm256_sub_epi64(x, t), v2q));
+    }
+}
 
-    // Extract 64-bit lanes
-    uint64_t low00 = (uint64_t)_mm_cvtsi128_si64(p_lo);
-    uint64_t low02 = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(p_lo, 8));
-    uint64_t low10 = (uint64_t)_mm_cvtsi128_si64(p_lo_sh);
-    uint64_t low12 = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(p_lo_sh, 8));
+static HE_TARGET_AVX2 void reduce_4q_avx2_impl(u64* a, size_t n, u64 mod) {
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * mod));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        x = csub(csub(x, v2q), vq);
+        _mm256_storeu_si256((__m256i*)(a + i), x);
+    }
+    for (; i < n; ++i) a[i] = reduce_4q(a[i], mod);
+}
 
-    uint64_t x10 = (uint64_t)_mm_cvtsi128_si64(p_x1);
-    uint64_t x12 = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(p_x1, 8));
-    uint64_t x11 = (uint64_t)_mm_cvtsi128_si64(p_x1_sh);
-    uint64_t x13 = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(p_x1_sh, 8));
+static HE_TARGET_AVX2 void mul_scalar_shoup_avx2_impl(u64* a, size_t n, u64 w, u64 wp, u64 mod) {
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i vw = _mm256_set1_epi64x((long long)w);
+    const __m256i vwp = _mm256_set1_epi64x((long long)wp);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        x = csub(shoup_mul_lazy4(x, vw, vwp, vq), vq);
+        _mm256_storeu_si256((__m256i*)(a + i), x);
+    }
+    for (; i < n; ++i) a[i] = shoup_mul(a[i], w, wp, mod);
+}
 
-    uint64_t y10 = (uint64_t)_mm_cvtsi128_si64(p_x2);
-    uint64_t y12 = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(p_x2, 8));
-    uint64_t y11 = (uint64_t)_mm_cvtsi128_si64(p_x2_sh);
-    uint64_t y13 = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(p_x2_sh, 8));
+// One Cooley-Tukey stage over butterflies [k0, k1) with one broadcast twiddle
+// per block. Stages with t < 4 and ranges not on 4-lane boundaries are scalar.
+static HE_TARGET_AVX2 void ct_stage_shoup_range_avx2_impl(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                                                          const u64* tw, const u64* tws, u64 mod) {
+    size_t t = n / (2 * m);
+    if (t < 4 || (k0 | k1) % 4) {
+        ct_stage_shoup_range(a, n, m, k0, k1, tw, tws, mod);
+        return;
+    }
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * mod));
+    size_t i = k0 / t, j = k0 % t;
+    for (size_t k = k0; k < k1; ++i, j = 0) {
+        const __m256i wv = _mm256_set1_epi64x((long long)tw[m + i]);
+        const __m256i wpv = _mm256_set1_epi64x((long long)tws[m + i]);
+        u64* x_ptr = a + 2 * i * t;
+        u64* y_ptr = x_ptr + t;
+        size_t j_end = (t - j < k1 - k) ? t : j + (k1 - k);
+        k += j_end - j;
+        for (; j < j_end; j += 4) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(x_ptr + j));
+            __m256i y = _mm256_loadu_si256((const __m256i*)(y_ptr + j));
+            x = csub(x, v2q);
+            __m256i v = shoup_mul_lazy4(y, wv, wpv, vq);
+            _mm256_storeu_si256((__m256i*)(x_ptr + j), _mm256_add_epi64(x, v));
+            _mm256_storeu_si256((__m256i*)(y_ptr + j), _mm256_add_epi64(_mm256_sub_epi64(x, v), v2q));
+        }
+    }
+}
 
-    uint64_t hi00 = (uint64_t)_mm_cvtsi128_si64(p_hi);
-    uint64_t hi02 = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(p_hi, 8));
-    uint64_t hi10 = (uint64_t)_mm_cvtsi128_si64(p_hi_sh);
-    uint64_t hi12 = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(p_hi_sh, 8));
+static HE_TARGET_AVX2 void ct_forward_shoup_avx2_impl(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod) {
+    for (size_t m = 1; m < n; m <<= 1) {
+        HE_PROF_LAYER(__builtin_ctzll(m));
+        ct_stage_shoup_range_avx2_impl(a, n, m, 0, n / 2, tw, tws, mod);
+    }
+}
 
-    // Now reconstruct 128-bit results per lane using 128-bit arithmetic (portable and correct)
-    __uint128_t r0 = ( (__uint128_t)low00 ) + ( (__uint128_t)(x10 + y10) << 32 ) + ( (__uint128_t)hi00 << 64 );
-    __uint128_t r1 = ( (__uint128_t)low10 ) + ( (__uint128_t)(x11 + y11) << 32 ) + ( (__uint128_t)hi10 << 64 );
-    __uint128_t r2 = ( (__uint128_t)low02 ) + ( (__uint128_t)(x12 + y12) << 32 ) + ( (__uint128_t)hi02 << 64 );
-    __uint128_t r3 = ( (__uint128_t)low12 ) + ( (__uint128_t)(x13 + y13) << 32 ) + ( (__uint128_t)hi12 << 64 );
+// Gentleman-Sande counterpart of ct_stage_shoup_range_avx2_impl.
+static HE_TARGET_AVX2 void gs_stage_shoup_range_avx2_impl(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                                                          const u64* tw, const u64* tws, u64 mod) {
+    size_t t = n / (2 * m);
+    if (t < 4 || (k0 | k1) % 4) {
+        gs_stage_shoup_range(a, n, m, k0, k1, tw, tws, mod);
+        return;
+    }
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * mod));
+    size_t i = k0 / t, j = k0 % t;
+    for (size_t k = k0; k < k1; ++i, j = 0) {
+        const __m256i wv = _mm256_set1_epi64x((long long)tw[m + i]);
+        const __m256i wpv = _mm256_set1_epi64x((long long)tws[m + i]);
+        u64* x_ptr = a + 2 * i * t;
+        u64* y_ptr = x_ptr + t;
+        size_t j_end = (t - j < k1 - k) ? t : j + (k1 - k);
+        k += j_end - j;
+        for (; j < j_end; j += 4) {
+            __m256i u = _mm256_loadu_si256((const __m256i*)(x_ptr + j));
+            __m256i v = _mm256_loadu_si256((const __m256i*)(y_ptr + j));
+            __m256i s = csub(_mm256_add_epi64(u, v), v2q);
+            __m256i d = _mm256_add_epi64(_mm256_sub_epi64(u, v), v2q);
+            _mm256_storeu_si256((__m256i*)(x_ptr + j), s);
+            _mm256_storeu_si256((__m256i*)(y_ptr + j), shoup_mul_lazy4(d, wv, wpv, vq));
+        }
+    }
+}
 
-    out[0] = (uint64_t)(r0 % mod);
-    out[1] = (uint64_t)(r1 % mod);
-    out[2] = (uint64_t)(r2 % mod);
-    out[3] = (uint64_t)(r3 % mod);
+// Final GS stage over j in [j0, j1): folds in n^{-1} and fully reduces.
+static HE_TARGET_AVX2 void gs_last_stage_shoup_range_avx2_impl(u64* a, size_t n, size_t j0, size_t j1,
+                                                               u64 last_w, u64 last_ws,
+                                                               u64 n_inv, u64 n_inv_shoup, u64 mod) {
+    size_t t = n / 2;
+    if (t < 4 || (j0 | j1) % 4) {
+        gs_last_stage_shoup_range(a, n, j0, j1, last_w, last_ws, n_inv, n_inv_shoup, mod);
+        return;
+    }
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * mod));
+    const __m256i lw = _mm256_set1_epi64x((long long)last_w);
+    const __m256i lws = _mm256_set1_epi64x((long long)last_ws);
+    const __m256i ni = _mm256_set1_epi64x((long long)n_inv);
+    const __m256i nis = _mm256_set1_epi64x((long long)n_inv_shoup);
+    for (size_t j = j0; j < j1; j += 4) {
+        __m256i u = _mm256_loadu_si256((const __m256i*)(a + j));
+        __m256i v = _mm256_loadu_si256((const __m256i*)(a + j + t));
+        __m256i s = _mm256_add_epi64(u, v);
+        __m256i d = _mm256_add_epi64(_mm256_sub_epi64(u, v), v2q);
+        _mm256_storeu_si256((__m256i*)(a + j), csub(shoup_mul_lazy4(s, ni, nis, vq), vq));
+        _mm256_storeu_si256((__m256i*)(a + j + t), csub(shoup_mul_lazy4(d, lw, lws, vq), vq));
+    }
 }
 
-static inline __m256i load_u64x4(const uint64_t* p) {
-    return _mm256_setr_epi64x((long long)p[0], (long long)p[1], (long long)p[2], (long long)p[3]);
+// GS stages m and m/2 fused, t = n / 2m >= 4. Only the inverse is fused on
+// this path: the AVX2 forward drivers stay radix 2, since the emulated 64-bit
+// products already make them compute-bound and the extra twiddle registers
+// of a fused pass spill, which measured slower.
+static HE_TARGET_AVX2 void gs_stage4_shoup_avx2(u64* a, size_t n, size_t m, const u64* tw, const u64* tws,
+                                                __m256i vq, __m256i v2q) {
+    const size_t t = n / (2 * m);
+    for (size_t i = 0; i < m / 2; ++i) {
+        const __m256i w1 = _mm256_set1_epi64x((long long)tw[m + 2 * i]);
+        const __m256i ws1 = _mm256_set1_epi64x((long long)tws[m + 2 * i]);
+        const __m256i w2 = _mm256_set1_epi64x((long long)tw[m + 2 * i + 1]);
+        const __m256i ws2 = _mm256_set1_epi64x((long long)tws[m + 2 * i + 1]);
+        const __m256i w3 = _mm256_set1_epi64x((long long)tw[m / 2 + i]);
+        const __m256i ws3 = _mm256_set1_epi64x((long long)tws[m / 2 + i]);
+        u64* x = a + 4 * i * t;
+        for (size_t j = 0; j < t; j += 4) {
+            __m256i a0 = _mm256_loadu_si256((const __m256i*)(x + j));
+            __m256i a1 = _mm256_loadu_si256((const __m256i*)(x + j + t));
+            __m256i a2 = _mm256_loadu_si256((const __m256i*)(x + j + 2 * t));
+            __m256i a3 = _mm256_loadu_si256((const __m256i*)(x + j + 3 * t));
+            gs_bfly4(a0, a1, w1, ws1, vq, v2q);
+            gs_bfly4(a2, a3, w2, ws2, vq, v2q);
+            gs_bfly4(a0, a2, w3, ws3, vq, v2q);
+            gs_bfly4(a1, a3, w3, ws3, vq, v2q);
+            _mm256_storeu_si256((__m256i*)(x + j), a0);
+            _mm256_storeu_si256((__m256i*)(x + j + t), a1);
+            _mm256_storeu_si256((__m256i*)(x + j + 2 * t), a2);
+            _mm256_storeu_si256((__m256i*)(x + j + 3 * t), a3);
+        }
+    }
 }
-static inline void store_u64x4(uint64_t* p, __m256i v) {
-    alignas(32) uint64_t tmp[4];
-    _mm256_storeu_si256((__m256i*)tmp, v);
-    p[0]=tmp[0]; p[1]=tmp[1]; p[2]=tmp[2]; p[3]=tmp[3];
+
+static HE_TARGET_AVX2 void gs_inverse_shoup_avx2_impl(u64* a, size_t n, const u64* tw, const u64* tws,
+                                                      u64 last_w, u64 last_ws, u64 n_inv, u64 n_inv_shoup, u64 mod) {
+    if (n < 8) {
+        gs_inverse_shoup(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
+        return;
+    }
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * mod));
+    // the t = 1, 2 pair in one scalar radix-4 pass, then stages n/8 .. 2
+    // vectorised in pairs, plus a radix-2 stage when their number is odd
+    HE_PROF_LAYER(0);
+    gs_stage4_shoup(a, n, n / 2, tw, tws, mod);
+    size_t m = n / 8;
+    for (; m >= 4; m >>= 2) {
+        HE_PROF_LAYER(__builtin_ctzll(n) - 1 - __builtin_ctzll(m));
+        gs_stage4_shoup_avx2(a, n, m, tw, tws, vq, v2q);
+    }
+    if (m == 2) {
+        HE_PROF_LAYER(__builtin_ctzll(n) - 2);
+        gs_stage_shoup_range_avx2_impl(a, n, 2, 0, n / 2, tw, tws, mod);
+    }
+    HE_PROF_LAYER(__builtin_ctzll(n) - 1);
+    gs_last_stage_shoup_range_avx2_impl(a, n, 0, n / 2, last_w, last_ws, n_inv, n_inv_shoup, mod);
 }
 
-void ntt_avx2_core(std::vector<u64>& a, const std::vector<u64>& mroots, u64 mod) {
-    size_t n = a.size();
-    for (size_t len = 1; len < n; len <<= 1) {
+static HE_TARGET_AVX2 void ntt_avx2_core_impl(u64* a, size_t n, const u64* mroots, u64 mod) {
+    Montgomery M(mod);
+    size_t len = 1;
+    for (; len < n && len < 4; len <<= 1) dit_layer_mont_scalar(a, n, len, mroots, M);
+    const __m256i vq = _mm256_set1_epi64x((long long)mod);
+    const __m256i v2q = _mm256_set1_epi64x((long long)(2 * mod));
+    const __m256i vninv = _mm256_set1_epi64x((long long)M.ninv);
+    for (; len < n; len <<= 1) {
         size_t step = n / (2 * len);
+        const __m256i lane_idx = _mm256_setr_epi64x(0, (long long)step, (long long)(2 * step), (long long)(3 * step));
+        const __m256i idx_inc = _mm256_set1_epi64x((long long)(4 * step));
         for (size_t i = 0; i < n; i += 2 * len) {
-            size_t j = 0;
-            for (; j + 4 <= len; j += 4) {
-                uint64_t uvals[4], bvals[4], wvals[4];
-                for (int t = 0; t < 4; ++t) {
-                    uvals[t] = a[i + j + t];
-                    bvals[t] = a[i + j + len + t];
-                    wvals[t] = mroots[step * (j + t)];
-                }
-                uint64_t vtmp[4];
-                vec_mul64_mod_4(bvals, wvals, mod, vtmp);
-                __m256i uvec = load_u64x4(uvals);
-                __m256i vvec = load_u64x4(vtmp);
-                __m256i xvec = _mm256_add_epi64(uvec, vvec);
-                // handle reduction: x >= mod
-                __m256i modvec = _mm256_set1_epi64x((long long)mod);
-                __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
-                __m256i xs = _mm256_xor_si256(xvec, bias);
-                __m256i ms = _mm256_xor_si256(modvec, bias);
-                __m256i cmp = _mm256_cmpgt_epi64(xs, _mm256_sub_epi64(ms, _mm256_set1_epi64x(1)));
-                __m256i xsub = _mm256_sub_epi64(xvec, modvec);
-                __m256i xres = _mm256_blendv_epi8(xvec, xsub, cmp);
-                store_u64x4(&a[i + j], xres);
-                for (int t=0;t<4;++t) {
-                    uint64_t u = uvals[t];
-                    uint64_t v = vtmp[t];
-                    uint64_t y = (u >= v) ? u - v : u + mod - v;
-                    a[i + j + len + t] = y;
-                }
-            }
-            for (; j < len; ++j) {
-                u64 u = a[i + j];
-                u64 v = (u128)a[i + j + len] * mroots[step * j] % mod;
-                u64 x = u + v;
-                if (x >= mod) x -= mod;
-                a[i + j] = x;
-                u64 y = (u >= v) ? u - v : u + mod - v;
-                a[i + j + len] = y;
+            u64* x_ptr = a + i;
+            u64* y_ptr = a + i + len;
+            __m256i idx = lane_idx;
+            for (size_t j = 0; j < len; j += 4) {
+                __m256i x = _mm256_loadu_si256((const __m256i*)(x_ptr + j));
+                __m256i y = _mm256_loadu_si256((const __m256i*)(y_ptr + j));
+                // natural-order roots are strided by 'step'; contiguous in the last layer
+                __m256i wv = (step == 1)
+                    ? _mm256_loadu_si256((const __m256i*)(mroots + j))
+                    : _mm256_i64gather_epi64((const long long*)mroots, idx, 8);
+                idx = _mm256_add_epi64(idx, idx_inc);
+                x = csub(x, v2q);
+                __m256i t = mont_mul_lazy4(y, wv, vq, vninv);
+                _mm256_storeu_si256((__m256i*)(x_ptr + j), _mm256_add_epi64(x, t));
+                _mm256_storeu_si256((__m256i*)(y_ptr + j), _mm256_add_epi64(_mm256_sub_epi64(x, t), v2q));
             }
         }
     }
+    reduce_4q_avx2_impl(a, n, mod);
+}
+
+// --- 32-bit path: 8 lanes of u32, mod < 2^31, values fully reduced ---
+
+// high 32 bits of a*b per 32-bit lane (two _mm256_mul_epu32, even/odd lanes)
+static inline HE_TARGET_AVX2 __m256i mulhi32x8(__m256i a, __m256i b) {
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+// x < 2q -> x mod q: x - q wraps above x exactly when x < q
+static inline HE_TARGET_AVX2 __m256i csub32(__m256i x, __m256i q) {
+    return _mm256_min_epu32(x, _mm256_sub_epi32(x, q));
+}
+
+static inline HE_TARGET_AVX2 __m256i shoup_mul32x8(__m256i y, __m256i w, __m256i wp, __m256i q) {
+    __m256i hi = mulhi32x8(y, wp);
+    return csub32(_mm256_sub_epi32(_mm256_mullo_epi32(y, w), _mm256_mullo_epi32(hi, q)), q);
+}
+
+static inline HE_TARGET_AVX2 void bfly32(__m256i& x, __m256i& y, __m256i w, __m256i wp, __m256i q, bool inverse) {
+    if (!inverse) {
+        __m256i v = shoup_mul32x8(y, w, wp, q);
+        __m256i d = _mm256_add_epi32(_mm256_sub_epi32(x, v), q);
+        x = csub32(_mm256_add_epi32(x, v), q);
+        y = csub32(d, q);
+    } else {
+        __m256i d = _mm256_add_epi32(_mm256_sub_epi32(x, y), q);
+        x = csub32(_mm256_add_epi32(x, y), q);
+        y = shoup_mul32x8(d, w, wp, q);
+    }
+}
+
+// Stages with t >= 8: one broadcast twiddle per block.
+static HE_TARGET_AVX2 void wide_stage32(u32* a, size_t n, size_t m, const u32* tw, const u32* tws,
+                                        __m256i vq, bool inverse) {
+    size_t t = n / (2 * m);
+    for (size_t i = 0; i < m; ++i) {
+        const __m256i wv = _mm256_set1_epi32((int)tw[m + i]);
+        const __m256i wpv = _mm256_set1_epi32((int)tws[m + i]);
+        u32* x_ptr = a + 2 * i * t;
+        u32* y_ptr = x_ptr + t;
+        for (size_t j = 0; j < t; j += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(x_ptr + j));
+            __m256i y = _mm256_loadu_si256((const __m256i*)(y_ptr + j));
+            bfly32(x, y, wv, wpv, vq, inverse);
+            _mm256_storeu_si256((__m256i*)(x_ptr + j), x);
+            _mm256_storeu_si256((__m256i*)(y_ptr + j), y);
+        }
+    }
+}
+
+// Stages with t = 4, 2, 1: 16 coefficients (16 / 2t blocks) per step, with
+// the x and y halves regrouped into two vectors and the per-block twiddles
+// permuted into matching lanes.
+static HE_TARGET_AVX2 void narrow_stage32(u32* a, size_t n, size_t m, const u32* tw, const u32* tws,
+                                          __m256i vq, bool inverse) {
+    size_t t = n / (2 * m);
+    const size_t blocks = 8 / t;  // per 16 coefficients
+    __m256i idx;
+    if (t == 4) idx = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    else if (t == 2) idx = _mm256_setr_epi32(0, 0, 2, 2, 1, 1, 3, 3);
+    else idx = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    for (size_t b = 0; b < n; b += 16) {
+        const u32* w = tw + m + b / (2 * t);
+        const u32* wp = tws + m + b / (2 * t);
+        __m256i wv, wpv;
+        if (blocks == 2) {
+            wv = _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)w));
+            wpv = _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)wp));
+        } else if (blocks == 4) {
+            wv = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)w));
+            wpv = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)wp));
+        } else {
+            wv = _mm256_loadu_si256((const __m256i*)w);
+            wpv = _mm256_loadu_si256((const __m256i*)wp);
+        }
+        wv = _mm256_permutevar8x32_epi32(wv, idx);
+        wpv = _mm256_permutevar8x32_epi32(wpv, idx);
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)(a + b));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(a + b + 8));
+        __m256i x, y;
+        if (t == 4) {
+            x = _mm256_permute2x128_si256(v0, v1, 0x20);
+            y = _mm256_permute2x128_si256(v0, v1, 0x31);
+        } else if (t == 2) {
+            x = _mm256_unpacklo_epi64(v0, v1);
+            y = _mm256_unpackhi_epi64(v0, v1);
+        } else {
+            x = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(v0), _mm256_castsi256_ps(v1),
+                                                      _MM_SHUFFLE(2, 0, 2, 0)));
+            y = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(v0), _mm256_castsi256_ps(v1),
+                                                      _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+        bfly32(x, y, wv, wpv, vq, inverse);
+        if (t == 4) {
+            v0 = _mm256_permute2x128_si256(x, y, 0x20);
+            v1 = _mm256_permute2x128_si256(x, y, 0x31);
+        } else if (t == 2) {
+            v0 = _mm256_unpacklo_epi64(x, y);
+            v1 = _mm256_unpackhi_epi64(x, y);
+        } else {
+            v0 = _mm256_unpacklo_epi32(x, y);
+            v1 = _mm256_unpackhi_epi32(x, y);
+        }
+        _mm256_storeu_si256((__m256i*)(a + b), v0);
+        _mm256_storeu_si256((__m256i*)(a + b + 8), v1);
+    }
+}
+
+static HE_TARGET_AVX2 void ct_forward_shoup32_avx2_impl(u32* a, size_t n, const u32* tw, const u32* tws, u32 mod) {
+    if (n < 16) {
+        ct_forward_shoup32(a, n, tw, tws, mod);
+        return;
+    }
+    const __m256i vq = _mm256_set1_epi32((int)mod);
+    size_t m = 1;
+    for (; n / (2 * m) >= 8; m <<= 1) wide_stage32(a, n, m, tw, tws, vq, false);
+    for (; m < n; m <<= 1) narrow_stage32(a, n, m, tw, tws, vq, false);
+}
+
+static HE_TARGET_AVX2 void gs_inverse_shoup32_avx2_impl(u32* a, size_t n, const u32* tw, const u32* tws,
+                                                        u32 last_w, u32 last_ws, u32 n_inv, u32 n_inv_shoup,
+                                                        u32 mod) {
+    if (n < 16) {
+        gs_inverse_shoup32(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
+        return;
+    }
+    const __m256i vq = _mm256_set1_epi32((int)mod);
+    size_t m = n / 2;
+    for (; n / (2 * m) < 8; m >>= 1) narrow_stage32(a, n, m, tw, tws, vq, true);
+    for (; m > 1; m >>= 1) wide_stage32(a, n, m, tw, tws, vq, true);
+    const __m256i lw = _mm256_set1_epi32((int)last_w);
+    const __m256i lws = _mm256_set1_epi32((int)last_ws);
+    const __m256i ni = _mm256_set1_epi32((int)n_inv);
+    const __m256i nis = _mm256_set1_epi32((int)n_inv_shoup);
+    size_t t = n / 2;
+    for (size_t j = 0; j < t; j += 8) {
+        __m256i u = _mm256_loadu_si256((const __m256i*)(a + j));
+        __m256i v = _mm256_loadu_si256((const __m256i*)(a + j + t));
+        __m256i s = _mm256_add_epi32(u, v);
+        __m256i d = _mm256_add_epi32(_mm256_sub_epi32(u, v), vq);
+        _mm256_storeu_si256((__m256i*)(a + j), shoup_mul32x8(s, ni, nis, vq));
+        _mm256_storeu_si256((__m256i*)(a + j + t), shoup_mul32x8(d, lw, lws, vq));
+    }
+}
+
+void ntt_avx2_core(u64* a, size_t n, const u64* mroots, u64 mod) {
+    if (!host_has_avx2()) {
+        ntt_montgomery_core(a, n, mroots, mod);
+        return;
+    }
+    bit_reverse_permute(a, n);
+    ntt_avx2_core_impl(a, n, mroots, mod);
+}
+
+void ntt_avx2_core(std::vector<u64>& a, const std::vector<u64>& mroots, u64 mod) {
+    ntt_avx2_core(a.data(), a.size(), mroots.data(), mod);
+}
+
+void dit_layers_shoup_avx2(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod) {
+    if (!host_has_avx2()) {
+        dit_layers_shoup(a, n, tw, tws, mod);
+        return;
+    }
+    dit_layers_shoup_avx2_impl(a, n, tw, tws, mod);
+}
+
+void ct_forward_shoup_avx2(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod) {
+    if (!host_has_avx2()) {
+        ct_forward_shoup(a, n, tw, tws, mod);
+        return;
+    }
+    ct_forward_shoup_avx2_impl(a, n, tw, tws, mod);
+}
+
+void gs_inverse_shoup_avx2(u64* a, size_t n, const u64* tw, const u64* tws,
+                           u64 last_w, u64 last_ws, u64 n_inv, u64 n_inv_shoup, u64 mod) {
+    if (!host_has_avx2()) {
+        gs_inverse_shoup(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
+        return;
+    }
+    gs_inverse_shoup_avx2_impl(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
+}
+
+void dit_run_shoup_avx2(u64* x, size_t len, const u64* w, const u64* ws, size_t cnt, u64 mod) {
+    if (!host_has_avx2()) {
+        dit_run_shoup(x, len, w, ws, cnt, mod);
+        return;
+    }
+    dit_run_shoup_avx2_impl(x, len, w, ws, cnt, mod);
+}
+
+void ct_stage_shoup_range_avx2(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                               const u64* tw, const u64* tws, u64 mod) {
+    if (!host_has_avx2()) {
+        ct_stage_shoup_range(a, n, m, k0, k1, tw, tws, mod);
+        return;
+    }
+    ct_stage_shoup_range_avx2_impl(a, n, m, k0, k1, tw, tws, mod);
+}
+
+void gs_stage_shoup_range_avx2(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                               const u64* tw, const u64* tws, u64 mod) {
+    if (!host_has_avx2()) {
+        gs_stage_shoup_range(a, n, m, k0, k1, tw, tws, mod);
+        return;
+    }
+    gs_stage_shoup_range_avx2_impl(a, n, m, k0, k1, tw, tws, mod);
+}
+
+void gs_last_stage_shoup_range_avx2(u64* a, size_t n, size_t j0, size_t j1, u64 last_w, u64 last_ws,
+                                    u64 n_inv, u64 n_inv_shoup, u64 mod) {
+    if (!host_has_avx2()) {
+        gs_last_stage_shoup_range(a, n, j0, j1, last_w, last_ws, n_inv, n_inv_shoup, mod);
+        return;
+    }
+    gs_last_stage_shoup_range_avx2_impl(a, n, j0, j1, last_w, last_ws, n_inv, n_inv_shoup, mod);
+}
+
+void reduce_4q_avx2(u64* a, size_t n, u64 mod) {
+    if (!host_has_avx2()) {
+        reduce_4q_array(a, n, mod);
+        return;
+    }
+    reduce_4q_avx2_impl(a, n, mod);
+}
+
+void mul_scalar_shoup_avx2(u64* a, size_t n, u64 w, u64 wp, u64 mod) {
+    if (!host_has_avx2()) {
+        mul_scalar_shoup_array(a, n, w, wp, mod);
+        return;
+    }
+    mul_scalar_shoup_avx2_impl(a, n, w, wp, mod);
+}
+
+void ct_forward_shoup32_avx2(u32* a, size_t n, const u32* tw, const u32* tws, u32 mod) {
+    if (!host_has_avx2()) {
+        ct_forward_shoup32(a, n, tw, tws, mod);
+        return;
+    }
+    ct_forward_shoup32_avx2_impl(a, n, tw, tws, mod);
+}
+
+void gs_inverse_shoup32_avx2(u32* a, size_t n, const u32* tw, const u32* tws,
+                             u32 last_w, u32 last_ws, u32 n_inv, u32 n_inv_shoup, u32 mod) {
+    if (!host_has_avx2()) {
+        gs_inverse_shoup32(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
+        return;
+    }
+    gs_inverse_shoup32_avx2_impl(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
 }
 
 #else
+// No x86 SIMD available at compile time: scalar equivalents.
+void ntt_avx2_core(u64* a, size_t n, const u64* mroots, u64 mod) {
+    ntt_montgomery_core(a, n, mroots, mod);
+}
 void ntt_avx2_core(std::vector<u64>& a, const std::vector<u64>& mroots, u64 mod) {
-    (void)a; (void)mroots; (void)mod;
+    ntt_montgomery_core(a, mroots, mod);
+}
+void dit_layers_shoup_avx2(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod) {
+    dit_layers_shoup(a, n, tw, tws, mod);
+}
+void ct_forward_shoup_avx2(u64* a, size_t n, const u64* tw, const u64* tws, u64 mod) {
+    ct_forward_shoup(a, n, tw, tws, mod);
+}
+void gs_inverse_shoup_avx2(u64* a, size_t n, const u64* tw, const u64* tws,
+                           u64 last_w, u64 last_ws, u64 n_inv, u64 n_inv_shoup, u64 mod) {
+    gs_inverse_shoup(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
+}
+void dit_run_shoup_avx2(u64* x, size_t len, const u64* w, const u64* ws, size_t cnt, u64 mod) {
+    dit_run_shoup(x, len, w, ws, cnt, mod);
+}
+void ct_stage_shoup_range_avx2(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                               const u64* tw, const u64* tws, u64 mod) {
+    ct_stage_shoup_range(a, n, m, k0, k1, tw, tws, mod);
+}
+void gs_stage_shoup_range_avx2(u64* a, size_t n, size_t m, size_t k0, size_t k1,
+                               const u64* tw, const u64* tws, u64 mod) {
+    gs_stage_shoup_range(a, n, m, k0, k1, tw, tws, mod);
+}
+void gs_last_stage_shoup_range_avx2(u64* a, size_t n, size_t j0, size_t j1, u64 last_w, u64 last_ws,
+                                    u64 n_inv, u64 n_inv_shoup, u64 mod) {
+    gs_last_stage_shoup_range(a, n, j0, j1, last_w, last_ws, n_inv, n_inv_shoup, mod);
+}
+void reduce_4q_avx2(u64* a, size_t n, u64 mod) {
+    reduce_4q_array(a, n, mod);
+}
+void mul_scalar_shoup_avx2(u64* a, size_t n, u64 w, u64 wp, u64 mod) {
+    mul_scalar_shoup_array(a, n, w, wp, mod);
+}
+void ct_forward_shoup32_avx2(u32* a, size_t n, const u32* tw, const u32* tws, u32 mod) {
+    ct_forward_shoup32(a, n, tw, tws, mod);
+}
+void gs_inverse_shoup32_avx2(u32* a, size_t n, const u32* tw, const u32* tws,
+                             u32 last_w, u32 last_ws, u32 n_inv, u32 n_inv_shoup, u32 mod) {
+    gs_inverse_shoup32(a, n, tw, tws, last_w, last_ws, n_inv, n_inv_shoup, mod);
 }
 #endif
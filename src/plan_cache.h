@@ -0,0 +1,10 @@
+#pragma once
+#include "ntt_plan.h"
+
+// Internal access to the cached_plan cache.
+
+// The cached plan for (n, mod), or nullptr; never builds one.
+const NttPlan* plan_cache_find(size_t n, u64 mod);
+// Adds a copy of 'plan' unless (plan.n, plan.mod) is already cached; returns
+// whether it was added. View tables are copied as views.
+bool plan_cache_insert(const NttPlan& plan);
@@ -0,0 +1,293 @@
+#include "plan_file.h"
+#include "plan_cache.h"
+#include "autotune.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using u64 = uint64_t;
+using u32 = uint32_t;
+
+static const char plan_file_magic[8] = {'H', 'E', 'P', 'L', 'A', 'N', 'S', '\0'};
+static const u32 byte_order_mark = 0x01020304;
+static const size_t table_align = 64;
+
+struct PlanFileHeader {
+    char magic[8];
+    u32 version;
+    u32 byte_order;
+    u64 count;
+    u64 file_bytes;
+    u64 reserved[4];
+};
+static_assert(sizeof(PlanFileHeader) == 64, "plan file header layout");
+
+struct PlanFileEntry {
+    u64 n, mod, root, psi;
+    u64 n_inv, n_inv_mont, n_inv_shoup;
+    u64 nega_inv_last, nega_inv_last_shoup;
+    u64 offset;  // first table
+    u64 bytes;   // all tables, padding included
+    u32 log_n, narrow;
+    u32 n_inv32_shoup, nega_inv_last32_shoup;
+    u64 reserved[3];
+};
+static_assert(sizeof(PlanFileEntry) == 128, "plan file entry layout");
+
+// Table order in the file; nega_* only with psi, *32 only when narrow
+// (nega_*32 only when both).
+static PlanTable<u64> NttPlan::* const base_tables[] = {
+    &NttPlan::fwd_tw, &NttPlan::inv_tw, &NttPlan::fwd_tw_mont, &NttPlan::fwd_tw_shoup, &NttPlan::inv_tw_shoup,
+    &NttPlan::br_fwd_tw, &NttPlan::br_fwd_tw_shoup, &NttPlan::br_inv_tw, &NttPlan::br_inv_tw_shoup,
+};
+static PlanTable<u64> NttPlan::* const nega_tables[] = {
+    &NttPlan::nega_fwd_tw, &NttPlan::nega_fwd_tw_shoup, &NttPlan::nega_inv_tw, &NttPlan::nega_inv_tw_shoup,
+};
+static PlanTable<u32> NttPlan::* const narrow_tables[] = {
+    &NttPlan::br_fwd_tw32, &NttPlan::br_fwd_tw32_shoup, &NttPlan::br_inv_tw32, &NttPlan::br_inv_tw32_shoup,
+};
+static PlanTable<u32> NttPlan::* const narrow_nega_tables[] = {
+    &NttPlan::nega_fwd_tw32, &NttPlan::nega_fwd_tw32_shoup, &NttPlan::nega_inv_tw32, &NttPlan::nega_inv_tw32_shoup,
+};
+static const size_t base_count = sizeof(base_tables) / sizeof(base_tables[0]);
+static const size_t nega_count = sizeof(nega_tables) / sizeof(nega_tables[0]);
+static const size_t narrow_count = sizeof(narrow_tables) / sizeof(narrow_tables[0]);
+static const size_t narrow_nega_count = sizeof(narrow_nega_tables) / sizeof(narrow_nega_tables[0]);
+
+static size_t round_up(size_t x) {
+    return (x + table_align - 1) / table_align * table_align;
+}
+
+static size_t tables_bytes(size_t n, bool nega, bool narrow) {
+    size_t b = base_count * round_up(n * sizeof(u64));
+    if (nega) b += nega_count * round_up(n * sizeof(u64));
+    if (narrow) b += narrow_count * round_up(n * sizeof(u32));
+    if (narrow && nega) b += narrow_nega_count * round_up(n * sizeof(u32));
+    return b;
+}
+
+// --- writer ---
+
+static bool write_padded(FILE* f, const void* p, size_t bytes) {
+    static const unsigned char zeros[table_align] = {};
+    if (bytes && fwrite(p, 1, bytes, f) != bytes) return false;
+    size_t pad = round_up(bytes) - bytes;
+    return !pad || fwrite(zeros, 1, pad, f) == pad;
+}
+
+template <class T>
+static bool write_table(FILE* f, const PlanTable<T>& t, size_t n) {
+    assert(t.size() == n);
+    return write_padded(f, t.data(), n * sizeof(T));
+}
+
+bool write_plan_file(const char* path, const std::vector<const NttPlan*>& plans) {
+    PlanFileHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, plan_file_magic, sizeof h.magic);
+    h.version = PLAN_FILE_VERSION;
+    h.byte_order = byte_order_mark;
+    h.count = plans.size();
+
+    std::vector<PlanFileEntry> dir(plans.size());
+    size_t offset = round_up(sizeof h + dir.size() * sizeof(PlanFileEntry));
+    for (size_t i = 0; i < plans.size(); ++i) {
+        const NttPlan& p = *plans[i];
+        PlanFileEntry& e = dir[i];
+        memset(&e, 0, sizeof e);
+        e.n = p.n;
+        e.mod = p.mod;
+        e.root = p.root;
+        e.psi = p.psi;
+        e.n_inv = p.n_inv;
+        e.n_inv_mont = p.n_inv_mont;
+        e.n_inv_shoup = p.n_inv_shoup;
+        e.nega_inv_last = p.nega_inv_last;
+        e.nega_inv_last_shoup = p.nega_inv_last_shoup;
+        e.log_n = p.log_n;
+        e.narrow = p.narrow;
+        e.n_inv32_shoup = p.n_inv32_shoup;
+        e.nega_inv_last32_shoup = p.nega_inv_last32_shoup;
+        e.offset = offset;
+        e.bytes = tables_bytes(p.n, p.has_negacyclic(), p.narrow);
+        offset += e.bytes;
+    }
+    h.file_bytes = offset;
+
+    // write a private temporary and rename it over 'path': processes that
+    // already mapped the old file keep their (unlinked) copy
+    std::string tmp = std::string(path) + ".tmp." + std::to_string((long)getpid());
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(&h, sizeof h, 1, f) == 1 &&
+              write_padded(f, dir.data(), dir.size() * sizeof(PlanFileEntry));
+    for (size_t i = 0; ok && i < plans.size(); ++i) {
+        const NttPlan& p = *plans[i];
+        for (size_t k = 0; ok && k < base_count; ++k) ok = write_table(f, p.*base_tables[k], p.n);
+        for (size_t k = 0; ok && p.has_negacyclic() && k < nega_count; ++k) ok = write_table(f, p.*nega_tables[k], p.n);
+        for (size_t k = 0; ok && p.narrow && k < narrow_count; ++k) ok = write_table(f, p.*narrow_tables[k], p.n);
+        for (size_t k = 0; ok && p.narrow && p.has_negacyclic() && k < narrow_nega_count; ++k)
+            ok = write_table(f, p.*narrow_nega_tables[k], p.n);
+    }
+    ok = fflush(f) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+    if (ok) ok = rename(tmp.c_str(), path) == 0;
+    if (!ok) remove(tmp.c_str());
+    return ok;
+}
+
+bool write_plan_file(const char* path, const std::vector<std::pair<size_t, u64>>& params) {
+    std::vector<std::unique_ptr<NttPlan>> own;
+    std::vector<const NttPlan*> plans;
+    for (const auto& nq : params) {
+        own.emplace_back(new NttPlan(nq.first, nq.second));
+        plans.push_back(own.back().get());
+    }
+    return write_plan_file(path, plans);
+}
+
+// --- reader ---
+
+PlanFile::~PlanFile() {
+    close();
+}
+
+void PlanFile::close() {
+    if (base_) munmap(const_cast<unsigned char*>(base_), bytes_);
+    base_ = nullptr;
+    bytes_ = 0;
+    count_ = 0;
+}
+
+static bool entry_valid(const PlanFileEntry& e, size_t file_bytes) {
+    if (e.n < 2 || (e.n & (e.n - 1)) || e.log_n >= 64 || (u64(1) << e.log_n) != e.n) return false;
+    // an odd modulus above 2 (Montgomery constants), roots reduced
+    if (e.mod < 3 || !(e.mod & 1) || e.root >= e.mod || e.psi >= e.mod) return false;
+    if (e.mod >= (u64(1) << 62) || (e.narrow && e.mod >= (u64(1) << 31))) return false;
+    if (e.offset % table_align || e.bytes != tables_bytes(e.n, e.psi != 0, e.narrow != 0)) return false;
+    return e.offset <= file_bytes && e.bytes <= file_bytes - e.offset;
+}
+
+bool PlanFile::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    void* m = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(PlanFileHeader)) {
+        m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);  // the mapping stays valid
+    if (m == MAP_FAILED) return false;
+    base_ = static_cast<const unsigned char*>(m);
+    bytes_ = (size_t)st.st_size;
+
+    const PlanFileHeader* h = reinterpret_cast<const PlanFileHeader*>(base_);
+    bool ok = memcmp(h->magic, plan_file_magic, sizeof h->magic) == 0 && h->version == PLAN_FILE_VERSION &&
+              h->byte_order == byte_order_mark && h->file_bytes == bytes_ &&
+              h->count <= (bytes_ - sizeof *h) / sizeof(PlanFileEntry);
+    const PlanFileEntry* dir = reinterpret_cast<const PlanFileEntry*>(base_ + sizeof *h);
+    for (u64 i = 0; ok && i < h->count; ++i) ok = entry_valid(dir[i], bytes_);
+    if (!ok) {
+        close();
+        return false;
+    }
+    count_ = h->count;
+    return true;
+}
+
+static const PlanFileEntry& entry(const unsigned char* base, size_t i) {
+    return reinterpret_cast<const PlanFileEntry*>(base + sizeof(PlanFileHeader))[i];
+}
+
+size_t PlanFile::n(size_t i) const {
+    assert(i < count_);
+    return entry(base_, i).n;
+}
+
+u64 PlanFile::mod(size_t i) const {
+    assert(i < count_);
+    return entry(base_, i).mod;
+}
+
+size_t PlanFile::find(size_t n, u64 mod) const {
+    for (size_t i = 0; i < count_; ++i) {
+        const PlanFileEntry& e = entry(base_, i);
+        if (e.n == n && e.mod == mod) return i;
+    }
+    return count_;
+}
+
+void PlanFile::get(size_t i, NttPlan& p) const {
+    assert(i < count_);
+    const PlanFileEntry& e = entry(base_, i);
+    p.n = e.n;
+    p.log_n = e.log_n;
+    p.mod = e.mod;
+    p.root = e.root;
+    p.psi = e.psi;
+    p.n_inv = e.n_inv;
+    p.n_inv_mont = e.n_inv_mont;
+    p.n_inv_shoup = e.n_inv_shoup;
+    p.mont.init(e.mod);
+    tune_apply(p);
+    p.nega_inv_last = e.nega_inv_last;
+    p.nega_inv_last_shoup = e.nega_inv_last_shoup;
+    p.narrow = e.narrow != 0;
+    p.n_inv32_shoup = e.n_inv32_shoup;
+    p.nega_inv_last32_shoup = e.nega_inv_last32_shoup;
+
+    const unsigned char* t = base_ + e.offset;
+    for (size_t k = 0; k < base_count; ++k, t += round_up(p.n * sizeof(u64)))
+        (p.*base_tables[k]).set_view(reinterpret_cast<const u64*>(t), p.n);
+    for (size_t k = 0; k < nega_count; ++k) {
+        if (!p.psi) {
+            (p.*nega_tables[k]).clear();
+            continue;
+        }
+        (p.*nega_tables[k]).set_view(reinterpret_cast<const u64*>(t), p.n);
+        t += round_up(p.n * sizeof(u64));
+    }
+    for (size_t k = 0; k < narrow_count; ++k) {
+        if (!p.narrow) {
+            (p.*narrow_tables[k]).clear();
+            continue;
+        }
+        (p.*narrow_tables[k]).set_view(reinterpret_cast<const u32*>(t), p.n);
+        t += round_up(p.n * sizeof(u32));
+    }
+    for (size_t k = 0; k < narrow_nega_count; ++k) {
+        if (!p.narrow || !p.psi) {
+            (p.*narrow_nega_tables[k]).clear();
+            continue;
+        }
+        (p.*narrow_nega_tables[k]).set_view(reinterpret_cast<const u32*>(t), p.n);
+        t += round_up(p.n * sizeof(u32));
+    }
+}
+
+size_t preload_plan_file(const char* path) {
+    // mapped for the life of the process, like the cached plans that view them
+    static std::mutex mu;
+    static std::vector<std::unique_ptr<PlanFile>> files;
+    std::unique_ptr<PlanFile> f(new PlanFile);
+    if (!f->open(path)) return 0;
+    size_t added = 0;
+    for (size_t i = 0; i < f->size(); ++i) {
+        NttPlan p;
+        f->get(i, p);
+        if (plan_cache_insert(p)) ++added;
+    }
+    // nothing inserted means nothing views the mapping
+    if (!added) return 0;
+    std::lock_guard<std::mutex> lock(mu);
+    files.push_back(std::move(f));
+    return added;
+}
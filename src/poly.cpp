@@ -1,17 +1,179 @@
 \
 #include "poly.h"
+#include "ntt.h"
+#include "mod_arith.h"
+#include <algorithm>
+#include <cassert>
 #include <vector>
 using u64 = uint64_t;
 using u128 = __uint128_t;
 
 std::vector<u64> poly_mul_naive(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod) {
-    int n = (int)A.size(), m = (int)B.size();
+    size_t n = A.size(), m = B.size();
+    if (n == 0 || m == 0) return {};
     std::vector<u64> C(n + m - 1, 0);
-    for (int i = 0; i < n; ++i) {
-        for (int j = 0; j < m; ++j) {
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < m; ++j) {
             u128 t = (u128)A[i] * (u128)B[j] + (u128)C[i + j];
             C[i + j] = (u64)(t % mod);
         }
     }
     return C;
 }
+
+void poly_mul_negacyclic(const u64* A, const u64* B, u64* out, u64* tmp, const NttPlan& plan) {
+    const size_t n = plan.n;
+    std::copy(B, B + n, tmp);  // first, in case out aliases B
+    if (out != A) std::copy(A, A + n, out);
+    ntt_negacyclic(out, n, plan);
+    ntt_negacyclic(tmp, n, plan);
+    mul_mod_array(out, tmp, out, n, plan.mod);
+    intt_negacyclic(out, n, plan);
+}
+
+std::vector<u64> poly_mul_negacyclic(const std::vector<u64>& A, const std::vector<u64>& B, const NttPlan& plan) {
+    assert(A.size() == plan.n && B.size() == plan.n);
+    std::vector<u64> out(plan.n), tmp(plan.n);
+    poly_mul_negacyclic(A.data(), B.data(), out.data(), tmp.data(), plan);
+    return out;
+}
+
+// --- General multiplication: schoolbook / Karatsuba / NTT ---
+
+// Crossover points measured with bench/bench_poly_mul.cpp (equal-length
+// operands, 31- and 60-bit primes): Karatsuba and NTT convolution both tie
+// with schoolbook around 48 coefficients, and the NTT is ahead of Karatsuba
+// from 64 on, so Karatsuba only runs when the modulus has no usable plan.
+static const size_t KARATSUBA_BASE = 32;
+static const size_t SCHOOLBOOK_MAX = 48;
+
+// out[0 .. n+m-1) = a * b. Products are summed in a 128-bit accumulator and
+// reduced once per output, or every 'flush' terms when mod^2 terms could
+// overflow it.
+static void schoolbook(const u64* a, size_t n, const u64* b, size_t m, u64* out, u64 mod) {
+    u128 max_prod = (u128)(mod - 1) * (mod - 1);
+    u128 flush128 = max_prod ? ~(u128)0 / max_prod : ~(u128)0;
+    size_t flush = flush128 > (u128)(n + m) ? n + m : (size_t)flush128;
+    for (size_t k = 0; k < n + m - 1; ++k) {
+        size_t lo = k >= m ? k - m + 1 : 0;
+        size_t hi = k < n ? k : n - 1;
+        u128 acc = 0;
+        size_t cnt = 0;
+        for (size_t i = lo; i <= hi; ++i) {
+            acc += (u128)a[i] * b[k - i];
+            if (++cnt == flush) {
+                acc %= mod;
+                cnt = 1;
+            }
+        }
+        out[k] = (u64)(acc % mod);
+    }
+}
+
+static size_t karatsuba_scratch(size_t len) {
+    if (len <= KARATSUBA_BASE) return 0;
+    size_t hl = len - len / 2;
+    return 4 * hl + karatsuba_scratch(hl);
+}
+
+// out[0 .. 2*len-1) = a * b for two operands of length len.
+static void karatsuba(const u64* a, const u64* b, size_t len, u64* out, u64 mod, u64* scratch) {
+    if (len <= KARATSUBA_BASE) {
+        schoolbook(a, len, b, len, out, mod);
+        return;
+    }
+    size_t h = len / 2;      // low half
+    size_t hl = len - h;     // high half, hl >= h
+    // z0 = a0*b0 in out[0, 2h-1), z2 = a1*b1 in out[2h, 2len-1)
+    karatsuba(a, b, h, out, mod, scratch);
+    out[2 * h - 1] = 0;
+    karatsuba(a + h, b + h, hl, out + 2 * h, mod, scratch);
+
+    // z1 = (a0 + a1)(b0 + b1) - z0 - z2
+    u64* sa = scratch;
+    u64* sb = scratch + hl;
+    u64* z1 = scratch + 2 * hl;  // 2*hl - 1 words
+    for (size_t i = 0; i < hl; ++i) {
+        u64 x = (i < h ? a[i] : 0) + a[h + i];
+        u64 y = (i < h ? b[i] : 0) + b[h + i];
+        sa[i] = x >= mod ? x - mod : x;
+        sb[i] = y >= mod ? y - mod : y;
+    }
+    karatsuba(sa, sb, hl, z1, mod, scratch + 4 * hl);
+    // finish z1 before adding it in: out[h..] overlaps both z0 and z2
+    for (size_t i = 0; i < 2 * hl - 1; ++i) {
+        u64 z0 = i < 2 * h - 1 ? out[i] : 0;
+        u64 z2 = out[2 * h + i];
+        u64 s = z0 + z2;
+        if (s >= mod) s -= mod;
+        z1[i] = z1[i] >= s ? z1[i] - s : z1[i] + mod - s;
+    }
+    for (size_t i = 0; i < 2 * hl - 1; ++i) {
+        u64 r = out[h + i] + z1[i];
+        out[h + i] = r >= mod ? r - mod : r;
+    }
+}
+
+std::vector<u64> poly_mul_schoolbook(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod) {
+    if (A.empty() || B.empty()) return {};
+    std::vector<u64> C(A.size() + B.size() - 1);
+    schoolbook(A.data(), A.size(), B.data(), B.size(), C.data(), mod);
+    return C;
+}
+
+std::vector<u64> poly_mul_karatsuba(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod) {
+    if (A.empty() || B.empty()) return {};
+    // the longer operand is cut into chunks as long as the shorter one
+    const std::vector<u64>& L = A.size() >= B.size() ? A : B;
+    const std::vector<u64>& S = A.size() >= B.size() ? B : A;
+    size_t n = L.size(), m = S.size();
+    std::vector<u64> C(n + m - 1, 0);
+    std::vector<u64> chunk(m), prod(2 * m - 1), scratch(karatsuba_scratch(m));
+    for (size_t off = 0; off < n; off += m) {
+        size_t len = n - off < m ? n - off : m;
+        for (size_t i = 0; i < m; ++i) chunk[i] = i < len ? L[off + i] : 0;
+        karatsuba(chunk.data(), S.data(), m, prod.data(), mod, scratch.data());
+        size_t used = len + m - 1;
+        for (size_t i = 0; i < used; ++i) {
+            u64 r = C[off + i] + prod[i];
+            C[off + i] = r >= mod ? r - mod : r;
+        }
+    }
+    return C;
+}
+
+std::vector<u64> poly_mul_ntt(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod) {
+    if (A.empty() || B.empty()) return {};
+    size_t out_len = A.size() + B.size() - 1;
+    size_t N = 2;
+    while (N < out_len) N <<= 1;
+    const NttPlan* plan = cached_plan(N, mod);
+    if (!plan) return poly_mul_karatsuba(A, B, mod);
+    if (plan->narrow) {
+        // 32-bit storage: half the traffic and twice the SIMD lanes
+        std::vector<u32> fa(N, 0), fb(N, 0);
+        std::copy(A.begin(), A.end(), fa.begin());
+        std::copy(B.begin(), B.end(), fb.begin());
+        ntt_to_bitrev(fa, *plan);
+        ntt_to_bitrev(fb, *plan);
+        mul_mod_array(fa.data(), fb.data(), fa.data(), N, (u32)plan->mod);
+        intt_from_bitrev(fa, *plan);
+        return std::vector<u64>(fa.begin(), fa.begin() + out_len);
+    }
+    std::vector<u64> fa(N, 0), fb(N, 0);
+    std::copy(A.begin(), A.end(), fa.begin());
+    std::copy(B.begin(), B.end(), fb.begin());
+    // evaluation order is irrelevant to the pointwise product: no permutes
+    ntt_to_bitrev(fa, *plan);
+    ntt_to_bitrev(fb, *plan);
+    mul_mod_array(fa.data(), fb.data(), fa.data(), N, plan->mod);
+    intt_from_bitrev(fa, *plan);
+    fa.resize(out_len);
+    return fa;
+}
+
+std::vector<u64> poly_mul(const std::vector<u64>& A, const std::vector<u64>& B, u64 mod) {
+    size_t m = A.size() < B.size() ? A.size() : B.size();
+    if (m < SCHOOLBOOK_MAX) return poly_mul_schoolbook(A, B, mod);
+    return poly_mul_ntt(A, B, mod);
+}
@@ -0,0 +1,63 @@
+#include "poly_arena.h"
+#include <cstdlib>
+#include <new>
+
+static const size_t LINE_WORDS = 64 / sizeof(u64);
+
+static inline size_t round_words(size_t words) {
+    size_t w = (words + LINE_WORDS - 1) / LINE_WORDS * LINE_WORDS;
+    return w ? w : LINE_WORDS;
+}
+
+PolyArena::PolyArena(size_t slab_words) : slab_words_(round_words(slab_words)) {}
+
+PolyArena::~PolyArena() {
+    for (u64* s : slabs_) std::free(s);
+}
+
+u64* PolyArena::new_slab(size_t words) {
+    u64* s = static_cast<u64*>(std::aligned_alloc(64, words * sizeof(u64)));
+    if (!s) throw std::bad_alloc();
+    slabs_.push_back(s);
+    reserved_words_ += words;
+    return s;
+}
+
+u64* PolyArena::acquire(size_t words) {
+    const size_t w = round_words(words);
+    for (auto& f : free_) {
+        if (f.words == w && f.head) {
+            u64* p = f.head;
+            f.head = reinterpret_cast<u64*>(static_cast<uintptr_t>(p[0]));
+            return p;
+        }
+    }
+    if (w > slab_words_) {
+        // a slab of its own; the current slab keeps serving smaller requests
+        return new_slab(w);
+    }
+    if (w > left_) {
+        // the tail of the current slab is abandoned; it is smaller than this
+        // request, so with polynomial-sized classes at most one buffer
+        cur_ = new_slab(slab_words_);
+        left_ = slab_words_;
+    }
+    u64* p = cur_;
+    cur_ += w;
+    left_ -= w;
+    return p;
+}
+
+void PolyArena::release(u64* p, size_t words) {
+    if (!p) return;
+    const size_t w = round_words(words);
+    for (auto& f : free_) {
+        if (f.words == w) {
+            p[0] = static_cast<u64>(reinterpret_cast<uintptr_t>(f.head));
+            f.head = p;
+            return;
+        }
+    }
+    p[0] = 0;
+    free_.push_back({w, p});
+}
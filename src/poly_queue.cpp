@@ -0,0 +1,201 @@
+#include "poly_queue.h"
+#include "ntt.h"
+#include "ntt_batch.h"
+#include "mod_arith.h"
+#include <algorithm>
+#include <cassert>
+#include <exception>
+
+using u64 = uint64_t;
+
+// How far into the ready queue a transform looks for batch partners; keeps
+// the scan under the lock short when the queue is long.
+static const size_t BATCH_SCAN = 64;
+
+PolyQueue::PolyQueue(size_t workers, size_t max_pending, size_t max_batch)
+    : max_pending_(max_pending ? max_pending : 1), max_batch_(max_batch ? max_batch : 1) {
+    if (workers == 0) workers = std::thread::hardware_concurrency();
+    if (workers == 0) workers = 1;
+    workers_.reserve(workers);
+    for (size_t i = 0; i < workers; ++i) workers_.emplace_back(&PolyQueue::worker_loop, this);
+}
+
+PolyQueue::~PolyQueue() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+    }
+    work_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+static void check_job(const aligned_vector<u64>& data, const NttPlan& plan, const std::vector<PolyStep>& steps) {
+    (void)data;
+    (void)plan;
+    assert(data.size() == plan.n && plan.has_negacyclic());
+    for (const PolyStep& s : steps) {
+        (void)s;
+        assert(s.kind <= STEP_SUB);
+        assert(s.kind <= STEP_INTT || (s.operand && s.operand->size() == plan.n));
+    }
+}
+
+// Called with mutex_ held and a slot free: takes the slot and queues.
+PolyFuture PolyQueue::enqueue(aligned_vector<u64>& data, const NttPlan& plan, std::vector<PolyStep>& steps) {
+    std::unique_ptr<Job> job(new Job);
+    job->data = std::move(data);
+    job->plan = &plan;
+    job->steps = std::move(steps);
+    PolyFuture f = job->done.get_future();
+    ++in_flight_;
+    ready_.push_back(std::move(job));
+    return f;
+}
+
+PolyFuture PolyQueue::submit(aligned_vector<u64> data, const NttPlan& plan, std::vector<PolyStep> steps) {
+    check_job(data, plan, steps);
+    if (steps.empty()) {
+        std::promise<aligned_vector<u64>> p;
+        p.set_value(std::move(data));
+        return p.get_future();
+    }
+    PolyFuture f;
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        space_.wait(lk, [&] { return in_flight_ < max_pending_; });
+        f = enqueue(data, plan, steps);
+    }
+    work_.notify_one();
+    return f;
+}
+
+bool PolyQueue::try_submit(aligned_vector<u64>& data, const NttPlan& plan, std::vector<PolyStep>& steps, PolyFuture& out) {
+    check_job(data, plan, steps);
+    if (steps.empty()) {
+        out = submit(std::move(data), plan, std::move(steps));
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (in_flight_ >= max_pending_) return false;
+        out = enqueue(data, plan, steps);
+    }
+    work_.notify_one();
+    return true;
+}
+
+void PolyQueue::wait_idle() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    idle_.wait(lk, [&] { return in_flight_ == 0; });
+}
+
+size_t PolyQueue::pending() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return in_flight_;
+}
+
+// Runs the (common) next step of every job in 'batch'.
+void PolyQueue::run_step(std::vector<std::unique_ptr<Job>>& batch, aligned_vector<u64>& scratch) {
+    const NttPlan& plan = *batch[0]->plan;
+    const size_t n = plan.n;
+    const PolyStep& s0 = batch[0]->steps[batch[0]->next];
+    if (s0.kind == STEP_NTT || s0.kind == STEP_INTT) {
+        const bool fwd = s0.kind == STEP_NTT;
+        const size_t count = batch.size();
+        size_t done = 0;
+        if (plan.batch_interleave_min && count >= plan.batch_interleave_min) {
+            // whole groups, interleaved straight from and back into the job
+            // buffers through the worker's scratch
+            const size_t L = NTT_BATCH_LANES;
+            done = count / L * L;
+            scratch.resize(done * n);
+            for (size_t g = 0; g < done; g += L) {
+                u64* lanes[NTT_BATCH_LANES];
+                for (size_t l = 0; l < L; ++l) lanes[l] = batch[g + l]->data.data();
+                batch_interleave(lanes, L, n, scratch.data() + g * n);
+            }
+            if (fwd) ntt_negacyclic_interleaved(scratch.data(), done / L, plan);
+            else intt_negacyclic_interleaved(scratch.data(), done / L, plan);
+            for (size_t g = 0; g < done; g += L) {
+                u64* lanes[NTT_BATCH_LANES];
+                for (size_t l = 0; l < L; ++l) lanes[l] = batch[g + l]->data.data();
+                batch_deinterleave(scratch.data() + g * n, L, n, lanes);
+            }
+        }
+        for (size_t i = done; i < count; ++i) {
+            if (fwd) ntt_negacyclic(batch[i]->data.data(), n, plan);
+            else intt_negacyclic(batch[i]->data.data(), n, plan);
+        }
+        return;
+    }
+    for (auto& job : batch) {
+        const PolyStep& s = job->steps[job->next];
+        u64* a = job->data.data();
+        const u64* b = s.operand->data();
+        if (s.kind == STEP_MUL) mul_mod_array(a, b, a, n, plan.mod);
+        else if (s.kind == STEP_ADD) add_mod_array(a, b, a, n, plan.mod);
+        else sub_mod_array(a, b, a, n, plan.mod);
+    }
+}
+
+void PolyQueue::worker_loop() {
+    std::vector<std::unique_ptr<Job>> batch;
+    aligned_vector<u64> scratch;
+    std::unique_lock<std::mutex> lk(mutex_);
+    for (;;) {
+        work_.wait(lk, [&] { return stop_ || !ready_.empty(); });
+        if (ready_.empty()) return;  // stopping, and everything has run
+
+        // the front job, plus ready jobs at the same transform on the same plan
+        batch.clear();
+        batch.push_back(std::move(ready_.front()));
+        ready_.pop_front();
+        const Job& j0 = *batch[0];
+        const PolyStepKind kind = j0.steps[j0.next].kind;
+        if (kind == STEP_NTT || kind == STEP_INTT) {
+            const size_t scan = std::min(ready_.size(), BATCH_SCAN);
+            for (size_t i = 0, seen = 0; seen < scan && batch.size() < max_batch_; ++seen) {
+                Job& j = *ready_[i];
+                if (j.plan == j0.plan && j.steps[j.next].kind == kind) {
+                    batch.push_back(std::move(ready_[i]));
+                    ready_.erase(ready_.begin() + i);
+                } else {
+                    ++i;
+                }
+            }
+        }
+        lk.unlock();
+
+        // a step that throws (e.g. bad_alloc growing 'scratch') fails every
+        // job in the batch instead of the worker
+        std::exception_ptr failed;
+        try {
+            run_step(batch, scratch);
+        } catch (...) {
+            failed = std::current_exception();
+        }
+
+        // results out before the job stops counting, so wait_idle implies
+        // every future is ready
+        size_t done = 0, again = 0;
+        for (auto& job : batch) {
+            if (failed) job->done.set_exception(failed);
+            else if (++job->next < job->steps.size()) continue;
+            else job->done.set_value(std::move(job->data));
+            job.reset();
+            ++done;
+        }
+        lk.lock();
+        // unfinished jobs go back to the front, in their original order
+        for (size_t i = batch.size(); i-- > 0;) {
+            if (!batch[i]) continue;
+            ready_.push_front(std::move(batch[i]));
+            ++again;
+        }
+        in_flight_ -= done;
+        if (done) space_.notify_all();
+        if (in_flight_ == 0) idle_.notify_all();
+        // this worker takes one of them itself
+        if (again > 1) work_.notify_all();
+    }
+}
@@ -0,0 +1,194 @@
+#include "profile.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#if HE_PROFILE && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HE_PROFILE_PERF 1
+#endif
+
+using u64 = uint64_t;
+
+#if HE_PROFILE
+
+static const char* const stage_names[PROF_LAYER_0] = {
+    "ntt", "intt", "ntt_montgomery", "ntt_to_bitrev", "intt_from_bitrev", "ntt_negacyclic", "intt_negacyclic",
+    "bit_reverse", "to_mont", "from_mont", "butterflies", "final_reduce", "scale",
+};
+
+static const char* stage_name(unsigned s) {
+    static char layer_names[PROF_MAX_LAYERS][12];
+    static const bool filled = [] {
+        for (unsigned k = 0; k < PROF_MAX_LAYERS; ++k) snprintf(layer_names[k], sizeof layer_names[k], "layer %u", k);
+        return true;
+    }();
+    (void)filled;
+    return s < PROF_LAYER_0 ? stage_names[s] : layer_names[s - PROF_LAYER_0];
+}
+
+// Totals per stage, shared by all threads.
+struct StageTotals {
+    std::atomic<u64> calls{0}, ns{0}, cycles{0}, instructions{0}, cache_misses{0};
+};
+static StageTotals totals[PROF_STAGE_COUNT];
+
+static std::atomic<bool> counters_on{[] {
+    const char* e = getenv("HE_PROFILE_COUNTERS");
+    return e && *e && strcmp(e, "0") != 0;
+}()};
+
+static u64 now_ns() {
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if HE_PROFILE_PERF
+// One counter group per thread (cycles leads, instructions and cache misses
+// follow), opened on the thread's first counted probe and read as a group.
+struct PerfGroup {
+    int fd[3] = {-1, -1, -1};
+    bool tried = false;
+
+    bool open() {
+        tried = true;
+        const u64 configs[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+        for (int k = 0; k < 3; ++k) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof attr);
+            attr.size = sizeof attr;
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[k];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.disabled = k == 0;
+            fd[k] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, k == 0 ? -1 : fd[0], 0);
+            if (fd[k] < 0) {
+                close_all();
+                return false;
+            }
+        }
+        ioctl(fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+    }
+
+    void close_all() {
+        for (int& f : fd) {
+            if (f >= 0) ::close(f);
+            f = -1;
+        }
+    }
+
+    bool ready() {
+        if (!tried) open();
+        return fd[0] >= 0;
+    }
+
+    bool read(u64 out[3]) {
+        u64 buf[4];  // nr, then one value per event
+        if (::read(fd[0], buf, sizeof buf) != (ssize_t)sizeof buf || buf[0] != 3) return false;
+        memcpy(out, buf + 1, 3 * sizeof(u64));
+        return true;
+    }
+
+    ~PerfGroup() { close_all(); }
+};
+
+static thread_local PerfGroup perf;
+#endif
+
+ProfScope::ProfScope(unsigned stage) : stage_(stage), counted_(false) {
+#if HE_PROFILE_PERF
+    if (counters_on.load(std::memory_order_relaxed) && perf.ready()) counted_ = perf.read(c0_);
+#endif
+    t0_ = now_ns();
+}
+
+ProfScope::~ProfScope() {
+    const u64 t1 = now_ns();
+    StageTotals& s = totals[stage_];
+    s.calls.fetch_add(1, std::memory_order_relaxed);
+    s.ns.fetch_add(t1 - t0_, std::memory_order_relaxed);
+#if HE_PROFILE_PERF
+    u64 c1[3];
+    if (counted_ && perf.read(c1)) {
+        s.cycles.fetch_add(c1[0] - c0_[0], std::memory_order_relaxed);
+        s.instructions.fetch_add(c1[1] - c0_[1], std::memory_order_relaxed);
+        s.cache_misses.fetch_add(c1[2] - c0_[2], std::memory_order_relaxed);
+    }
+#endif
+}
+
+bool profile_compiled_in() { return true; }
+
+std::vector<ProfileStats> profile_stats() {
+    std::vector<ProfileStats> out;
+    for (unsigned k = 0; k < PROF_STAGE_COUNT; ++k) {
+        const StageTotals& s = totals[k];
+        ProfileStats r;
+        r.stage = stage_name(k);
+        r.calls = s.calls.load(std::memory_order_relaxed);
+        if (!r.calls) continue;
+        r.ns = s.ns.load(std::memory_order_relaxed);
+        r.cycles = s.cycles.load(std::memory_order_relaxed);
+        r.instructions = s.instructions.load(std::memory_order_relaxed);
+        r.cache_misses = s.cache_misses.load(std::memory_order_relaxed);
+        out.push_back(r);
+    }
+    return out;
+}
+
+void profile_reset() {
+    for (StageTotals& s : totals) {
+        s.calls.store(0, std::memory_order_relaxed);
+        s.ns.store(0, std::memory_order_relaxed);
+        s.cycles.store(0, std::memory_order_relaxed);
+        s.instructions.store(0, std::memory_order_relaxed);
+        s.cache_misses.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool profile_set_counters(bool on) {
+#if HE_PROFILE_PERF
+    // probe on this thread so the answer reflects what the kernel allows
+    if (on && !perf.ready()) on = false;
+#else
+    on = false;
+#endif
+    counters_on.store(on, std::memory_order_relaxed);
+    return on;
+}
+
+#else
+
+bool profile_compiled_in() { return false; }
+std::vector<ProfileStats> profile_stats() { return {}; }
+void profile_reset() {}
+bool profile_set_counters(bool) { return false; }
+
+#endif
+
+void profile_dump(FILE* out) {
+    std::vector<ProfileStats> st = profile_stats();
+    if (!profile_compiled_in()) {
+        fprintf(out, "profile: not compiled in (build with HE_PROFILE=1)\n");
+        return;
+    }
+    fprintf(out, "%-18s %10s %14s %12s %12s %10s %12s\n", "stage", "calls", "total us", "ns/call", "cycles/call",
+            "IPC", "misses/call");
+    for (const ProfileStats& s : st) {
+        double c = (double)s.calls;
+        fprintf(out, "%-18s %10llu %14.1f %12.1f", s.stage, (unsigned long long)s.calls, s.ns / 1e3, s.ns / c);
+        if (s.cycles) {
+            fprintf(out, " %12.1f %10.2f %12.1f\n", s.cycles / c, (double)s.instructions / s.cycles,
+                    s.cache_misses / c);
+        } else {
+            fprintf(out, " %12s %10s %12s\n", "-", "-", "-");
+        }
+    }
+}
@@ -0,0 +1,450 @@
+#include "rns.h"
+#include "ntt.h"
+#include "ntt_parallel.h"
+#include "ntt_fixed.h"
+#include "shoup.h"
+#include "mod_arith.h"
+#include "galois.h"
+#include "plan_cache.h"
+#include <algorithm>
+#include <cassert>
+
+using u64 = uint64_t;
+using u128 = __uint128_t;
+
+static u64 mod_pow(u64 a, u64 e, u64 mod) {
+    u128 res = 1;
+    u128 base = a % mod;
+    while (e) {
+        if (e & 1) res = (res * base) % mod;
+        base = (base * base) % mod;
+        e >>= 1;
+    }
+    return (u64)res;
+}
+
+// --- multi-word helpers (little-endian 64-bit words) ---
+
+// acc[0..words] += x[0..words) * y; acc has words + 1 words
+static void mw_mul_word_add(u64* acc, const u64* x, size_t words, u64 y) {
+    u64 carry = 0;
+    for (size_t k = 0; k < words; ++k) {
+        u128 t = (u128)x[k] * y + acc[k] + carry;
+        acc[k] = (u64)t;
+        carry = (u64)(t >> 64);
+    }
+    acc[words] += carry;
+}
+
+// a >= b over 'words' words
+static bool mw_geq(const u64* a, const u64* b, size_t words) {
+    for (size_t k = words; k-- > 0;) {
+        if (a[k] != b[k]) return a[k] > b[k];
+    }
+    return true;
+}
+
+// a -= b over 'words' words (a >= b)
+static void mw_sub(u64* a, const u64* b, size_t words) {
+    u64 borrow = 0;
+    for (size_t k = 0; k < words; ++k) {
+        u64 bk = b[k] + borrow;
+        borrow = (bk < borrow) || (a[k] < bk);
+        a[k] -= bk;
+    }
+}
+
+// x *= y, growing x by a word when needed
+static void mw_mul_word(std::vector<u64>& x, u64 y) {
+    u64 carry = 0;
+    for (auto& w : x) {
+        u128 t = (u128)w * y + carry;
+        w = (u64)t;
+        carry = (u64)(t >> 64);
+    }
+    if (carry) x.push_back(carry);
+}
+
+RnsBase::RnsBase(size_t n_, const std::vector<u64>& moduli_) {
+    init(n_, moduli_);
+}
+
+void RnsBase::init(size_t n_, const std::vector<u64>& moduli_) {
+    n = n_;
+    moduli = moduli_;
+    size_t L = moduli.size();
+    assert(L > 0);
+    plans.clear();
+    plans.reserve(L);
+    fixed.clear();
+    for (u64 q : moduli) {
+        // a cached plan (e.g. preloaded from a plan file) saves the table build
+        if (const NttPlan* p = plan_cache_find(n, q)) plans.push_back(*p);
+        else plans.emplace_back(n, q);
+        assert(plans.back().has_negacyclic());
+        fixed.push_back(find_fixed_ntt(n, q));
+    }
+
+    std::vector<u64> prod{1};
+    for (u64 q : moduli) mw_mul_word(prod, q);
+    words = prod.size();
+    Q = prod;
+
+    qhat.assign(L * words, 0);
+    qhat_inv.assign(L, 0);
+    qhat_inv_shoup.assign(L, 0);
+    word_pow.assign(L * words, 0);
+    word_pow_shoup.assign(L * words, 0);
+    for (size_t i = 0; i < L; ++i) {
+        u64 qi = moduli[i];
+        std::vector<u64> h{1};
+        u64 h_mod = 1;
+        for (size_t j = 0; j < L; ++j) {
+            if (j == i) continue;
+            mw_mul_word(h, moduli[j]);
+            h_mod = (u128)h_mod * (moduli[j] % qi) % qi;
+        }
+        for (size_t k = 0; k < h.size(); ++k) qhat[i * words + k] = h[k];
+        qhat_inv[i] = mod_pow(h_mod, qi - 2, qi);
+        qhat_inv_shoup[i] = shoup_precompute(qhat_inv[i], qi);
+
+        u64 r64 = (u64)(((u128)1 << 64) % qi);
+        u64 p = 1;
+        for (size_t k = 0; k < words; ++k) {
+            word_pow[i * words + k] = p;
+            word_pow_shoup[i * words + k] = shoup_precompute(p, qi);
+            p = (u128)p * r64 % qi;
+        }
+    }
+}
+
+RnsPoly::RnsPoly(const RnsBase& b) : base(&b), data(b.size() * b.n, 0) {}
+
+// Transforms of one limb's n words x modulo q_i.
+static void limb_ntt(const RnsBase& B, size_t i, u64* x) {
+    if (B.fixed[i]) B.fixed[i]->forward(x);
+    else ntt_negacyclic(x, B.n, B.plans[i]);
+}
+
+static void limb_intt(const RnsBase& B, size_t i, u64* x) {
+    if (B.fixed[i]) B.fixed[i]->inverse(x);
+    else intt_negacyclic(x, B.n, B.plans[i]);
+}
+
+void rns_ntt(const RnsBase& B, u64* data) {
+    for (size_t i = 0; i < B.size(); ++i) limb_ntt(B, i, data + i * B.n);
+}
+
+void rns_intt(const RnsBase& B, u64* data) {
+    for (size_t i = 0; i < B.size(); ++i) limb_intt(B, i, data + i * B.n);
+}
+
+void rns_ntt(const RnsBase& B, u64* data, ThreadPool& pool) {
+    if (B.size() >= pool.size()) {
+        pool.parallel_for(B.size(), [&](size_t i) { limb_ntt(B, i, data + i * B.n); });
+    } else {
+        for (size_t i = 0; i < B.size(); ++i) ntt_negacyclic(data + i * B.n, B.n, B.plans[i], pool);
+    }
+}
+
+void rns_intt(const RnsBase& B, u64* data, ThreadPool& pool) {
+    if (B.size() >= pool.size()) {
+        pool.parallel_for(B.size(), [&](size_t i) { limb_intt(B, i, data + i * B.n); });
+    } else {
+        for (size_t i = 0; i < B.size(); ++i) intt_negacyclic(data + i * B.n, B.n, B.plans[i], pool);
+    }
+}
+
+void rns_add(const RnsBase& B, const u64* a, const u64* b, u64* out) {
+    for (size_t i = 0; i < B.size(); ++i) add_mod_array(a + i * B.n, b + i * B.n, out + i * B.n, B.n, B.moduli[i]);
+}
+
+void rns_sub(const RnsBase& B, const u64* a, const u64* b, u64* out) {
+    for (size_t i = 0; i < B.size(); ++i) sub_mod_array(a + i * B.n, b + i * B.n, out + i * B.n, B.n, B.moduli[i]);
+}
+
+void rns_negate(const RnsBase& B, const u64* a, u64* out) {
+    for (size_t i = 0; i < B.size(); ++i) negate_mod_array(a + i * B.n, out + i * B.n, B.n, B.moduli[i]);
+}
+
+void rns_mul(const RnsBase& B, const u64* a, const u64* b, u64* out) {
+    for (size_t i = 0; i < B.size(); ++i) mul_mod_array(a + i * B.n, b + i * B.n, out + i * B.n, B.n, B.moduli[i]);
+}
+
+void rns_multiply(const RnsBase& B, const u64* a, const u64* b, u64* out, u64* tmp) {
+    const size_t words = B.size() * B.n;
+    std::copy(b, b + words, tmp);  // first, in case out aliases b
+    if (out != a) std::copy(a, a + words, out);
+    rns_ntt(B, out);
+    rns_ntt(B, tmp);
+    rns_mul(B, out, tmp, out);
+    rns_intt(B, out);
+}
+
+// --- fused products ---
+
+// z mod q for any 128-bit z: z = hi * 2^64 + lo, with hi scaled by
+// 2^64 mod q and lo by 1, both as Shoup products (which accept any 64-bit
+// operand). Two lazy results sum below 4q.
+struct WideReducer {
+    u64 q, r64, r64_shoup, one_shoup;
+
+    explicit WideReducer(u64 mod)
+        : q(mod),
+          r64((u64)(((u128)1 << 64) % mod)),
+          r64_shoup(shoup_precompute(r64, mod)),
+          one_shoup(shoup_precompute(1, mod)) {}
+
+    u64 reduce(u64 hi, u64 lo) const {
+        u64 r = shoup_mul_lazy(hi, r64, r64_shoup, q) + shoup_mul_lazy(lo, 1, one_shoup, q);
+        if (r >= 2 * q) r -= 2 * q;
+        return r >= q ? r - q : r;
+    }
+};
+
+// Products of residues are below q^2 < 2^124, so a 128-bit accumulator holds
+// a residue plus 15 of them; longer sums fold back to a residue in between.
+static const size_t FUSED_FOLD = 15;
+
+// (hi, lo) += x * y over n lanes
+static void mac_wide(const u64* x, const u64* y, u64* hi, u64* lo, size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        u128 t = ((u128)hi[j] << 64 | lo[j]) + (u128)x[j] * y[j];
+        hi[j] = (u64)(t >> 64);
+        lo[j] = (u64)t;
+    }
+}
+
+void rns_inner_product(const RnsBase& B, const u64* const* a, const u64* const* b, size_t count,
+                       bool ntt_form, u64* out, u64* scratch) {
+    const size_t n = B.n;
+    u64* ta = scratch;
+    u64* tb = scratch + n;
+    u64* hi = scratch + 2 * n;
+    u64* lo = scratch + 3 * n;
+    for (size_t i = 0; i < B.size(); ++i) {
+        WideReducer R(B.moduli[i]);
+        std::fill(hi, hi + n, 0);
+        std::fill(lo, lo + n, 0);
+        for (size_t k = 0; k < count; ++k) {
+            const u64* x = a[k] + i * n;
+            const u64* y = b[k] + i * n;
+            if (!ntt_form) {
+                // transform this pair while the accumulators stay in cache
+                std::copy(x, x + n, ta);
+                std::copy(y, y + n, tb);
+                limb_ntt(B, i, ta);
+                limb_ntt(B, i, tb);
+                x = ta;
+                y = tb;
+            }
+            mac_wide(x, y, hi, lo, n);
+            if ((k + 1) % FUSED_FOLD == 0 && k + 1 < count) {
+                for (size_t j = 0; j < n; ++j) {
+                    lo[j] = R.reduce(hi[j], lo[j]);
+                    hi[j] = 0;
+                }
+            }
+        }
+        u64* z = out + i * n;
+        for (size_t j = 0; j < n; ++j) z[j] = R.reduce(hi[j], lo[j]);
+        if (!ntt_form) limb_intt(B, i, z);
+    }
+}
+
+void rns_tensor(const RnsBase& B, const u64* a0, const u64* a1, const u64* b0, const u64* b1,
+                bool ntt_form, u64* c0, u64* c1, u64* c2, u64* scratch) {
+    const size_t n = B.n;
+    for (size_t i = 0; i < B.size(); ++i) {
+        const size_t off = i * n;
+        const u64* x0 = a0 + off;
+        const u64* x1 = a1 + off;
+        const u64* y0 = b0 + off;
+        const u64* y1 = b1 + off;
+        if (!ntt_form) {
+            u64* t = scratch;
+            std::copy(x0, x0 + n, t);
+            std::copy(x1, x1 + n, t + n);
+            std::copy(y0, y0 + n, t + 2 * n);
+            std::copy(y1, y1 + n, t + 3 * n);
+            for (size_t k = 0; k < 4; ++k) limb_ntt(B, i, t + k * n);
+            x0 = t;
+            x1 = t + n;
+            y0 = t + 2 * n;
+            y1 = t + 3 * n;
+        }
+        // one pass over the four operands writes all three components; the
+        // cross term is a two-product 128-bit sum reduced once
+        WideReducer R(B.moduli[i]);
+        u64* z0 = c0 + off;
+        u64* z1 = c1 + off;
+        u64* z2 = c2 + off;
+        for (size_t j = 0; j < n; ++j) {
+            u128 d0 = (u128)x0[j] * y0[j];
+            u128 d1 = (u128)x0[j] * y1[j] + (u128)x1[j] * y0[j];
+            u128 d2 = (u128)x1[j] * y1[j];
+            z0[j] = R.reduce((u64)(d0 >> 64), (u64)d0);
+            z1[j] = R.reduce((u64)(d1 >> 64), (u64)d1);
+            z2[j] = R.reduce((u64)(d2 >> 64), (u64)d2);
+        }
+        if (!ntt_form) {
+            limb_intt(B, i, z0);
+            limb_intt(B, i, z1);
+            limb_intt(B, i, z2);
+        }
+    }
+}
+
+// RnsPoly forms: thin wrappers that also track ntt_form.
+
+void rns_automorphism(const RnsBase& B, u64* data, bool ntt_form, size_t k) {
+    for (size_t i = 0; i < B.size(); ++i) {
+        u64* x = data + i * B.n;
+        if (ntt_form) automorphism_ntt(x, B.n, k);
+        else automorphism_coeff(x, B.n, k, B.moduli[i]);
+    }
+}
+
+void rns_automorphism(const RnsBase& B, const u64* in, bool ntt_form, size_t k, u64* out) {
+    for (size_t i = 0; i < B.size(); ++i) {
+        const u64* x = in + i * B.n;
+        u64* y = out + i * B.n;
+        if (ntt_form) automorphism_ntt(x, y, B.n, k);
+        else automorphism_coeff(x, y, B.n, k, B.moduli[i]);
+    }
+}
+
+void rns_ntt(RnsPoly& a) {
+    rns_ntt(*a.base, a.data.data());
+    a.ntt_form = true;
+}
+
+void rns_intt(RnsPoly& a) {
+    rns_intt(*a.base, a.data.data());
+    a.ntt_form = false;
+}
+
+void rns_ntt(RnsPoly& a, ThreadPool& pool) {
+    rns_ntt(*a.base, a.data.data(), pool);
+    a.ntt_form = true;
+}
+
+void rns_intt(RnsPoly& a, ThreadPool& pool) {
+    rns_intt(*a.base, a.data.data(), pool);
+    a.ntt_form = false;
+}
+
+void rns_add(const RnsPoly& a, const RnsPoly& b, RnsPoly& out) {
+    assert(b.base == a.base && out.base == a.base);
+    rns_add(*a.base, a.data.data(), b.data.data(), out.data.data());
+    out.ntt_form = a.ntt_form;
+}
+
+void rns_sub(const RnsPoly& a, const RnsPoly& b, RnsPoly& out) {
+    assert(b.base == a.base && out.base == a.base);
+    rns_sub(*a.base, a.data.data(), b.data.data(), out.data.data());
+    out.ntt_form = a.ntt_form;
+}
+
+void rns_negate(const RnsPoly& a, RnsPoly& out) {
+    assert(out.base == a.base);
+    rns_negate(*a.base, a.data.data(), out.data.data());
+    out.ntt_form = a.ntt_form;
+}
+
+void rns_mul(const RnsPoly& a, const RnsPoly& b, RnsPoly& out) {
+    assert(b.base == a.base && out.base == a.base);
+    assert(a.ntt_form && b.ntt_form);
+    rns_mul(*a.base, a.data.data(), b.data.data(), out.data.data());
+    out.ntt_form = true;
+}
+
+void rns_multiply(const RnsPoly& a, const RnsPoly& b, RnsPoly& out) {
+    assert(!a.ntt_form && !b.ntt_form);
+    const RnsBase& B = *a.base;
+    aligned_vector<u64> tmp(B.size() * B.n);
+    out.base = a.base;
+    out.data.resize(B.size() * B.n);
+    rns_multiply(B, a.data.data(), b.data.data(), out.data.data(), tmp.data());
+    out.ntt_form = false;
+}
+
+void rns_automorphism(RnsPoly& a, size_t k) {
+    rns_automorphism(*a.base, a.data.data(), a.ntt_form, k);
+}
+
+void rns_decompose(const u64* in, size_t in_words, RnsPoly& out) {
+    const RnsBase& B = *out.base;
+    assert(in_words <= B.words);
+    for (size_t i = 0; i < B.size(); ++i) {
+        u64 q = B.moduli[i];
+        const u64* wp = B.word_pow.data() + i * B.words;
+        const u64* wps = B.word_pow_shoup.data() + i * B.words;
+        u64* z = out.limb(i);
+        for (size_t j = 0; j < B.n; ++j) {
+            // sum_k in[k] * (2^{64k} mod q), one Shoup product per word
+            const u64* x = in + j * in_words;
+            u64 s = 0;
+            for (size_t k = 0; k < in_words; ++k) {
+                s += shoup_mul(x[k], wp[k], wps[k], q);
+                if (s >= q) s -= q;
+            }
+            z[j] = s;
+        }
+    }
+    out.ntt_form = false;
+}
+
+void rns_compose(const RnsPoly& in, std::vector<u64>& out) {
+    const RnsBase& B = *in.base;
+    assert(!in.ntt_form);
+    const size_t W = B.words;
+    out.assign(B.n * W, 0);
+    std::vector<u64> acc(W + 1);
+    std::vector<u64> Qx(B.Q);
+    Qx.push_back(0);
+    for (size_t j = 0; j < B.n; ++j) {
+        std::fill(acc.begin(), acc.end(), 0);
+        // x = sum_i [x_i * qhat_i^{-1} mod q_i] * qhat_i, which is < L*Q
+        for (size_t i = 0; i < B.size(); ++i) {
+            u64 y = shoup_mul(in.limb(i)[j], B.qhat_inv[i], B.qhat_inv_shoup[i], B.moduli[i]);
+            mw_mul_word_add(acc.data(), B.qhat.data() + i * W, W, y);
+        }
+        while (mw_geq(acc.data(), Qx.data(), W + 1)) mw_sub(acc.data(), Qx.data(), W + 1);
+        for (size_t k = 0; k < W; ++k) out[j * W + k] = acc[k];
+    }
+}
+
+void rns_inner_product(const std::vector<RnsPoly>& a, const std::vector<RnsPoly>& b, RnsPoly& out) {
+    assert(!a.empty() && a.size() == b.size());
+    const RnsBase& B = *a[0].base;
+    const bool ntt_form = a[0].ntt_form;
+    std::vector<const u64*> pa(a.size()), pb(b.size());
+    for (size_t k = 0; k < a.size(); ++k) {
+        assert(a[k].base == &B && b[k].base == &B);
+        assert(a[k].ntt_form == ntt_form && b[k].ntt_form == ntt_form);
+        pa[k] = a[k].data.data();
+        pb[k] = b[k].data.data();
+    }
+    aligned_vector<u64> scratch(4 * B.n);
+    out.base = &B;
+    out.data.resize(B.size() * B.n);
+    rns_inner_product(B, pa.data(), pb.data(), a.size(), ntt_form, out.data.data(), scratch.data());
+    out.ntt_form = ntt_form;
+}
+
+void rns_tensor(const RnsPoly& a0, const RnsPoly& a1, const RnsPoly& b0, const RnsPoly& b1,
+                RnsPoly& c0, RnsPoly& c1, RnsPoly& c2) {
+    const RnsBase& B = *a0.base;
+    const bool ntt_form = a0.ntt_form;
+    assert(a1.base == &B && b0.base == &B && b1.base == &B);
+    assert(a1.ntt_form == ntt_form && b0.ntt_form == ntt_form && b1.ntt_form == ntt_form);
+    aligned_vector<u64> scratch(ntt_form ? 0 : 4 * B.n);
+    for (RnsPoly* c : {&c0, &c1, &c2}) {
+        c->base = &B;
+        c->data.resize(B.size() * B.n);
+        c->ntt_form = ntt_form;
+    }
+    rns_tensor(B, a0.data.data(), a1.data.data(), b0.data.data(), b1.data.data(), ntt_form,
+               c0.data.data(), c1.data.data(), c2.data.data(), scratch.data());
+}
@@ -0,0 +1,303 @@
+#include "rns_conv.h"
+#include "ntt.h"
+#include "shoup.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cassert>
+
+using u64 = uint64_t;
+using u128 = __uint128_t;
+
+static u64 mod_pow(u64 a, u64 e, u64 mod) {
+    u128 res = 1;
+    u128 base = a % mod;
+    while (e) {
+        if (e & 1) res = (res * base) % mod;
+        base = (base * base) % mod;
+        e >>= 1;
+    }
+    return (u64)res;
+}
+
+// Products of residues are below 2^124, so a 128-bit accumulator holds a
+// residue plus 15 of them before it has to be folded back.
+static const size_t CONV_FOLD = 15;
+
+// Constants of one target modulus for reducing (hi, lo) = hi * 2^64 + lo.
+struct WideMod {
+    u64 p, r64, r64_shoup, one_shoup;
+};
+
+// Constants of one remaining limb of a rescale.
+struct RescaleLimb {
+    u64 q, one_shoup, last_mod, half;
+    u64 t_mod, t_mod_shoup;  // t_mod == 1 (rescale): no multiply
+    u64 last_inv, last_inv_shoup;
+};
+
+// --- scalar kernels ---
+
+static inline u64 wide_reduce(u64 hi, u64 lo, const WideMod& w) {
+    u64 r = shoup_mul_lazy(hi, w.r64, w.r64_shoup, w.p) + shoup_mul_lazy(lo, 1, w.one_shoup, w.p);
+    if (r >= 2 * w.p) r -= 2 * w.p;
+    return r >= w.p ? r - w.p : r;
+}
+
+// y = x * c mod q
+static void scale_scalar(const u64* x, u64 c, u64 cs, u64 q, u64* y, size_t cnt) {
+    for (size_t t = 0; t < cnt; ++t) y[t] = shoup_mul(x[t], c, cs, q);
+}
+
+// out[t] = sum_i y[i * RNS_CONV_TILE + t] * m[i] mod p, for t < cnt
+static void mac_scalar(const u64* y, size_t L, const u64* m, const WideMod& w, u64* out, size_t cnt) {
+    for (size_t t = 0; t < cnt; ++t) {
+        u128 acc = 0;
+        for (size_t i0 = 0; i0 < L; i0 += CONV_FOLD) {
+            const size_t i1 = std::min(L, i0 + CONV_FOLD);
+            for (size_t i = i0; i < i1; ++i) acc += (u128)y[i * RNS_CONV_TILE + t] * m[i];
+            if (i1 < L) acc = wide_reduce((u64)(acc >> 64), (u64)acc, w);
+        }
+        out[t] = wide_reduce((u64)(acc >> 64), (u64)acc, w);
+    }
+}
+
+// d = t * lift(r) mod q, with r in [0, q_L) lifted to (-q_L/2, q_L/2]
+static void lift_scalar(const u64* r, const RescaleLimb& k, u64* d, size_t cnt) {
+    for (size_t j = 0; j < cnt; ++j) {
+        u64 c = shoup_mul(r[j], 1, k.one_shoup, k.q);
+        if (r[j] > k.half) c = (c >= k.last_mod) ? c - k.last_mod : c + k.q - k.last_mod;
+        d[j] = (k.t_mod == 1) ? c : shoup_mul(c, k.t_mod, k.t_mod_shoup, k.q);
+    }
+}
+
+// out = (x - d) * q_L^{-1} mod q
+static void sub_mul_scalar(const u64* x, const u64* d, const RescaleLimb& k, u64* out, size_t cnt) {
+    for (size_t j = 0; j < cnt; ++j) out[j] = shoup_mul(x[j] + k.q - d[j], k.last_inv, k.last_inv_shoup, k.q);
+}
+
+#if HE_HAVE_AVX2_KERNELS
+#include "simd_avx2.h"
+
+static HE_TARGET_AVX2 void scale_avx2(const u64* x, u64 c, u64 cs, u64 q, u64* y, size_t cnt) {
+    const __m256i vq = _mm256_set1_epi64x((long long)q);
+    const __m256i vc = _mm256_set1_epi64x((long long)c);
+    const __m256i vcs = _mm256_set1_epi64x((long long)cs);
+    size_t t = 0;
+    for (; t + 4 <= cnt; t += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(x + t));
+        _mm256_storeu_si256((__m256i*)(y + t), csub(shoup_mul_lazy4(v, vc, vcs, vq), vq));
+    }
+    scale_scalar(x + t, c, cs, q, y + t, cnt - t);
+}
+
+static HE_TARGET_AVX2 void lift_avx2(const u64* r, const RescaleLimb& k, u64* d, size_t cnt) {
+    const __m256i vq = _mm256_set1_epi64x((long long)k.q);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i ones = _mm256_set1_epi64x((long long)k.one_shoup);
+    const __m256i lm = _mm256_set1_epi64x((long long)k.last_mod);
+    const __m256i half = _mm256_set1_epi64x((long long)k.half);
+    const __m256i tm = _mm256_set1_epi64x((long long)k.t_mod);
+    const __m256i tms = _mm256_set1_epi64x((long long)k.t_mod_shoup);
+    size_t j = 0;
+    for (; j + 4 <= cnt; j += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(r + j));
+        __m256i c = csub(shoup_mul_lazy4(v, one, ones, vq), vq);
+        // r > q_L/2 (both below 2^62, so the signed compare is exact): c + q - q_L mod q
+        __m256i neg = _mm256_cmpgt_epi64(v, half);
+        c = _mm256_add_epi64(c, _mm256_and_si256(neg, _mm256_sub_epi64(vq, lm)));
+        c = csub(c, vq);
+        if (k.t_mod != 1) c = csub(shoup_mul_lazy4(c, tm, tms, vq), vq);
+        _mm256_storeu_si256((__m256i*)(d + j), c);
+    }
+    lift_scalar(r + j, k, d + j, cnt - j);
+}
+
+static HE_TARGET_AVX2 void sub_mul_avx2(const u64* x, const u64* d, const RescaleLimb& k, u64* out, size_t cnt) {
+    const __m256i vq = _mm256_set1_epi64x((long long)k.q);
+    const __m256i w = _mm256_set1_epi64x((long long)k.last_inv);
+    const __m256i ws = _mm256_set1_epi64x((long long)k.last_inv_shoup);
+    size_t j = 0;
+    for (; j + 4 <= cnt; j += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(x + j));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(d + j));
+        __m256i s = _mm256_sub_epi64(_mm256_add_epi64(a, vq), b);
+        _mm256_storeu_si256((__m256i*)(out + j), csub(shoup_mul_lazy4(s, w, ws, vq), vq));
+    }
+    sub_mul_scalar(x + j, d + j, k, out + j, cnt - j);
+}
+#endif
+
+// --- dispatch ---
+
+static void scale(const u64* x, u64 c, u64 cs, u64 q, u64* y, size_t cnt) {
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        scale_avx2(x, c, cs, q, y, cnt);
+        return;
+    }
+#endif
+    scale_scalar(x, c, cs, q, y, cnt);
+}
+
+static void lift(const u64* r, const RescaleLimb& k, u64* d, size_t cnt) {
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        lift_avx2(r, k, d, cnt);
+        return;
+    }
+#endif
+    lift_scalar(r, k, d, cnt);
+}
+
+static void sub_mul(const u64* x, const u64* d, const RescaleLimb& k, u64* out, size_t cnt) {
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        sub_mul_avx2(x, d, k, out, cnt);
+        return;
+    }
+#endif
+    sub_mul_scalar(x, d, k, out, cnt);
+}
+
+// --- base conversion ---
+
+BaseConverter::BaseConverter(const RnsBase& from_, const RnsBase& to_) {
+    init(from_, to_);
+}
+
+void BaseConverter::init(const RnsBase& from_, const RnsBase& to_) {
+    assert(from_.n == to_.n);
+    from = &from_;
+    to = &to_;
+    const size_t L = from_.size(), K = to_.size();
+    qhat_mod_p.assign(K * L, 0);
+    r64.assign(K, 0);
+    r64_shoup.assign(K, 0);
+    one_shoup.assign(K, 0);
+    for (size_t j = 0; j < K; ++j) {
+        const u64 p = to_.moduli[j];
+        for (size_t i = 0; i < L; ++i) {
+            u64 h = 1 % p;
+            for (size_t k = 0; k < L; ++k) {
+                if (k != i) h = (u128)h * (from_.moduli[k] % p) % p;
+            }
+            qhat_mod_p[j * L + i] = h;
+        }
+        r64[j] = (u64)(((u128)1 << 64) % p);
+        r64_shoup[j] = shoup_precompute(r64[j], p);
+        one_shoup[j] = shoup_precompute(1, p);
+    }
+}
+
+void rns_base_convert(const BaseConverter& C, const u64* in, u64* out, u64* scratch) {
+    const RnsBase& F = *C.from;
+    const size_t n = F.n, L = F.size(), K = C.to->size();
+    for (size_t j0 = 0; j0 < n; j0 += RNS_CONV_TILE) {
+        const size_t cnt = std::min(RNS_CONV_TILE, n - j0);
+        // y_i for the tile, one row of RNS_CONV_TILE words per source limb
+        for (size_t i = 0; i < L; ++i) {
+            scale(in + i * n + j0, F.qhat_inv[i], F.qhat_inv_shoup[i], F.moduli[i],
+                  scratch + i * RNS_CONV_TILE, cnt);
+        }
+        for (size_t j = 0; j < K; ++j) {
+            const WideMod w = {C.to->moduli[j], C.r64[j], C.r64_shoup[j], C.one_shoup[j]};
+            mac_scalar(scratch, L, C.qhat_mod_p.data() + j * L, w, out + j * n + j0, cnt);
+        }
+    }
+}
+
+void rns_base_convert(const BaseConverter& C, const RnsPoly& in, RnsPoly& out) {
+    assert(in.base == C.from && !in.ntt_form);
+    aligned_vector<u64> scratch(C.from->size() * RNS_CONV_TILE);
+    out.base = C.to;
+    out.data.resize(C.to->size() * C.to->n);
+    rns_base_convert(C, in.data.data(), out.data.data(), scratch.data());
+    out.ntt_form = false;
+}
+
+// --- rescale / modulus switch ---
+
+RnsRescaler::RnsRescaler(const RnsBase& from_, const RnsBase& to_, u64 t_) {
+    init(from_, to_, t_);
+}
+
+void RnsRescaler::init(const RnsBase& from_, const RnsBase& to_, u64 t_) {
+    const size_t L = from_.size();
+    assert(L >= 2 && to_.size() == L - 1 && to_.n == from_.n);
+    assert(std::equal(to_.moduli.begin(), to_.moduli.end(), from_.moduli.begin()));
+    from = &from_;
+    to = &to_;
+    t = t_;
+    const u64 ql = from_.moduli[L - 1];
+    assert(t >= 1 && t % ql != 0);
+    t_inv = mod_pow(t % ql, ql - 2, ql);
+    t_inv_shoup = shoup_precompute(t_inv, ql);
+    last_inv.assign(L - 1, 0);
+    last_inv_shoup.assign(L - 1, 0);
+    last_mod.assign(L - 1, 0);
+    t_mod.assign(L - 1, 0);
+    t_mod_shoup.assign(L - 1, 0);
+    one_shoup.assign(L - 1, 0);
+    for (size_t i = 0; i + 1 < L; ++i) {
+        const u64 q = from_.moduli[i];
+        last_mod[i] = ql % q;
+        last_inv[i] = mod_pow(last_mod[i], q - 2, q);
+        last_inv_shoup[i] = shoup_precompute(last_inv[i], q);
+        t_mod[i] = t % q;
+        t_mod_shoup[i] = shoup_precompute(t_mod[i], q);
+        one_shoup[i] = shoup_precompute(1, q);
+    }
+}
+
+static RescaleLimb rescale_limb(const RnsRescaler& R, size_t i) {
+    const u64 ql = R.from->moduli.back();
+    return {R.from->moduli[i], R.one_shoup[i], R.last_mod[i], ql / 2,
+            R.t_mod[i], R.t_mod_shoup[i], R.last_inv[i], R.last_inv_shoup[i]};
+}
+
+void rns_rescale(const RnsRescaler& R, const u64* in, bool ntt_form, u64* out, u64* scratch) {
+    const RnsBase& F = *R.from;
+    const size_t n = F.n, L = F.size();
+    const u64 ql = F.moduli[L - 1];
+    const u64* last = in + (L - 1) * n;
+    u64* r = scratch;
+    u64* d = scratch + n;
+    if (ntt_form) {
+        // the correction needs the last limb's coefficients; it goes back to
+        // each remaining limb through that limb's forward transform
+        std::copy(last, last + n, r);
+        intt_negacyclic(r, n, F.plans[L - 1]);
+        if (R.t != 1) scale(r, R.t_inv, R.t_inv_shoup, ql, r, n);
+        for (size_t i = 0; i + 1 < L; ++i) {
+            const RescaleLimb k = rescale_limb(R, i);
+            lift(r, k, d, n);
+            ntt_negacyclic(d, n, F.plans[i]);
+            sub_mul(in + i * n, d, k, out + i * n, n);
+        }
+        return;
+    }
+    for (size_t j0 = 0; j0 < n; j0 += RNS_CONV_TILE) {
+        const size_t cnt = std::min(RNS_CONV_TILE, n - j0);
+        const u64* rt = last + j0;
+        if (R.t != 1) {
+            scale(rt, R.t_inv, R.t_inv_shoup, ql, r, cnt);
+            rt = r;
+        }
+        for (size_t i = 0; i + 1 < L; ++i) {
+            const RescaleLimb k = rescale_limb(R, i);
+            lift(rt, k, d, cnt);
+            sub_mul(in + i * n + j0, d, k, out + i * n + j0, cnt);
+        }
+    }
+}
+
+void rns_rescale(const RnsRescaler& R, const RnsPoly& in, RnsPoly& out) {
+    assert(in.base == R.from);
+    const size_t n = R.from->n;
+    aligned_vector<u64> scratch(2 * n);
+    if (&out != &in) out.data.resize(R.to->size() * n);
+    rns_rescale(R, in.data.data(), in.ntt_form, out.data.data(), scratch.data());
+    out.data.resize(R.to->size() * n);
+    out.base = R.to;
+    out.ntt_form = in.ntt_form;
+}
@@ -0,0 +1,303 @@
+#include "serialize.h"
+#include "rns.h"
+#include "cpu_features.h"
+#include "simd_avx2.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+using u64 = uint64_t;
+using u128 = __uint128_t;
+
+// payload words are moved with memcpy, which is little-endian only there
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "serialization assumes a little-endian host");
+
+static const char serial_magic[4] = {'H', 'E', 'P', 'K'};
+static const size_t max_limbs = 1024;
+
+unsigned coeff_bits(u64 mod) {
+    assert(mod >= 2);
+    return 64 - __builtin_clzll((mod - 1) | 1);
+}
+
+static u64 low_mask(unsigned bits) {
+    return bits >= 64 ? ~u64(0) : (u64(1) << bits) - 1;
+}
+
+// --- bit packing ---
+
+static void pack_bits_scalar(const u64* in, size_t count, unsigned bits, uint8_t* out) {
+    u128 acc = 0;
+    unsigned have = 0;
+    for (size_t i = 0; i < count; ++i) {
+        acc |= (u128)in[i] << have;
+        have += bits;
+        if (have >= 64) {
+            u64 w = (u64)acc;
+            memcpy(out, &w, 8);
+            out += 8;
+            acc >>= 64;
+            have -= 64;
+        }
+    }
+    for (; have > 0; have = have > 8 ? have - 8 : 0) {
+        *out++ = (uint8_t)acc;
+        acc >>= 8;
+    }
+}
+
+static void unpack_bits_scalar(const uint8_t* in, size_t count, unsigned bits, u64* out) {
+    const u64 mask = low_mask(bits);
+    size_t left = packed_bytes(count, bits);
+    u128 acc = 0;
+    unsigned have = 0;
+    for (size_t i = 0; i < count; ++i) {
+        while (have < bits) {
+            if (left >= 8) {
+                u64 w;
+                memcpy(&w, in, 8);
+                acc |= (u128)w << have;
+                have += 64;
+                in += 8;
+                left -= 8;
+            } else {
+                acc |= (u128)*in++ << have;
+                have += 8;
+                --left;
+            }
+        }
+        out[i] = (u64)acc & mask;
+        acc >>= bits;
+        have -= bits;
+    }
+}
+
+#if HE_HAVE_AVX2_KERNELS
+
+// Eight values fill exactly 'bits' bytes, i.e. 64-bit words 0..7 of two
+// registers. Value i starts at bit p = i*bits; word k gets it shifted left
+// by p - 64k or right by 64k - p, and vpsllvq / vpsrlvq give zero for
+// counts of 64 or more, which masks out the words it does not touch.
+static HE_TARGET_AVX2 void pack_bits_avx2(const u64* in, size_t count, unsigned bits, uint8_t* out) {
+    __m256i lcnt[8][2], rcnt[8][2];
+    for (unsigned i = 0; i < 8; ++i) {
+        long long p = (long long)i * bits;
+        for (unsigned r = 0; r < 2; ++r) {
+            long long l[4], s[4];
+            for (unsigned k = 0; k < 4; ++k) {
+                long long d = p - 64 * (long long)(4 * r + k);
+                l[k] = d >= 0 && d < 64 ? d : 64;
+                s[k] = d < 0 && -d < 64 ? -d : 64;
+            }
+            lcnt[i][r] = _mm256_setr_epi64x(l[0], l[1], l[2], l[3]);
+            rcnt[i][r] = _mm256_setr_epi64x(s[0], s[1], s[2], s[3]);
+        }
+    }
+    const size_t total = packed_bytes(count, bits);
+    size_t g = 0, pos = 0;
+    for (; g + 8 <= count; g += 8, pos += bits) {
+        __m256i w0 = _mm256_setzero_si256(), w1 = _mm256_setzero_si256();
+        for (unsigned i = 0; i < 8; ++i) {
+            __m256i v = _mm256_set1_epi64x((long long)in[g + i]);
+            w0 = _mm256_or_si256(w0, _mm256_or_si256(_mm256_sllv_epi64(v, lcnt[i][0]), _mm256_srlv_epi64(v, rcnt[i][0])));
+            w1 = _mm256_or_si256(w1, _mm256_or_si256(_mm256_sllv_epi64(v, lcnt[i][1]), _mm256_srlv_epi64(v, rcnt[i][1])));
+        }
+        if (total - pos >= 64) {
+            // the bytes past 'bits' are zero and the next group overwrites them
+            _mm256_storeu_si256((__m256i*)(out + pos), w0);
+            _mm256_storeu_si256((__m256i*)(out + pos + 32), w1);
+        } else {
+            alignas(32) uint8_t tmp[64];
+            _mm256_store_si256((__m256i*)tmp, w0);
+            _mm256_store_si256((__m256i*)(tmp + 32), w1);
+            memcpy(out + pos, tmp, bits);
+        }
+    }
+    pack_bits_scalar(in + g, count - g, bits, out + pos);
+}
+
+// Gathers the 8 bytes holding each value (byte offset p / 8) and shifts out
+// the p % 8 bits below it; needs bits <= 57 and 8 readable bytes.
+static HE_TARGET_AVX2 void unpack_bits_avx2(const uint8_t* in, size_t count, unsigned bits, u64* out) {
+    long long off[8], sh[8];
+    for (unsigned i = 0; i < 8; ++i) {
+        off[i] = (long long)(i * bits / 8);
+        sh[i] = (long long)(i * bits % 8);
+    }
+    const __m256i off0 = _mm256_setr_epi64x(off[0], off[1], off[2], off[3]);
+    const __m256i off1 = _mm256_setr_epi64x(off[4], off[5], off[6], off[7]);
+    const __m256i sh0 = _mm256_setr_epi64x(sh[0], sh[1], sh[2], sh[3]);
+    const __m256i sh1 = _mm256_setr_epi64x(sh[4], sh[5], sh[6], sh[7]);
+    const __m256i mask = _mm256_set1_epi64x((long long)low_mask(bits));
+    const size_t total = packed_bytes(count, bits);
+    size_t g = 0, pos = 0;
+    for (; g + 8 <= count && pos + (size_t)off[7] + 8 <= total; g += 8, pos += bits) {
+        const long long* base = (const long long*)(in + pos);
+        __m256i x0 = _mm256_i64gather_epi64(base, off0, 1);
+        __m256i x1 = _mm256_i64gather_epi64(base, off1, 1);
+        _mm256_storeu_si256((__m256i*)(out + g), _mm256_and_si256(_mm256_srlv_epi64(x0, sh0), mask));
+        _mm256_storeu_si256((__m256i*)(out + g + 4), _mm256_and_si256(_mm256_srlv_epi64(x1, sh1), mask));
+    }
+    unpack_bits_scalar(in + pos, count - g, bits, out + g);
+}
+
+#endif
+
+void pack_bits(const u64* in, size_t count, unsigned bits, uint8_t* out) {
+    assert(bits >= 1 && bits <= 64);
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        pack_bits_avx2(in, count, bits, out);
+        return;
+    }
+#endif
+    pack_bits_scalar(in, count, bits, out);
+}
+
+void unpack_bits(const uint8_t* in, size_t count, unsigned bits, u64* out) {
+    assert(bits >= 1 && bits <= 64);
+#if HE_HAVE_AVX2_KERNELS
+    if (bits <= 57 && host_has_avx2()) {
+        unpack_bits_avx2(in, count, bits, out);
+        return;
+    }
+#endif
+    unpack_bits_scalar(in, count, bits, out);
+}
+
+// --- endpoints ---
+
+ByteWriter fd_writer(int fd) {
+    return [fd](const void* p, size_t len) {
+        const char* c = static_cast<const char*>(p);
+        while (len) {
+            ssize_t k = ::write(fd, c, len);
+            if (k < 0 && errno == EINTR) continue;
+            if (k <= 0) return false;
+            c += k;
+            len -= (size_t)k;
+        }
+        return true;
+    };
+}
+
+ByteReader fd_reader(int fd) {
+    return [fd](void* p, size_t len) {
+        char* c = static_cast<char*>(p);
+        while (len) {
+            ssize_t k = ::read(fd, c, len);
+            if (k < 0 && errno == EINTR) continue;
+            if (k <= 0) return false;
+            c += k;
+            len -= (size_t)k;
+        }
+        return true;
+    };
+}
+
+ByteWriter buffer_writer(std::vector<uint8_t>& out) {
+    return [&out](const void* p, size_t len) {
+        const uint8_t* c = static_cast<const uint8_t*>(p);
+        out.insert(out.end(), c, c + len);
+        return true;
+    };
+}
+
+ByteReader buffer_reader(const uint8_t* data, size_t size) {
+    return [data, size, pos = size_t(0)](void* p, size_t len) mutable {
+        if (len > size - pos) return false;
+        memcpy(p, data + pos, len);
+        pos += len;
+        return true;
+    };
+}
+
+// --- polynomials ---
+
+PolyHeader::PolyHeader(const RnsPoly& a) : n(a.base->n), moduli(a.base->moduli), ntt_form(a.ntt_form) {}
+
+size_t PolyHeader::payload_bytes() const {
+    size_t b = 0;
+    for (u64 q : moduli) b += packed_bytes(n, coeff_bits(q));
+    return b;
+}
+
+bool write_poly(const ByteWriter& w, const PolyHeader& h, const u64* data) {
+    assert(!h.moduli.empty() && h.moduli.size() <= max_limbs && h.n < (size_t(1) << 32));
+    std::vector<uint8_t> head(h.header_bytes());
+    memcpy(head.data(), serial_magic, 4);
+    head[4] = SERIAL_VERSION;
+    head[5] = h.ntt_form ? 1 : 0;
+    uint16_t limbs = (uint16_t)h.moduli.size();
+    uint32_t n32 = (uint32_t)h.n;
+    memcpy(head.data() + 6, &limbs, 2);
+    memcpy(head.data() + 8, &n32, 4);
+    memcpy(head.data() + 12, h.moduli.data(), 8 * h.moduli.size());
+    if (!w(head.data(), head.size())) return false;
+
+    // chunks of SERIAL_CHUNK (a multiple of 8) coefficients end on bytes
+    std::vector<uint8_t> buf(packed_bytes(SERIAL_CHUNK, 64));
+    for (size_t i = 0; i < h.moduli.size(); ++i) {
+        const unsigned bits = coeff_bits(h.moduli[i]);
+        const u64* limb = data + i * h.n;
+        for (size_t j = 0; j < h.n; j += SERIAL_CHUNK) {
+            size_t count = std::min(SERIAL_CHUNK, h.n - j);
+            pack_bits(limb + j, count, bits, buf.data());
+            if (!w(buf.data(), packed_bytes(count, bits))) return false;
+        }
+    }
+    return true;
+}
+
+bool write_poly(const ByteWriter& w, const RnsPoly& a) {
+    return write_poly(w, PolyHeader(a), a.data.data());
+}
+
+bool read_poly_header(const ByteReader& r, PolyHeader& h) {
+    uint8_t head[12];
+    if (!r(head, sizeof head) || memcmp(head, serial_magic, 4) != 0 || head[4] != SERIAL_VERSION || head[5] > 1)
+        return false;
+    uint16_t limbs;
+    uint32_t n32;
+    memcpy(&limbs, head + 6, 2);
+    memcpy(&n32, head + 8, 4);
+    if (limbs == 0 || limbs > max_limbs || n32 == 0 || (n32 & (n32 - 1))) return false;
+    h.n = n32;
+    h.ntt_form = head[5] == 1;
+    h.moduli.resize(limbs);
+    if (!r(h.moduli.data(), 8 * (size_t)limbs)) return false;
+    for (u64 q : h.moduli) {
+        if (q < 2 || q >= (u64(1) << 62)) return false;
+    }
+    return true;
+}
+
+bool read_poly_data(const ByteReader& r, const PolyHeader& h, u64* data) {
+    std::vector<uint8_t> buf(packed_bytes(SERIAL_CHUNK, 64));
+    for (size_t i = 0; i < h.moduli.size(); ++i) {
+        const u64 q = h.moduli[i];
+        const unsigned bits = coeff_bits(q);
+        u64* limb = data + i * h.n;
+        for (size_t j = 0; j < h.n; j += SERIAL_CHUNK) {
+            size_t count = std::min(SERIAL_CHUNK, h.n - j);
+            if (!r(buf.data(), packed_bytes(count, bits))) return false;
+            unpack_bits(buf.data(), count, bits, limb + j);
+            u64 bad = 0;
+            for (size_t k = 0; k < count; ++k) bad |= limb[j + k] >= q;
+            if (bad) return false;
+        }
+    }
+    return true;
+}
+
+bool read_poly(const ByteReader& r, RnsPoly& out) {
+    assert(out.base);
+    PolyHeader h;
+    if (!read_poly_header(r, h) || h.n != out.base->n || h.moduli != out.base->moduli) return false;
+    out.data.resize(h.moduli.size() * h.n);
+    if (!read_poly_data(r, h, out.data.data())) return false;
+    out.ntt_form = h.ntt_form;
+    return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include "cpu_features.h"
+
+// 4 x 64-bit lane arithmetic shared by the AVX2 kernels (internal, not
+// installed): products assembled from _mm256_mul_epu32, Shoup and lazy
+// Montgomery reduction, branch-free conditional subtraction.
+
+#if HE_HAVE_AVX2_KERNELS
+#include <immintrin.h>
+
+// low 64 bits of a*b per lane
+static inline HE_TARGET_AVX2 __m256i mul64_lo(__m256i a, __m256i b) {
+    __m256i a_hi = _mm256_srli_epi64(a, 32);
+    __m256i b_hi = _mm256_srli_epi64(b, 32);
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(a, b_hi), _mm256_mul_epu32(a_hi, b));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+// both halves of the 128-bit product a*b per lane
+static inline HE_TARGET_AVX2 void mul64_full(__m256i a, __m256i b, __m256i& lo, __m256i& hi) {
+    const __m256i mask32 = _mm256_set1_epi64x(0xFFFFFFFFLL);
+    __m256i a_hi = _mm256_srli_epi64(a, 32);
+    __m256i b_hi = _mm256_srli_epi64(b, 32);
+    __m256i p00 = _mm256_mul_epu32(a, b);
+    __m256i p01 = _mm256_mul_epu32(a, b_hi);
+    __m256i p10 = _mm256_mul_epu32(a_hi, b);
+    __m256i p11 = _mm256_mul_epu32(a_hi, b_hi);
+    // middle column: carry-in from p00 plus the low halves of the cross terms
+    __m256i mid = _mm256_add_epi64(_mm256_srli_epi64(p00, 32),
+                  _mm256_add_epi64(_mm256_and_si256(p01, mask32), _mm256_and_si256(p10, mask32)));
+    lo = _mm256_or_si256(_mm256_and_si256(p00, mask32), _mm256_slli_epi64(mid, 32));
+    hi = _mm256_add_epi64(_mm256_add_epi64(p11, _mm256_srli_epi64(mid, 32)),
+         _mm256_add_epi64(_mm256_srli_epi64(p01, 32), _mm256_srli_epi64(p10, 32)));
+}
+
+static inline HE_TARGET_AVX2 __m256i mul64_hi(__m256i a, __m256i b) {
+    __m256i lo, hi;
+    mul64_full(a, b, lo, hi);
+    return hi;
+}
+
+// x >= c ? x - c : x, valid for c <= 2^63 and x < c + 2^63: the wrapped
+// difference has its sign bit set exactly when x < c.
+static inline HE_TARGET_AVX2 __m256i csub(__m256i x, __m256i c) {
+    __m256i d = _mm256_sub_epi64(x, c);
+    return _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(d),
+                                                _mm256_castsi256_pd(x),
+                                                _mm256_castsi256_pd(d)));
+}
+
+// Shoup product y*w mod q in [0, 2q)
+static inline HE_TARGET_AVX2 __m256i shoup_mul_lazy4(__m256i y, __m256i w, __m256i wp, __m256i q) {
+    __m256i qe = mul64_hi(y, wp);
+    return _mm256_sub_epi64(mul64_lo(y, w), mul64_lo(qe, q));
+}
+
+// Montgomery product REDC(y*w) in [0, 2q); the low words of t and m*q sum to
+// 0 mod 2^64, so the carry into the high word is 1 iff lo(t) != 0.
+static inline HE_TARGET_AVX2 __m256i mont_mul_lazy4(__m256i y, __m256i w, __m256i q, __m256i ninv) {
+    __m256i lo, hi;
+    mul64_full(y, w, lo, hi);
+    __m256i m = mul64_lo(lo, ninv);
+    __m256i mq_hi = mul64_hi(m, q);
+    __m256i carry = _mm256_andnot_si256(_mm256_cmpeq_epi64(lo, _mm256_setzero_si256()),
+                                        _mm256_set1_epi64x(1));
+    return _mm256_add_epi64(_mm256_add_epi64(hi, mq_hi), carry);
+}
+
+#endif
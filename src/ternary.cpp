@@ -0,0 +1,276 @@
+#include "ternary.h"
+#include "ntt.h"
+#include "rns.h"
+#include "mod_arith.h"
+#include "aligned_vector.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cassert>
+
+using u64 = uint64_t;
+
+// s * b = sum_{s_k = 1} X^k b - sum_{s_k = -1} X^k b. Every rotation reads
+// one contiguous window of an extended copy of b:
+//   negacyclic  ext = [b, -b, b]:    +1 at k -> ext + 2n - k, -1 -> ext + n - k
+//   cyclic      ext = [b, b, -b, -b]: +1 at k -> ext + n - k,  -1 -> ext + 3n - k
+// so out[j] is a sum of ext[off + j] over one offset per nonzero, all
+// additions. The kernels walk out in blocks that stay in registers (AVX2)
+// or L1 (scalar) while every offset is added in.
+
+static const size_t SCALAR_BLOCK = 64;
+
+static void build_ext(const u64* b, size_t n, u64 mod, bool cyclic, u64* ext) {
+    if (cyclic) {
+        std::copy(b, b + n, ext);
+        std::copy(b, b + n, ext + n);
+        negate_mod_array(b, ext + 2 * n, n, mod);
+        std::copy(ext + 2 * n, ext + 3 * n, ext + 3 * n);
+    } else {
+        std::copy(b, b + n, ext);
+        negate_mod_array(b, ext + n, n, mod);
+        std::copy(b, b + n, ext + 2 * n);
+    }
+}
+
+// Residues are below 2^62, so an accumulator that starts below q can take
+// 2^j - 1 more of them while 2^j * q <= 2^64, and then drop back below q
+// with j conditional subtractions of 2^{j-1} q, ..., q. j is capped so a
+// fold stays cheap next to the additions it covers.
+static const unsigned MAX_FOLD_LOG = 6;
+
+static unsigned fold_log(u64 mod) {
+    unsigned j = 2;
+    while (j < MAX_FOLD_LOG && (mod >> (63 - j)) == 0) ++j;
+    return j;
+}
+
+// --- scalar kernel ---
+
+static inline u64 fold(u64 a, u64 mod, unsigned j) {
+    for (unsigned i = j; i-- > 0;) {
+        u64 c = mod << i;
+        a = a >= c ? a - c : a;
+    }
+    return a;
+}
+
+static void rot_sum_scalar(const u64* ext, const TernaryPoly& s, size_t pb, size_t mb, u64 mod,
+                           u64* out, size_t j0, size_t cnt) {
+    const unsigned j = fold_log(mod);
+    const size_t terms = ((size_t)1 << j) - 1;
+    u64 acc[SCALAR_BLOCK];
+    for (size_t b0 = j0; b0 < j0 + cnt; b0 += SCALAR_BLOCK) {
+        const size_t m = std::min(SCALAR_BLOCK, j0 + cnt - b0);
+        std::fill(acc, acc + m, 0);
+        size_t pending = 0;
+        for (int sign = 0; sign < 2; ++sign) {
+            const std::vector<uint32_t>& idx = sign ? s.minus : s.plus;
+            const size_t base = sign ? mb : pb;
+            for (uint32_t k : idx) {
+                const u64* src = ext + base - k + b0;
+                for (size_t t = 0; t < m; ++t) acc[t] += src[t];
+                if (++pending == terms) {
+                    for (size_t t = 0; t < m; ++t) acc[t] = fold(acc[t], mod, j);
+                    pending = 0;
+                }
+            }
+        }
+        for (size_t t = 0; t < m; ++t) out[b0 + t] = fold(acc[t], mod, j);
+    }
+}
+
+#if HE_HAVE_AVX2_KERNELS
+#include "simd_avx2.h"
+
+static inline HE_TARGET_AVX2 __m256i fold4(__m256i a, const __m256i* mult, unsigned j) {
+    for (unsigned i = j; i-- > 0;) a = csub(a, mult[i]);
+    return a;
+}
+
+// 16 outputs per block in four accumulators: per nonzero, four unaligned
+// loads and adds, a fold every 2^j - 1 nonzeros, and no stores until the
+// end of the block.
+static HE_TARGET_AVX2 void rot_sum_avx2(const u64* ext, const TernaryPoly& s, size_t pb, size_t mb, u64 mod,
+                                        u64* out, size_t n) {
+    const unsigned fj = fold_log(mod);
+    const size_t terms = ((size_t)1 << fj) - 1;
+    __m256i mult[MAX_FOLD_LOG];
+    for (unsigned i = 0; i < fj; ++i) mult[i] = _mm256_set1_epi64x((long long)(mod << i));
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16) {
+        __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+        size_t pending = 0;
+        for (int sign = 0; sign < 2; ++sign) {
+            const std::vector<uint32_t>& idx = sign ? s.minus : s.plus;
+            const size_t base = sign ? mb : pb;
+            for (uint32_t k : idx) {
+                const u64* src = ext + base - k + j;
+                a0 = _mm256_add_epi64(a0, _mm256_loadu_si256((const __m256i*)src));
+                a1 = _mm256_add_epi64(a1, _mm256_loadu_si256((const __m256i*)(src + 4)));
+                a2 = _mm256_add_epi64(a2, _mm256_loadu_si256((const __m256i*)(src + 8)));
+                a3 = _mm256_add_epi64(a3, _mm256_loadu_si256((const __m256i*)(src + 12)));
+                if (++pending == terms) {
+                    a0 = fold4(a0, mult, fj);
+                    a1 = fold4(a1, mult, fj);
+                    a2 = fold4(a2, mult, fj);
+                    a3 = fold4(a3, mult, fj);
+                    pending = 0;
+                }
+            }
+        }
+        _mm256_storeu_si256((__m256i*)(out + j), fold4(a0, mult, fj));
+        _mm256_storeu_si256((__m256i*)(out + j + 4), fold4(a1, mult, fj));
+        _mm256_storeu_si256((__m256i*)(out + j + 8), fold4(a2, mult, fj));
+        _mm256_storeu_si256((__m256i*)(out + j + 12), fold4(a3, mult, fj));
+    }
+    if (j < n) rot_sum_scalar(ext, s, pb, mb, mod, out, j, n - j);
+}
+#endif
+
+static void mul_ternary(const TernaryPoly& s, const u64* b, u64* out, u64* scratch, u64 mod, bool cyclic) {
+    const size_t n = s.n;
+    build_ext(b, n, mod, cyclic, scratch);
+    const size_t pb = cyclic ? n : 2 * n;
+    const size_t mb = cyclic ? 3 * n : n;
+#if HE_HAVE_AVX2_KERNELS
+    if (host_has_avx2()) {
+        rot_sum_avx2(scratch, s, pb, mb, mod, out, n);
+        return;
+    }
+#endif
+    rot_sum_scalar(scratch, s, pb, mb, mod, out, 0, n);
+}
+
+// --- representations ---
+
+static void clear(size_t n, TernaryPoly& out) {
+    out.n = n;
+    out.packed.assign((n + 3) / 4, 0);
+    out.plus.clear();
+    out.minus.clear();
+}
+
+static void set_coeff(TernaryPoly& out, size_t j, int c) {
+    if (c == 0) return;
+    out.packed[j / 4] |= (uint8_t)((c > 0 ? 1 : 2) << (2 * (j % 4)));
+    (c > 0 ? out.plus : out.minus).push_back((uint32_t)j);
+}
+
+bool ternary_from_signed(const int8_t* s, size_t n, TernaryPoly& out) {
+    clear(n, out);
+    for (size_t j = 0; j < n; ++j) {
+        if (s[j] < -1 || s[j] > 1) return false;
+        set_coeff(out, j, s[j]);
+    }
+    return true;
+}
+
+bool ternary_from_residues(const u64* a, size_t n, u64 mod, TernaryPoly& out) {
+    clear(n, out);
+    for (size_t j = 0; j < n; ++j) {
+        if (a[j] > 1 && a[j] != mod - 1) return false;
+        set_coeff(out, j, a[j] == 0 ? 0 : a[j] == 1 ? 1 : -1);
+    }
+    return true;
+}
+
+bool ternary_from_packed(const uint8_t* packed, size_t n, TernaryPoly& out) {
+    clear(n, out);
+    for (size_t j = 0; j < n; ++j) {
+        unsigned c = (packed[j / 4] >> (2 * (j % 4))) & 3;
+        if (c == 3) return false;
+        set_coeff(out, j, c == 1 ? 1 : c == 2 ? -1 : 0);
+    }
+    return true;
+}
+
+void ternary_to_residues(const TernaryPoly& s, u64 mod, u64* out) {
+    std::fill(out, out + s.n, 0);
+    for (uint32_t k : s.plus) out[k] = 1;
+    for (uint32_t k : s.minus) out[k] = mod - 1;
+}
+
+// --- products ---
+
+// Timed against poly_mul_negacyclic at n = 2^10..2^15 with 30- and 60-bit
+// primes (AVX2): the rotation sums break even at 14 to 25 nonzeros per
+// log2(n), so TERNARY_SPARSE_PER_LOG = 12 keeps a margin on both sides.
+bool ternary_prefers_sparse(size_t weight, size_t n) {
+    size_t log_n = 0;
+    while (((size_t)1 << log_n) < n) ++log_n;
+    return weight <= TERNARY_SPARSE_PER_LOG * log_n;
+}
+
+void poly_mul_ternary_negacyclic(const TernaryPoly& s, const u64* b, u64* out, u64* scratch, u64 mod) {
+    mul_ternary(s, b, out, scratch, mod, false);
+}
+
+void poly_mul_ternary_cyclic(const TernaryPoly& s, const u64* b, u64* out, u64* scratch, u64 mod) {
+    mul_ternary(s, b, out, scratch, mod, true);
+}
+
+void poly_mul_negacyclic(const TernaryPoly& s, const u64* b, u64* out, u64* scratch, const NttPlan& plan) {
+    assert(s.n == plan.n && plan.has_negacyclic());
+    const size_t n = plan.n;
+    if (ternary_prefers_sparse(s.weight(), n)) {
+        mul_ternary(s, b, out, scratch, plan.mod, false);
+        return;
+    }
+    ternary_to_residues(s, plan.mod, scratch);
+    if (out != b) std::copy(b, b + n, out);
+    ntt_negacyclic(scratch, n, plan);
+    ntt_negacyclic(out, n, plan);
+    mul_mod_array(out, scratch, out, n, plan.mod);
+    intt_negacyclic(out, n, plan);
+}
+
+void poly_mul_cyclic(const TernaryPoly& s, const u64* b, u64* out, u64* scratch, const NttPlan& plan) {
+    assert(s.n == plan.n);
+    const size_t n = plan.n;
+    if (ternary_prefers_sparse(s.weight(), n)) {
+        mul_ternary(s, b, out, scratch, plan.mod, true);
+        return;
+    }
+    ternary_to_residues(s, plan.mod, scratch);
+    if (out != b) std::copy(b, b + n, out);
+    ntt_to_bitrev(scratch, n, plan);
+    ntt_to_bitrev(out, n, plan);
+    mul_mod_array(out, scratch, out, n, plan.mod);
+    intt_from_bitrev(out, n, plan);
+}
+
+std::vector<u64> poly_mul_negacyclic(const TernaryPoly& s, const std::vector<u64>& b, const NttPlan& plan) {
+    assert(b.size() == plan.n);
+    std::vector<u64> out(plan.n), scratch(4 * plan.n);
+    poly_mul_negacyclic(s, b.data(), out.data(), scratch.data(), plan);
+    return out;
+}
+
+std::vector<u64> poly_mul_cyclic(const TernaryPoly& s, const std::vector<u64>& b, const NttPlan& plan) {
+    assert(b.size() == plan.n);
+    std::vector<u64> out(plan.n), scratch(4 * plan.n);
+    poly_mul_cyclic(s, b.data(), out.data(), scratch.data(), plan);
+    return out;
+}
+
+void rns_mul_ternary(const TernaryPoly& s, const RnsPoly& b, RnsPoly& out) {
+    const RnsBase& B = *b.base;
+    const size_t n = B.n;
+    assert(s.n == n);
+    if (&out != &b) {
+        out.base = b.base;
+        out.data.resize(B.size() * n);
+    }
+    aligned_vector<u64> scratch(4 * n);
+    for (size_t i = 0; i < B.size(); ++i) {
+        const NttPlan& plan = B.plans[i];
+        if (!b.ntt_form) {
+            poly_mul_negacyclic(s, b.limb(i), out.limb(i), scratch.data(), plan);
+            continue;
+        }
+        ternary_to_residues(s, plan.mod, scratch.data());
+        ntt_negacyclic(scratch.data(), n, plan);
+        mul_mod_array(b.limb(i), scratch.data(), out.limb(i), n, plan.mod);
+    }
+    out.ntt_form = b.ntt_form;
+}
@@ -0,0 +1,123 @@
+#include "thread_pool.h"
+#include <cassert>
+
+static thread_local bool in_pool_job = false;
+
+static inline uint64_t pack(uint64_t begin, uint64_t end) { return (end << 32) | begin; }
+static inline uint64_t range_begin(uint64_t r) { return r & 0xffffffffu; }
+static inline uint64_t range_end(uint64_t r) { return r >> 32; }
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    slots_ = std::vector<Slot>(threads);
+    workers_.reserve(threads - 1);
+    for (size_t id = 1; id < threads; ++id) workers_.emplace_back(&ThreadPool::worker_loop, this, id);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    if (in_pool_job || slots_.size() == 1 || count == 1) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+    assert(count < ((uint64_t)1 << 32));
+    std::lock_guard<std::mutex> job_lock(job_mutex_);
+
+    const size_t P = slots_.size();
+    for (size_t id = 0; id < P; ++id) {
+        uint64_t b = count * id / P, e = count * (id + 1) / P;
+        slots_[id].range.store(pack(b, e), std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        job_ = &fn;
+        busy_ = workers_.size();
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    run_slots(0);
+
+    std::unique_lock<std::mutex> lk(mutex_);
+    done_.wait(lk, [&] { return busy_ == 0; });
+    job_ = nullptr;
+}
+
+void ThreadPool::worker_loop(size_t id) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(mutex_);
+            wake_.wait(lk, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+        }
+        run_slots(id);
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (--busy_ == 0) done_.notify_one();
+    }
+}
+
+void ThreadPool::run_slots(size_t id) {
+    const std::function<void(size_t)>& fn = *job_;
+    in_pool_job = true;
+    size_t index;
+    for (;;) {
+        while (pop(id, index)) fn(index);
+        if (!steal(id)) break;
+    }
+    in_pool_job = false;
+}
+
+// take the first index of our own slice
+bool ThreadPool::pop(size_t id, size_t& index) {
+    std::atomic<uint64_t>& r = slots_[id].range;
+    uint64_t cur = r.load(std::memory_order_acquire);
+    for (;;) {
+        uint64_t b = range_begin(cur), e = range_end(cur);
+        if (b >= e) return false;
+        if (r.compare_exchange_weak(cur, pack(b + 1, e), std::memory_order_acq_rel)) {
+            index = b;
+            return true;
+        }
+    }
+}
+
+// move the back half of the fullest other slice into our (empty) slice
+bool ThreadPool::steal(size_t id) {
+    const size_t P = slots_.size();
+    for (;;) {
+        size_t victim = P;
+        uint64_t best = 0;
+        for (size_t k = 1; k < P; ++k) {
+            size_t v = (id + k) % P;
+            uint64_t cur = slots_[v].range.load(std::memory_order_acquire);
+            uint64_t left = range_end(cur) > range_begin(cur) ? range_end(cur) - range_begin(cur) : 0;
+            if (left > best) {
+                best = left;
+                victim = v;
+            }
+        }
+        if (victim == P) return false;
+        std::atomic<uint64_t>& r = slots_[victim].range;
+        uint64_t cur = r.load(std::memory_order_acquire);
+        uint64_t b = range_begin(cur), e = range_end(cur);
+        if (b >= e) continue;
+        uint64_t mid = b + (e - b) / 2;
+        if (r.compare_exchange_strong(cur, pack(b, mid), std::memory_order_acq_rel)) {
+            // a one-index slice is taken whole (mid == b leaves the victim empty)
+            slots_[id].range.store(pack(mid, e), std::memory_order_release);
+            return true;
+        }
+    }
+}
@@ -2,7 +2,25 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 #include "ntt.h"
+#include "montgomery.h"
+#include "poly.h"
+#include "rns.h"
+#include "ntt_parallel.h"
+#include "cpu_features.h"
+#include "poly_arena.h"
+#include "ntt_batch.h"
+#include "ntt_fixed.h"
+#include "mod_arith.h"
+#include "profile.h"
+#include "galois.h"
+#include "plan_file.h"
+#include "serialize.h"
+#include "rns_conv.h"
+#include "ternary.h"
+#include "autotune.h"
+#include "poly_queue.h"
 #include <vector>
+#include <random>
 using u64 = uint64_t;
 
 u64 mod_pow(u64 a, u64 e, u64 mod) {
@@ -25,8 +43,8 @@ TEST_CASE("NTT roundtrip and convolution small", "[ntt]") {
     std::vector<u64> a = {1,2,3,4,0,0,0,0};
     auto A = a;
     ntt(A, roots, mod);
-    auto B = A;
-    for (size_t i = 0; i < n; ++i) B[i] = ( (__uint128_t)A[i] * A[i] ) % mod;
+    std::vector<u64> B(n);
+    mul_mod_array(A.data(), A.data(), B.data(), n, mod);
     intt(B, roots, mod);
     // naive
     std::vector<u64> C(2*n-1,0);
@@ -35,3 +53,1401 @@ TEST_CASE("NTT roundtrip and convolution small", "[ntt]") {
             C[i+j] = (C[i+j] + (__uint128_t)a[i]*a[j]) % mod;
     for (size_t i=0;i<n;i++) REQUIRE(B[i] == C[i]);
 }
+
+TEST_CASE("Plan-based transforms match the root-vector API", "[ntt][plan]") {
+    const u64 mod = 2013265921;
+    const size_t n = 64;
+    u64 root_n = mod_pow(31, (mod - 1) / n, mod);
+    auto roots = compute_roots(root_n, n, mod);
+    NttPlan plan(n, mod, root_n);
+    std::vector<u64> a(n);
+    for (size_t i = 0; i < n; ++i) a[i] = (i * 7919 + 13) % mod;
+
+    auto ref = a, got = a;
+    ntt(ref, roots, mod);
+    ntt(got, plan);
+    REQUIRE(got == ref);
+
+    auto mont = a;
+    ntt_montgomery(mont, plan);
+    REQUIRE(mont == ref);
+
+    intt(got, plan);
+    REQUIRE(got == a);
+}
+
+TEST_CASE("Lazy Montgomery/Shoup kernels agree with baseline", "[ntt][lazy]") {
+    // 60-bit prime keeps the [0, 4q) intermediates close to the 2^64 limit
+    for (u64 mod : {u64(2013265921), u64(1152921504606584833ULL)}) {
+        const size_t n = 256;
+        u64 g = 2;
+        while (mod_pow(g, (mod - 1) / 2, mod) != mod - 1) ++g;
+        u64 root_n = mod_pow(g, (mod - 1) / n, mod);
+        auto roots = compute_roots(root_n, n, mod);
+        NttPlan plan(n, mod, root_n);
+        std::vector<u64> a(n);
+        for (size_t i = 0; i < n; ++i) a[i] = mod - 1 - (i * 0x9e3779b97f4a7c15ULL) % 1000;
+
+        auto ref = a;
+        ntt(ref, roots, mod);
+
+        auto got = a;
+        ntt(got, plan);
+        REQUIRE(got == ref);
+
+        auto legacy_mont = a;
+        ntt_montgomery(legacy_mont, roots, mod);
+        REQUIRE(legacy_mont == ref);
+
+        Montgomery M(mod);
+        auto core = a, mroots = roots;
+        for (auto& x : core) x = M.to_mont(x);
+        for (auto& w : mroots) w = M.to_mont(w);
+        ntt_montgomery_core(core, mroots, mod);
+        for (auto& x : core) x = M.from_mont(x);
+        REQUIRE(core == ref);
+
+        intt(got, plan);
+        REQUIRE(got == a);
+    }
+}
+
+TEST_CASE("AVX2 kernels match the scalar kernels", "[ntt][avx2]") {
+    for (u64 mod : {u64(2013265921), u64(1152921504606584833ULL)}) {
+        const size_t n = 1024;
+        u64 g = 2;
+        while (mod_pow(g, (mod - 1) / 2, mod) != mod - 1) ++g;
+        u64 root_n = mod_pow(g, (mod - 1) / n, mod);
+        NttPlan plan(n, mod, root_n);
+        NttPlan scalar_plan = plan;
+        scalar_plan.use_avx2 = false;
+        std::vector<u64> a(n);
+        for (size_t i = 0; i < n; ++i) a[i] = (mod - 1) - (i * i * 2654435761ULL) % mod;
+
+        auto vec = a, ref = a;
+        ntt(vec, plan);
+        ntt(ref, scalar_plan);
+        REQUIRE(vec == ref);
+        intt(vec, plan);
+        REQUIRE(vec == a);
+
+        Montgomery M(mod);
+        auto mroots = compute_roots(root_n, n, mod);
+        for (auto& w : mroots) w = M.to_mont(w);
+        auto core = a, avx = a;
+        ntt_montgomery_core(core, mroots, mod);
+        ntt_avx2_core(avx, mroots, mod);
+        REQUIRE(avx == core);
+    }
+}
+
+TEST_CASE("Negacyclic transforms multiply in Z_q[X]/(X^n+1)", "[ntt][negacyclic]") {
+    for (u64 mod : {u64(2013265921), u64(1152921504606584833ULL)}) {
+        for (size_t n : {size_t(2), size_t(8), size_t(64), size_t(512)}) {
+            NttPlan plan(n, mod);
+            REQUIRE(plan.has_negacyclic());
+            std::vector<u64> a(n), b(n);
+            for (size_t i = 0; i < n; ++i) {
+                a[i] = (i * 0x9e3779b97f4a7c15ULL + 1) % mod;
+                b[i] = (mod - 1) - (i * 31337) % mod;
+            }
+            // schoolbook product with X^n = -1 wrap
+            std::vector<u64> ref(n, 0);
+            for (size_t i = 0; i < n; ++i)
+                for (size_t j = 0; j < n; ++j) {
+                    u64 p = (__uint128_t)a[i] * b[j] % mod;
+                    size_t k = (i + j) % n;
+                    if (i + j < n) ref[k] = (ref[k] + p) % mod;
+                    else ref[k] = (ref[k] + mod - p) % mod;
+                }
+            REQUIRE(poly_mul_negacyclic(a, b, plan) == ref);
+
+            NttPlan scalar_plan = plan;
+            scalar_plan.use_avx2 = false;
+            REQUIRE(poly_mul_negacyclic(a, b, scalar_plan) == ref);
+
+            auto t = a;
+            ntt_negacyclic(t, plan);
+            intt_negacyclic(t, plan);
+            REQUIRE(t == a);
+        }
+    }
+}
+
+TEST_CASE("RNS multiply and CRT round trip", "[rns]") {
+    const size_t n = 16;
+    auto primes = generate_ntt_primes(50, 3, n);
+    REQUIRE(primes.size() == 3);
+    RnsBase base(n, primes);
+    REQUIRE(base.words == 3);
+
+    // decompose/compose round trip on values below Q
+    std::vector<u64> big(n * base.words);
+    for (size_t j = 0; j < n; ++j) {
+        big[j * 3 + 0] = 0x0123456789abcdefULL * (j + 1);
+        big[j * 3 + 1] = 0xfedcba9876543210ULL ^ j;
+        big[j * 3 + 2] = (j * 977) % (base.Q[2] - 1);
+    }
+    RnsPoly p(base);
+    rns_decompose(big.data(), base.words, p);
+    std::vector<u64> back;
+    rns_compose(p, back);
+    REQUIRE(back == big);
+
+    // small signed operands: the exact negacyclic product is known
+    std::vector<long long> x(n), y(n);
+    for (size_t j = 0; j < n; ++j) {
+        x[j] = (long long)(j * 7919 % 1000) - 500;
+        y[j] = (long long)(j * 104729 % 1000) - 300;
+    }
+    RnsPoly a(base), b(base), c(base);
+    for (size_t i = 0; i < base.size(); ++i) {
+        u64 q = base.moduli[i];
+        for (size_t j = 0; j < n; ++j) {
+            a.limb(i)[j] = x[j] < 0 ? q - (u64)(-x[j]) : (u64)x[j];
+            b.limb(i)[j] = y[j] < 0 ? q - (u64)(-y[j]) : (u64)y[j];
+        }
+    }
+    rns_multiply(a, b, c);
+    std::vector<u64> got;
+    rns_compose(c, got);
+    for (size_t k = 0; k < n; ++k) {
+        long long v = 0;
+        for (size_t i = 0; i < n; ++i) {
+            size_t j = (k + n - i) % n;
+            long long t = x[i] * y[j];
+            v += (i <= k) ? t : -t;
+        }
+        if (v >= 0) {
+            REQUIRE(got[k * 3] == (u64)v);
+            REQUIRE(got[k * 3 + 1] == 0);
+            REQUIRE(got[k * 3 + 2] == 0);
+        } else {
+            // Q - |v|: the low word wraps, upper words equal Q's minus the borrow
+            REQUIRE(got[k * 3] == base.Q[0] - (u64)(-v));
+            REQUIRE(got[k * 3 + 2] == base.Q[2]);
+        }
+    }
+}
+
+TEST_CASE("poly_mul matches the naive product", "[poly]") {
+    // NTT-friendly primes plus a non-prime modulus that forces Karatsuba
+    const u64 mods[] = {2013265921ULL, 1152921504606584833ULL, 1000000000000000000ULL};
+    const size_t lens[][2] = {{1, 1}, {3, 7}, {47, 48}, {64, 64}, {100, 33}, {129, 300}, {517, 517}};
+    std::mt19937_64 rng(7);
+    for (u64 mod : mods) {
+        for (auto& l : lens) {
+            std::vector<u64> a(l[0]), b(l[1]);
+            for (auto& v : a) v = rng() % mod;
+            for (auto& v : b) v = rng() % mod;
+            auto expect = poly_mul_naive(a, b, mod);
+            REQUIRE(poly_mul(a, b, mod) == expect);
+            REQUIRE(poly_mul_schoolbook(a, b, mod) == expect);
+            REQUIRE(poly_mul_karatsuba(a, b, mod) == expect);
+            REQUIRE(poly_mul_ntt(a, b, mod) == expect);
+        }
+    }
+    REQUIRE(poly_mul({}, {1, 2}, 17).empty());
+}
+
+TEST_CASE("Threaded transforms match the serial ones bit for bit", "[ntt][parallel]") {
+    const u64 mod = 1152921504606584833ULL;
+    std::mt19937_64 rng(11);
+    for (size_t threads : {size_t(1), size_t(3), size_t(4)}) {
+        ThreadPool pool(threads);
+        REQUIRE(pool.size() == threads);
+        for (size_t n : {size_t(64), size_t(4096), size_t(16384)}) {
+            NttPlan plan(n, mod);
+            for (bool avx2 : {false, true}) {
+                plan.use_avx2 = avx2 && cpu_has_avx2();
+                std::vector<u64> a(n);
+                for (auto& v : a) v = rng() % mod;
+                std::vector<u64> ref = a, par = a;
+                ntt_negacyclic(ref, plan);
+                ntt_negacyclic(par, plan, pool);
+                REQUIRE(par == ref);
+                intt_negacyclic(ref, plan);
+                intt_negacyclic(par, plan, pool);
+                REQUIRE(par == ref);
+                REQUIRE(par == a);
+            }
+        }
+
+        // batch of polynomials, and RNS limbs with fewer and more limbs than threads
+        size_t n = 4096, count = 5;
+        NttPlan plan(n, mod);
+        std::vector<u64> batch(count * n), ref;
+        for (auto& v : batch) v = rng() % mod;
+        ref = batch;
+        for (size_t i = 0; i < count; ++i) ntt_negacyclic(ref.data() + i * n, n, plan);
+        ntt_negacyclic_batch(batch.data(), count, plan, pool);
+        REQUIRE(batch == ref);
+        intt_negacyclic_batch(batch.data(), count, plan, pool);
+        for (size_t i = 0; i < count; ++i) intt_negacyclic(ref.data() + i * n, n, plan);
+        REQUIRE(batch == ref);
+
+        for (size_t L : {size_t(2), size_t(5)}) {
+            RnsBase base(n, generate_ntt_primes(50, L, n));
+            RnsPoly x(base);
+            for (auto& v : x.data) v = rng() % (1ULL << 49);
+            RnsPoly y = x;
+            rns_ntt(x);
+            rns_ntt(y, pool);
+            REQUIRE(x.data == y.data);
+            rns_intt(x);
+            rns_intt(y, pool);
+            REQUIRE(x.data == y.data);
+        }
+    }
+}
+
+TEST_CASE("Cache-blocked transforms match the unblocked ones", "[ntt][blocked]") {
+    // n >= 2^17 takes the blocked path; the legacy root-vector transform and
+    // the range-split threaded transform are unblocked references
+    const size_t n = size_t(1) << 18;
+    const u64 mod = generate_ntt_primes(50, 1, n)[0];
+    NttPlan plan(n, mod);
+    ThreadPool pool(2);
+    std::mt19937_64 rng(5);
+    std::vector<u64> a(n);
+    for (auto& v : a) v = rng() % mod;
+    auto roots = compute_roots(plan.root, n, mod);
+    std::vector<u64> legacy = a;
+    ntt(legacy, roots, mod);
+    // the default shape, the tuner's candidates and the smallest tile
+    const size_t shapes[][2] = {{4096, 4}, {2048, 2}, {8192, 3}, {64, 1}};
+    for (const auto& shape : shapes) {
+        for (bool avx2 : {false, true}) {
+            plan.use_avx2 = avx2 && cpu_has_avx2();
+            plan.blocked = true;
+            plan.blocked_tile = shape[0];
+            plan.blocked_group = shape[1];
+            std::vector<u64> x = a;
+            ntt(x, plan);
+            REQUIRE(x == legacy);
+            intt(x, plan);
+            REQUIRE(x == a);
+            ntt_to_bitrev(x, plan);
+            std::vector<u64> y = x;
+            bit_reverse_permute(y);
+            REQUIRE(y == legacy);
+            intt_from_bitrev(x, plan);
+            REQUIRE(x == a);
+
+            std::vector<u64> ref = a;
+            x = a;
+            ntt_negacyclic(x, plan);
+            ntt_negacyclic(ref, plan, pool);
+            REQUIRE(x == ref);
+            intt_negacyclic(x, plan);
+            intt_negacyclic(ref, plan, pool);
+            REQUIRE(x == ref);
+            REQUIRE(x == a);
+        }
+    }
+}
+
+TEST_CASE("Permutation-free cyclic pair and blocked bit reversal", "[ntt][bitrev]") {
+    std::mt19937_64 rng(9);
+    for (size_t n : {size_t(2), size_t(4), size_t(256), size_t(1024), size_t(8192)}) {
+        // blocked permutation against the index definition
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < n) ++bits;
+        std::vector<u64> idx(n);
+        for (size_t i = 0; i < n; ++i) idx[i] = i;
+        bit_reverse_permute(idx);
+        for (size_t i = 0; i < n; ++i) {
+            size_t r = 0;
+            for (unsigned b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+            REQUIRE(idx[i] == r);
+        }
+
+        for (u64 mod : {u64(2013265921), u64(1152921504606584833ULL)}) {
+            NttPlan plan(n, mod);
+            for (bool avx2 : {false, true}) {
+                plan.use_avx2 = avx2 && cpu_has_avx2();
+                std::vector<u64> a(n);
+                for (auto& v : a) v = rng() % mod;
+                std::vector<u64> ref = a, x = a;
+                ntt(ref, plan);
+                ntt_to_bitrev(x, plan);
+                std::vector<u64> y = x;
+                bit_reverse_permute(y);
+                REQUIRE(y == ref);
+                intt_from_bitrev(x, plan);
+                REQUIRE(x == a);
+            }
+        }
+    }
+}
+
+TEST_CASE("32-bit storage path matches the 64-bit transforms", "[ntt][narrow]") {
+    std::mt19937_64 rng(13);
+    REQUIRE_FALSE(NttPlan(16, 1152921504606584833ULL).narrow);
+    for (size_t n : {size_t(2), size_t(8), size_t(16), size_t(32), size_t(1024), size_t(8192)}) {
+        for (u64 mod : {u64(2013265921), u64(998244353), u64(12289)}) {
+            if ((mod - 1) % (2 * n) != 0) continue;
+            NttPlan plan(n, mod);
+            REQUIRE(plan.narrow);
+            for (bool avx2 : {false, true}) {
+                plan.use_avx2 = avx2 && cpu_has_avx2();
+                std::vector<u64> a(n);
+                for (auto& v : a) v = rng() % mod;
+                std::vector<u32> a32(a.begin(), a.end());
+
+                std::vector<u64> r = a;
+                std::vector<u32> x = a32;
+                ntt_to_bitrev(r, plan);
+                ntt_to_bitrev(x, plan);
+                REQUIRE(std::vector<u64>(x.begin(), x.end()) == r);
+                intt_from_bitrev(x, plan);
+                REQUIRE(x == a32);
+
+                r = a;
+                x = a32;
+                ntt_negacyclic(r, plan);
+                ntt_negacyclic(x, plan);
+                REQUIRE(std::vector<u64>(x.begin(), x.end()) == r);
+                intt_negacyclic(x, plan);
+                REQUIRE(x == a32);
+            }
+        }
+    }
+}
+
+TEST_CASE("Pointer API on arena buffers matches the vector API", "[ntt][arena]") {
+    std::mt19937_64 rng(17);
+    PolyArena arena(1 << 12);
+
+    // buffers are cache-line aligned and recycled without new slabs
+    u64* p = arena.acquire(100);
+    REQUIRE(reinterpret_cast<uintptr_t>(p) % 64 == 0);
+    arena.release(p, 100);
+    REQUIRE(arena.acquire(100) == p);
+    arena.release(p, 100);
+    size_t slabs = arena.slab_count();
+    for (int it = 0; it < 100; ++it) {
+        PolyBuf x(arena, 1000), y(arena, 1000);
+        REQUIRE(x.data() != y.data());
+    }
+    REQUIRE(arena.slab_count() == slabs);
+    // a buffer larger than a slab gets its own, and the current slab's
+    // remaining space still serves the next small request
+    PolyBuf small(arena, 64);
+    PolyBuf big(arena, 1 << 13);
+    REQUIRE(reinterpret_cast<uintptr_t>(big.data()) % 64 == 0);
+    REQUIRE(arena.slab_count() == slabs + 1);
+    PolyBuf after(arena, 64);
+    REQUIRE(after.data() == small.data() + 64);
+    REQUIRE(arena.slab_count() == slabs + 1);
+
+    const size_t n = 1024;
+    const u64 mod = generate_ntt_primes(60, 1, n)[0];
+    NttPlan plan(n, mod);
+    std::vector<u64> a(n), b(n);
+    for (auto& v : a) v = rng() % mod;
+    for (auto& v : b) v = rng() % mod;
+    PolyBuf x(arena, n), y(arena, n), t(arena, n);
+    std::copy(a.begin(), a.end(), x.data());
+
+    std::vector<u64> r = a;
+    ntt(r, plan);
+    ntt(x.data(), n, plan);
+    REQUIRE(std::vector<u64>(x.data(), x.data() + n) == r);
+    intt(r, plan);
+    intt(x.data(), n, plan);
+    REQUIRE(std::vector<u64>(x.data(), x.data() + n) == a);
+    r = a;
+    ntt_montgomery(r, plan);
+    ntt_montgomery(x.data(), n, plan);
+    REQUIRE(std::vector<u64>(x.data(), x.data() + n) == r);
+
+    // negacyclic product, including out aliasing an operand
+    std::vector<u64> want = poly_mul_negacyclic(a, b, plan);
+    std::copy(a.begin(), a.end(), x.data());
+    std::copy(b.begin(), b.end(), y.data());
+    poly_mul_negacyclic(x.data(), y.data(), y.data(), t.data(), plan);
+    REQUIRE(std::vector<u64>(y.data(), y.data() + n) == want);
+
+    // RNS ops on a limb buffer agree with the RnsPoly forms
+    RnsBase base(256, generate_ntt_primes(50, 3, 256));
+    const size_t words = base.size() * base.n;
+    RnsPoly pa(base), pb(base), pc(base);
+    for (auto& v : pa.data) v = rng() % base.moduli[0] % base.moduli[1] % base.moduli[2];
+    for (auto& v : pb.data) v = rng() % base.moduli[0] % base.moduli[1] % base.moduli[2];
+    PolyBuf la(arena, words), lb(arena, words), lt(arena, words);
+    std::copy(pa.data.begin(), pa.data.end(), la.data());
+    std::copy(pb.data.begin(), pb.data.end(), lb.data());
+    rns_multiply(pa, pb, pc);
+    rns_multiply(base, la.data(), lb.data(), la.data(), lt.data());
+    REQUIRE(std::vector<u64>(la.data(), la.data() + words) == std::vector<u64>(pc.data.begin(), pc.data.end()));
+    rns_sub(pc, pb, pc);
+    rns_sub(base, la.data(), lb.data(), la.data());
+    REQUIRE(std::vector<u64>(la.data(), la.data() + words) == std::vector<u64>(pc.data.begin(), pc.data.end()));
+}
+
+TEST_CASE("Interleaved batch transforms match per-polynomial ones", "[ntt][batch]") {
+    std::mt19937_64 rng(19);
+    const size_t count = 5;  // one full group and one padded group
+    for (size_t n : {size_t(2), size_t(4), size_t(64), size_t(2048)}) {
+        const u64 mod = generate_ntt_primes(60, 1, n)[0];
+        NttPlan plan(n, mod);
+        for (bool avx2 : {false, true}) {
+            plan.use_avx2 = avx2 && cpu_has_avx2();
+            std::vector<u64> a(count * n);
+            for (auto& v : a) v = rng() % mod;
+            std::vector<u64> il(batch_interleaved_words(count, n)), back(count * n);
+            const size_t groups = il.size() / (NTT_BATCH_LANES * n);
+            batch_interleave(a.data(), count, n, il.data());
+            batch_deinterleave(il.data(), count, n, back.data());
+            REQUIRE(back == a);
+            // lane-pointer forms, padding included
+            std::vector<const u64*> in(count);
+            std::vector<u64*> out(count);
+            for (size_t i = 0; i < count; ++i) {
+                in[i] = a.data() + i * n;
+                out[i] = back.data() + i * n;
+            }
+            std::vector<u64> il2(il.size(), 1);
+            batch_interleave(in.data(), count, n, il2.data());
+            REQUIRE(il2 == il);
+            std::fill(back.begin(), back.end(), 0);
+            batch_deinterleave(il2.data(), count, n, out.data());
+            REQUIRE(back == a);
+
+            std::vector<u64> r = a;
+            ntt_negacyclic_batch(r.data(), count, plan);
+            ntt_negacyclic_interleaved(il.data(), groups, plan);
+            batch_deinterleave(il.data(), count, n, back.data());
+            REQUIRE(back == r);
+            intt_negacyclic_interleaved(il.data(), groups, plan);
+            batch_deinterleave(il.data(), count, n, back.data());
+            REQUIRE(back == a);
+
+            r = a;
+            for (size_t i = 0; i < count; ++i) ntt_to_bitrev(r.data() + i * n, n, plan);
+            batch_interleave(a.data(), count, n, il.data());
+            ntt_to_bitrev_interleaved(il.data(), groups, plan);
+            batch_deinterleave(il.data(), count, n, back.data());
+            REQUIRE(back == r);
+            intt_from_bitrev_interleaved(il.data(), groups, plan);
+            batch_deinterleave(il.data(), count, n, back.data());
+            REQUIRE(back == a);
+        }
+    }
+}
+
+TEST_CASE("Specialized fixed-parameter transforms match the plan", "[ntt][fixed]") {
+    std::mt19937_64 rng(23);
+    using N12 = Ntt<1152921504606748673ULL, 12>;
+    static_assert(N12::psi != 0 && N12::tables.fwd[0] == 1, "compile-time tables");
+    REQUIRE(N12::psi == find_root_of_unity(2 * N12::n, N12::mod));
+
+    const u64 q1 = 1152921504606748673ULL, q2 = 1152921504606683137ULL;
+    for (size_t n : {size_t(4096), size_t(8192), size_t(16384)}) {
+        for (u64 mod : {q1, q2}) {
+            const FixedNtt* f = find_fixed_ntt(n, mod);
+            REQUIRE(f != nullptr);
+            const NttPlan& plan = *cached_plan(n, mod);
+            std::vector<u64> a(n);
+            for (auto& v : a) v = rng() % mod;
+            std::vector<u64> r = a, x = a;
+            ntt_negacyclic(r, plan);
+            f->forward(x.data());
+            REQUIRE(x == r);
+            f->inverse(x.data());
+            REQUIRE(x == a);
+        }
+    }
+
+    // unregistered parameters fall back to the generic plan
+    const size_t n = 1024;
+    const u64 mod = generate_ntt_primes(50, 1, n)[0];
+    REQUIRE(find_fixed_ntt(n, mod) == nullptr);
+    REQUIRE(find_fixed_ntt(2048, q1) == nullptr);
+    std::vector<u64> a(n);
+    for (auto& v : a) v = rng() % mod;
+    std::vector<u64> r = a, x = a;
+    ntt_negacyclic(r, *cached_plan(n, mod));
+    ntt_negacyclic(x.data(), n, mod);
+    REQUIRE(x == r);
+    intt_negacyclic(x.data(), n, mod);
+    REQUIRE(x == a);
+
+    // RNS limbs over registered primes take the specialized kernels
+    RnsBase base(4096, {q1, q2});
+    REQUIRE(base.fixed[0] != nullptr);
+    REQUIRE(base.fixed[1] != nullptr);
+    RnsPoly pa(base), pb(base), pc(base);
+    for (auto& v : pa.data) v = rng() % q2;
+    for (auto& v : pb.data) v = rng() % q2;
+    rns_multiply(pa, pb, pc);
+    for (size_t i = 0; i < base.size(); ++i) {
+        std::vector<u64> xa(pa.limb(i), pa.limb(i) + 4096), xb(pb.limb(i), pb.limb(i) + 4096);
+        std::vector<u64> want = poly_mul_negacyclic(xa, xb, base.plans[i]);
+        REQUIRE(std::vector<u64>(pc.limb(i), pc.limb(i) + 4096) == want);
+    }
+}
+
+TEST_CASE("Pointwise array ops match scalar modular arithmetic", "[mod_arith]") {
+    std::mt19937_64 rng(29);
+    // includes the largest supported modulus, a power of two and a tail of
+    // n % 4 != 0 elements
+    for (u64 mod : {u64(3), u64(12289), u64(1) << 40, u64(2013265921), u64(1152921504606584833ULL),
+                    (u64(1) << 62) - 57}) {
+        const size_t n = 1027;
+        std::vector<u64> a(n), b(n), acc(n);
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = rng() % mod;
+            b[i] = rng() % mod;
+            acc[i] = rng() % mod;
+        }
+        a[0] = 0;
+        b[1] = 0;
+        a[2] = b[2] = mod - 1;
+        const u64 c = rng() % mod;
+        const Barrett bar(mod);
+        std::vector<u64> out(n);
+
+        add_mod_array(a.data(), b.data(), out.data(), n, mod);
+        for (size_t i = 0; i < n; ++i) REQUIRE(out[i] == add_mod(a[i], b[i], mod));
+        sub_mod_array(a.data(), b.data(), out.data(), n, mod);
+        for (size_t i = 0; i < n; ++i) REQUIRE(out[i] == sub_mod(a[i], b[i], mod));
+        negate_mod_array(a.data(), out.data(), n, mod);
+        for (size_t i = 0; i < n; ++i) REQUIRE(out[i] == sub_mod(0, a[i], mod));
+        mul_scalar_mod_array(a.data(), c, out.data(), n, mod);
+        for (size_t i = 0; i < n; ++i) REQUIRE(out[i] == mul_mod(a[i], c, mod));
+        mul_mod_array(a.data(), b.data(), out.data(), n, mod);
+        for (size_t i = 0; i < n; ++i) {
+            REQUIRE(out[i] == mul_mod(a[i], b[i], mod));
+            REQUIRE(bar.mul(a[i], b[i]) == out[i]);
+        }
+        out = acc;
+        fma_mod_array(a.data(), b.data(), out.data(), n, mod);
+        for (size_t i = 0; i < n; ++i) REQUIRE(out[i] == add_mod(acc[i], mul_mod(a[i], b[i], mod), mod));
+        out = acc;
+        fma_scalar_mod_array(a.data(), c, out.data(), n, mod);
+        for (size_t i = 0; i < n; ++i) REQUIRE(out[i] == add_mod(acc[i], mul_mod(a[i], c, mod), mod));
+
+        // in place
+        out = a;
+        mul_mod_array(out.data(), out.data(), out.data(), n, mod);
+        for (size_t i = 0; i < n; ++i) REQUIRE(out[i] == mul_mod(a[i], a[i], mod));
+
+        if (mod < (u64(1) << 31)) {
+            std::vector<u32> a32(a.begin(), a.end()), b32(b.begin(), b.end()), o32(n);
+            mul_mod_array(a32.data(), b32.data(), o32.data(), n, (u32)mod);
+            for (size_t i = 0; i < n; ++i) REQUIRE(o32[i] == mul_mod(a[i], b[i], mod));
+        }
+    }
+    // wrap-around in the scalar helper
+    const u64 big = ~u64(0) - 58;  // 2^64 - 59
+    REQUIRE(add_mod(big - 1, big - 2, big) == big - 3);
+}
+
+TEST_CASE("Fused inner and tensor products match composed multiplies", "[rns][fused]") {
+    std::mt19937_64 rng(31);
+    const size_t n = 64;
+    // 62-bit primes put the 128-bit accumulators closest to overflow
+    RnsBase base(n, generate_ntt_primes(62, 2, n));
+    auto random_poly = [&]() {
+        RnsPoly p(base);
+        for (size_t i = 0; i < base.size(); ++i)
+            for (size_t j = 0; j < n; ++j) p.limb(i)[j] = rng() % base.moduli[i];
+        return p;
+    };
+
+    // 20 terms cross the fold point of the accumulators
+    const size_t count = 20;
+    std::vector<RnsPoly> a, b;
+    for (size_t k = 0; k < count; ++k) {
+        a.push_back(random_poly());
+        b.push_back(random_poly());
+    }
+    RnsPoly expect(base), prod(base);
+    for (size_t k = 0; k < count; ++k) {
+        rns_multiply(a[k], b[k], prod);
+        if (k == 0) expect = prod;
+        else rns_add(expect, prod, expect);
+    }
+    RnsPoly got;
+    rns_inner_product(a, b, got);
+    REQUIRE(!got.ntt_form);
+    REQUIRE(got.data == expect.data);
+
+    // NTT-form inputs stay in NTT form
+    std::vector<RnsPoly> an(a), bn(b);
+    for (size_t k = 0; k < count; ++k) {
+        rns_ntt(an[k]);
+        rns_ntt(bn[k]);
+    }
+    rns_inner_product(an, bn, got);
+    REQUIRE(got.ntt_form);
+    rns_intt(got);
+    REQUIRE(got.data == expect.data);
+
+    RnsPoly c0, c1, c2, t;
+    rns_tensor(a[0], a[1], b[0], b[1], c0, c1, c2);
+    RnsPoly e0(base), e1(base), e2(base);
+    rns_multiply(a[0], b[0], e0);
+    rns_multiply(a[0], b[1], e1);
+    rns_multiply(a[1], b[0], t);
+    rns_add(e1, t, e1);
+    rns_multiply(a[1], b[1], e2);
+    REQUIRE(c0.data == e0.data);
+    REQUIRE(c1.data == e1.data);
+    REQUIRE(c2.data == e2.data);
+
+    rns_tensor(an[0], an[1], bn[0], bn[1], c0, c1, c2);
+    REQUIRE(c1.ntt_form);
+    rns_intt(c0);
+    rns_intt(c1);
+    rns_intt(c2);
+    REQUIRE(c0.data == e0.data);
+    REQUIRE(c1.data == e1.data);
+    REQUIRE(c2.data == e2.data);
+
+    // buffer form with the outputs written over the operands
+    aligned_vector<u64> scratch(4 * n);
+    RnsPoly x0 = a[0], x1 = a[1];
+    rns_tensor(base, x0.data.data(), x1.data.data(), b[0].data.data(), b[1].data.data(), false,
+               x0.data.data(), x1.data.data(), t.data.data(), scratch.data());
+    REQUIRE(x0.data == e0.data);
+    REQUIRE(x1.data == e1.data);
+    REQUIRE(t.data == e2.data);
+}
+
+TEST_CASE("Profiling probes attribute time to stages", "[profile]") {
+    profile_reset();
+    const size_t n = 1024;
+    NttPlan plan(n, 1152921504606584833ULL);
+    std::vector<u64> a(n, 3);
+    ntt(a, plan);
+    ntt_negacyclic(a, plan);
+    intt_negacyclic(a, plan);
+    std::vector<ProfileStats> st = profile_stats();
+    if (!profile_compiled_in()) {
+        REQUIRE(st.empty());
+        REQUIRE(!profile_set_counters(true));
+        return;
+    }
+    auto calls = [&](const std::string& name) -> u64 {
+        for (const ProfileStats& s : st)
+            if (name == s.stage) return s.calls;
+        return 0;
+    };
+    REQUIRE(calls("ntt") == 1);
+    REQUIRE(calls("ntt_negacyclic") == 1);
+    REQUIRE(calls("intt_negacyclic") == 1);
+    REQUIRE(calls("bit_reverse") == 1);
+    REQUIRE(calls("butterflies") == 3);
+    REQUIRE(calls("final_reduce") == 2);
+    // a radix-4 pass counts under its first layer: every transform starts a
+    // pass at each even layer, odd layers are recorded only by radix-2 drivers
+    for (unsigned k = 0; k < 10; k += 2) REQUIRE(calls("layer " + std::to_string(k)) == 3);
+    for (unsigned k = 1; k < 10; k += 2) REQUIRE(calls("layer " + std::to_string(k)) <= 3);
+    REQUIRE(calls("layer 9") >= 1);  // folded last inverse stage
+    REQUIRE(calls("layer 10") == 0);
+
+    // counters are best effort: perf_event_open may be refused
+    if (profile_set_counters(true)) {
+        profile_reset();
+        ntt(a, plan);
+        for (const ProfileStats& s : profile_stats()) REQUIRE(s.cycles > 0);
+        profile_set_counters(false);
+    }
+    profile_reset();
+    REQUIRE(profile_stats().empty());
+}
+
+TEST_CASE("Galois automorphisms in both domains", "[galois]") {
+    std::mt19937_64 rng(37);
+    for (size_t n : {8u, 64u, 1024u}) {
+        const u64 q = generate_ntt_primes(50, 1, n)[0];
+        NttPlan plan(n, q);
+        std::vector<u64> a(n);
+        for (u64& x : a) x = rng() % q;
+
+        // direct definition: coefficient i goes to i*k mod 2n, negated past n
+        auto naive = [&](const std::vector<u64>& p, size_t k) {
+            std::vector<u64> r(n, 0);
+            for (size_t i = 0; i < n; ++i) {
+                size_t e = i * k % (2 * n);
+                r[e % n] = e < n ? p[i] : (q - p[i]) % q;
+            }
+            return r;
+        };
+
+        for (size_t k : {galois_element(n, 1), galois_element(n, -1), galois_element(n, 3), galois_conjugate(n),
+                         size_t(1)}) {
+            std::vector<u64> expect = naive(a, k), got(n);
+            automorphism_coeff(a.data(), got.data(), n, k, q);
+            REQUIRE(got == expect);
+            got = a;
+            automorphism_coeff(got.data(), n, k, q);
+            REQUIRE(got == expect);
+
+            // the evaluation-domain permutation commutes with the transform
+            std::vector<u64> A = a, E = expect;
+            ntt_negacyclic(A, plan);
+            ntt_negacyclic(E, plan);
+            std::vector<u64> P(n);
+            automorphism_ntt(A.data(), P.data(), n, k);
+            REQUIRE(P == E);
+            automorphism_ntt(A.data(), n, k);
+            REQUIRE(A == E);
+        }
+
+        // rotations compose: sigma_{5^1} sigma_{5^2} = sigma_{5^3}, and a full
+        // turn of n/2 steps is the identity
+        std::vector<u64> x = a, y(n);
+        automorphism_coeff(x.data(), n, galois_element(n, 1), q);
+        automorphism_coeff(x.data(), n, galois_element(n, 2), q);
+        automorphism_coeff(a.data(), y.data(), n, galois_element(n, 3), q);
+        REQUIRE(x == y);
+        REQUIRE(galois_element(n, (long long)n / 2) == 1);
+        REQUIRE(galois_element(n, -1) * galois_element(n, 1) % (2 * n) == 1);
+    }
+
+    // RNS: both forms, in place and out of place, agree through the transform
+    const size_t n = 256;
+    RnsBase base(n, generate_ntt_primes(60, 3, n));
+    RnsPoly p(base);
+    for (size_t i = 0; i < base.size(); ++i)
+        for (size_t j = 0; j < n; ++j) p.limb(i)[j] = rng() % base.moduli[i];
+    const size_t k = galois_element(n, 5);
+    RnsPoly c = p, e = p, out(base);
+    rns_automorphism(c, k);
+    rns_ntt(e);
+    rns_automorphism(base, e.data.data(), true, k, out.data.data());
+    rns_automorphism(e, k);
+    REQUIRE(out.data == e.data);
+    rns_intt(e);
+    REQUIRE(e.data == c.data);
+}
+
+TEST_CASE("Plan files round trip and back the plan cache", "[plan_file]") {
+    const char* path = "he_plan_file_test.bin";
+    const size_t n = 1024;
+    // 41-bit primes are not used by the other tests, so the cache is empty for them
+    std::vector<u64> primes = generate_ntt_primes(41, 2, n);
+    const u64 narrow_q = 2013265921;
+    // 12289 has no 2n-th root at n = 4096: a narrow plan without negacyclic tables
+    std::vector<std::pair<size_t, u64>> params = {{n, primes[0]}, {n, primes[1]}, {n / 2, primes[0]}, {n, narrow_q},
+                                                  {4096, 12289}};
+    REQUIRE(write_plan_file(path, params));
+
+    PlanFile f;
+    REQUIRE(f.open(path));
+    REQUIRE(f.size() == params.size());
+    REQUIRE(f.find(n, narrow_q) == 3);
+    REQUIRE(f.find(2 * n, narrow_q) == f.size());
+
+    std::mt19937_64 rng(41);
+    for (const auto& nq : params) {
+        NttPlan built(nq.first, nq.second), mapped;
+        f.get(f.find(nq.first, nq.second), mapped);
+        REQUIRE(mapped.has_negacyclic() == built.has_negacyclic());
+        REQUIRE(mapped.narrow == built.narrow);
+        REQUIRE(reinterpret_cast<uintptr_t>(mapped.fwd_tw.data()) % 64 == 0);
+
+        std::vector<u64> a(nq.first);
+        for (u64& x : a) x = rng() % nq.second;
+        std::vector<u64> x = a, y = a;
+        ntt(x, built);
+        ntt(y, mapped);
+        REQUIRE(x == y);
+        if (mapped.narrow) {
+            std::vector<u32> a32(a.begin(), a.end()), b32 = a32;
+            ntt_to_bitrev(a32.data(), nq.first, built);
+            ntt_to_bitrev(b32.data(), nq.first, mapped);
+            REQUIRE(a32 == b32);
+        }
+        if (!built.has_negacyclic()) {
+            REQUIRE(mapped.nega_fwd_tw.empty());
+            REQUIRE(mapped.nega_fwd_tw32.empty());
+            continue;
+        }
+        REQUIRE(mapped.nega_fwd_tw.is_view());
+        REQUIRE(std::equal(built.nega_inv_tw_shoup.data(), built.nega_inv_tw_shoup.data() + nq.first,
+                           mapped.nega_inv_tw_shoup.data()));
+        x = a;
+        y = a;
+        ntt_negacyclic(x, built);
+        ntt_negacyclic(y, mapped);
+        REQUIRE(x == y);
+        intt_negacyclic(y, mapped);
+        REQUIRE(y == a);
+        if (mapped.narrow) {
+            std::vector<u32> a32(a.begin(), a.end()), b32 = a32;
+            ntt_negacyclic(a32, built);
+            ntt_negacyclic(b32, mapped);
+            REQUIRE(a32 == b32);
+        }
+    }
+    f.close();
+
+    // preloading serves cached_plan and RnsBase from the mapping
+    REQUIRE(preload_plan_file(path) == params.size());
+    REQUIRE(preload_plan_file(path) == 0);
+    const NttPlan* p = cached_plan(n, primes[1]);
+    REQUIRE(p);
+    REQUIRE(p->fwd_tw.is_view());
+    RnsBase base(n, {primes[0], primes[1]});
+    REQUIRE(base.plans[1].nega_fwd_tw.data() == p->nega_fwd_tw.data());
+
+    // plans are built outside the cache lock; racing first lookups of one
+    // key still all get the same plan
+    const u64 fresh = generate_ntt_primes(39, 1, n)[0];
+    std::vector<const NttPlan*> got(4);
+    std::vector<std::thread> lookups;
+    for (size_t t = 0; t < got.size(); ++t) lookups.emplace_back([&, t] { got[t] = cached_plan(n, fresh); });
+    for (auto& t : lookups) t.join();
+    REQUIRE(got[0] != nullptr);
+    for (const NttPlan* g : got) REQUIRE(g == got[0]);
+
+    // files from another format version are rejected (a separate file: the
+    // preloaded one stays mapped)
+    const char* stale = "he_plan_file_stale.bin";
+    REQUIRE(write_plan_file(stale, {{n / 2, primes[0]}}));
+    {
+        FILE* w = fopen(stale, "r+b");
+        REQUIRE(w);
+        u32 v = PLAN_FILE_VERSION + 1;
+        fseek(w, 8, SEEK_SET);
+        fwrite(&v, sizeof v, 1, w);
+        fclose(w);
+    }
+    REQUIRE(!f.open(stale));
+    REQUIRE(!f.is_open());
+    REQUIRE(!f.open("no_such_plan_file.bin"));
+    // so are entries with an unusable modulus (0, even) or unreduced root;
+    // the first entry follows the 64-byte header: n, mod, root, psi
+    for (auto patch : {std::make_pair(8, u64(0)), std::make_pair(8, primes[0] + 1),
+                       std::make_pair(16, primes[0])}) {
+        REQUIRE(write_plan_file(stale, {{n / 2, primes[0]}}));
+        REQUIRE(f.open(stale));
+        f.close();
+        FILE* w = fopen(stale, "r+b");
+        REQUIRE(w);
+        fseek(w, 64 + patch.first, SEEK_SET);
+        fwrite(&patch.second, sizeof(u64), 1, w);
+        fclose(w);
+        REQUIRE(!f.open(stale));
+    }
+    // a file whose plans are all cached already is not kept mapped
+    REQUIRE(write_plan_file(stale, {{n / 2, primes[0]}}));
+    REQUIRE(preload_plan_file(stale) == 0);
+    std::remove(stale);
+    std::remove(path);
+}
+
+TEST_CASE("Bit-packed serialization round trips", "[serialize]") {
+    std::mt19937_64 rng(43);
+    // reference packer: one bit at a time
+    auto naive_pack = [](const std::vector<u64>& v, unsigned bits) {
+        std::vector<uint8_t> out(packed_bytes(v.size(), bits), 0);
+        for (size_t i = 0; i < v.size(); ++i)
+            for (unsigned b = 0; b < bits; ++b)
+                if ((v[i] >> b) & 1) out[(i * bits + b) / 8] |= uint8_t(1u << ((i * bits + b) % 8));
+        return out;
+    };
+    for (unsigned bits = 1; bits <= 64; ++bits) {
+        for (size_t count : {0u, 1u, 7u, 8u, 9u, 63u, 200u}) {
+            std::vector<u64> v(count);
+            for (u64& x : v) x = bits == 64 ? rng() : rng() & ((u64(1) << bits) - 1);
+            std::vector<uint8_t> packed(packed_bytes(count, bits));
+            pack_bits(v.data(), count, bits, packed.data());
+            REQUIRE(packed == naive_pack(v, bits));
+            std::vector<u64> back(count);
+            unpack_bits(packed.data(), count, bits, back.data());
+            REQUIRE(back == v);
+        }
+    }
+    REQUIRE(coeff_bits(2) == 1);
+    REQUIRE(coeff_bits(2013265921) == 31);
+    REQUIRE(coeff_bits(u64(1) << 40) == 40);
+    REQUIRE(coeff_bits((u64(1) << 40) + 1) == 41);
+
+    // RNS polynomial: 31- and 60-bit limbs, larger than one chunk
+    const size_t n = 8192;
+    RnsBase base(n, {generate_ntt_primes(31, 1, n)[0], generate_ntt_primes(60, 1, n)[0]});
+    RnsPoly a(base);
+    for (size_t i = 0; i < base.size(); ++i)
+        for (size_t j = 0; j < n; ++j) a.limb(i)[j] = rng() % base.moduli[i];
+    a.ntt_form = true;
+    std::vector<uint8_t> blob;
+    REQUIRE(write_poly(buffer_writer(blob), a));
+    PolyHeader h(a);
+    REQUIRE(blob.size() == h.total_bytes());
+    REQUIRE(h.payload_bytes() == n * (31 + 60) / 8);
+
+    RnsPoly b(base);
+    REQUIRE(read_poly(buffer_reader(blob.data(), blob.size()), b));
+    REQUIRE(b.ntt_form);
+    REQUIRE(b.data == a.data);
+
+    // header then data into caller storage
+    {
+        ByteReader r = buffer_reader(blob.data(), blob.size());
+        PolyHeader got;
+        REQUIRE(read_poly_header(r, got));
+        REQUIRE(got.n == n);
+        REQUIRE(got.moduli == base.moduli);
+        aligned_vector<u64> dst(base.size() * n);
+        REQUIRE(read_poly_data(r, got, dst.data()));
+        REQUIRE(dst == a.data);
+    }
+
+    // through a file descriptor
+    FILE* tmp = tmpfile();
+    REQUIRE(tmp);
+    REQUIRE(write_poly(fd_writer(fileno(tmp)), a));
+    rewind(tmp);
+    RnsPoly c(base);
+    REQUIRE(read_poly(fd_reader(fileno(tmp)), c));
+    REQUIRE(c.data == a.data);
+    fclose(tmp);
+
+    // truncated input, values out of range and a different base are rejected
+    REQUIRE(!read_poly(buffer_reader(blob.data(), blob.size() - 1), b));
+    std::vector<uint8_t> bad = blob;
+    for (size_t k = 0; k < 4; ++k) bad[h.header_bytes() + k] = 0xff;
+    REQUIRE(!read_poly(buffer_reader(bad.data(), bad.size()), b));
+    RnsBase other(n, {base.moduli[1], base.moduli[0]});
+    RnsPoly d(other);
+    REQUIRE(!read_poly(buffer_reader(blob.data(), blob.size()), d));
+}
+
+TEST_CASE("Radix-4 passes cover odd and even log2(n)", "[ntt][radix4]") {
+    for (u64 mod : {u64(2013265921), u64(1152921504606584833ULL)}) {
+        for (unsigned log_n = 1; log_n <= 12; ++log_n) {
+            const size_t n = size_t(1) << log_n;
+            NttPlan plan(n, mod);
+            std::vector<u64> a(n), b(n);
+            for (size_t i = 0; i < n; ++i) {
+                a[i] = (mod - 1) - (i * i * 2654435761ULL) % mod;
+                b[i] = (i * 0x9e3779b97f4a7c15ULL + 7) % mod;
+            }
+            auto roots = compute_roots(plan.root, n, mod);
+            auto ref = a;
+            ntt(ref, roots, mod);
+
+            Montgomery M(mod);
+            auto mroots = roots;
+            for (auto& w : mroots) w = M.to_mont(w);
+            auto core_in = a, core_ref = ref;
+            for (auto& x : core_in) x = M.to_mont(x);
+            for (auto& x : core_ref) x = M.to_mont(x);
+
+            std::vector<u64> naive;
+            if (n <= 256) {
+                naive.assign(n, 0);
+                for (size_t i = 0; i < n; ++i)
+                    for (size_t j = 0; j < n; ++j) {
+                        u64 p = (__uint128_t)a[i] * b[j] % mod;
+                        size_t k = (i + j) % n;
+                        naive[k] = (i + j < n) ? (naive[k] + p) % mod : (naive[k] + mod - p) % mod;
+                    }
+            }
+            for (bool avx2 : {false, true}) {
+                NttPlan p = plan;
+                p.use_avx2 = avx2 && cpu_has_avx2();
+                auto got = a;
+                ntt(got, p);
+                REQUIRE(got == ref);
+                intt(got, p);
+                REQUIRE(got == a);
+
+                auto mont = a;
+                ntt_montgomery(mont, p);
+                REQUIRE(mont == ref);
+                auto legacy = a;
+                ntt_montgomery(legacy, roots, mod);
+                REQUIRE(legacy == ref);
+
+                auto t = a;
+                ntt_negacyclic(t, p);
+                intt_negacyclic(t, p);
+                REQUIRE(t == a);
+                if (!naive.empty()) REQUIRE(poly_mul_negacyclic(a, b, p) == naive);
+            }
+            auto core = core_in, avx = core_in;
+            ntt_montgomery_core(core, mroots, mod);
+            ntt_avx2_core(avx, mroots, mod);
+            REQUIRE(core == core_ref);
+            REQUIRE(avx == core_ref);
+        }
+    }
+}
+
+TEST_CASE("RNS base conversion, rescale and modulus switch", "[rns][conv]") {
+    typedef __uint128_t u128;
+    const size_t n = 1024;
+    auto primes = generate_ntt_primes(55, 7, n);
+    REQUIRE(primes.size() == 7);
+    RnsBase q_base(n, {primes[0], primes[1], primes[2], primes[3]});
+    RnsBase q_drop(n, {primes[0], primes[1], primes[2]});
+    RnsBase p_base(n, {primes[4], primes[5], primes[6]});
+
+    // 100-bit coefficients (two words), so expected values fit a u128
+    std::mt19937_64 rng(7);
+    std::vector<u64> words(2 * n);
+    std::vector<u128> x(n);
+    for (size_t j = 0; j < n; ++j) {
+        words[2 * j] = rng();
+        words[2 * j + 1] = rng() >> 28;
+        x[j] = (u128)words[2 * j + 1] << 64 | words[2 * j];
+    }
+    RnsPoly a(q_base);
+    rns_decompose(words.data(), 2, a);
+
+    // conversion gives x + e*Q mod p_j with one e in [0, L) for all p_j
+    BaseConverter conv(q_base, p_base);
+    RnsPoly b;
+    rns_base_convert(conv, a, b);
+    REQUIRE(b.base == &p_base);
+    for (size_t j = 0; j < n; ++j) {
+        bool found = false;
+        for (u64 e = 0; e < q_base.size() && !found; ++e) {
+            bool all = true;
+            for (size_t k = 0; k < p_base.size(); ++k) {
+                const u64 p = p_base.moduli[k];
+                u64 qm = 1;
+                for (u64 q : q_base.moduli) qm = (u128)qm * (q % p) % p;
+                u64 want = (u64)((x[j] % p + (u128)e * qm) % p);
+                all = all && b.limb(k)[j] == want;
+            }
+            found = all;
+        }
+        REQUIRE(found);
+    }
+
+    const u64 ql = q_base.moduli.back();
+    for (u64 t : {u64(1), u64(65537)}) {
+        RnsRescaler R(q_base, q_drop, t);
+        RnsPoly c;
+        rns_rescale(R, a, c);
+        REQUIRE(c.base == &q_drop);
+        REQUIRE(!c.ntt_form);
+        const u64 t_inv = (u64)mod_pow(ql % t, t - 2, t);  // t is prime (or 1)
+        for (size_t j = 0; j < n; ++j) {
+            // d = t * centered([x * t^{-1}]_{q_L}), k = (x - d) / q_L exactly
+            u64 r = (u64)((u128)(x[j] % ql) * mod_pow(t % ql, ql - 2, ql) % ql);
+            __int128 cen = r > ql / 2 ? (__int128)r - ql : (__int128)r;
+            __int128 d = cen * (__int128)t;
+            __int128 diff = (__int128)x[j] - d;
+            REQUIRE(diff % (__int128)ql == 0);
+            __int128 k = diff / (__int128)ql;
+            REQUIRE(k >= 0);
+            if (t == 1) REQUIRE((u128)k == (x[j] + ql / 2) / ql);  // round(x / q_L)
+            else REQUIRE((u64)(k % t) == (u64)((u128)(x[j] % t) * t_inv % t));
+            for (size_t i = 0; i < q_drop.size(); ++i) REQUIRE(c.limb(i)[j] == (u64)((u128)k % q_drop.moduli[i]));
+        }
+
+        // NTT form: same result, still in NTT form; in place works too
+        RnsPoly e = a;
+        rns_ntt(e);
+        rns_rescale(R, e, e);
+        REQUIRE(e.base == &q_drop);
+        REQUIRE(e.ntt_form);
+        rns_intt(e);
+        REQUIRE(e.data == c.data);
+    }
+}
+
+TEST_CASE("Ternary operands multiply by rotation sums", "[poly][ternary]") {
+    std::mt19937_64 rng(23);
+    // schoolbook reference in Z_q[X]/(X^n -/+ 1)
+    auto ring_mul = [](const std::vector<u64>& a, const std::vector<u64>& b, u64 q, bool cyclic) {
+        size_t n = a.size();
+        std::vector<u64> c(n, 0);
+        for (size_t i = 0; i < n; ++i)
+            for (size_t j = 0; j < n; ++j) {
+                u64 p = (u64)((__uint128_t)a[i] * b[j] % q);
+                size_t k = i + j;
+                if (k >= n && !cyclic) c[k - n] = (c[k - n] + q - p) % q;
+                else c[k % n] = (c[k % n] + p) % q;
+            }
+        return c;
+    };
+
+    for (u64 q : {u64(998244353), u64(0x3fffffffffc00001ULL)}) {
+        // any n for the kernels, including a partial AVX2 block
+        for (size_t n : {size_t(1), size_t(24), size_t(64), size_t(256)}) {
+            for (size_t h : {size_t(0), size_t(3), n / 2, n}) {
+                std::vector<int8_t> sv(n, 0);
+                for (size_t i = 0; i < h; ++i) sv[rng() % n] = (rng() & 1) ? 1 : -1;
+                TernaryPoly s;
+                REQUIRE(ternary_from_signed(sv.data(), n, s));
+                std::vector<u64> sr(n), b(n), out(n), scratch(4 * n);
+                ternary_to_residues(s, q, sr.data());
+                for (size_t j = 0; j < n; ++j) {
+                    REQUIRE(s.coeff(j) == sv[j]);
+                    REQUIRE(sr[j] == (sv[j] < 0 ? q - 1 : (u64)sv[j]));
+                    b[j] = rng() % q;
+                }
+                for (bool cyclic : {false, true}) {
+                    auto ref = ring_mul(sr, b, q, cyclic);
+                    if (cyclic) poly_mul_ternary_cyclic(s, b.data(), out.data(), scratch.data(), q);
+                    else poly_mul_ternary_negacyclic(s, b.data(), out.data(), scratch.data(), q);
+                    REQUIRE(out == ref);
+                    // in place
+                    std::vector<u64> c = b;
+                    if (cyclic) poly_mul_ternary_cyclic(s, c.data(), c.data(), scratch.data(), q);
+                    else poly_mul_ternary_negacyclic(s, c.data(), c.data(), scratch.data(), q);
+                    REQUIRE(c == ref);
+                }
+            }
+        }
+    }
+
+    // automatic choice: sparse and dense weights against the NTT product
+    const size_t n = 1024;
+    auto primes = generate_ntt_primes(50, 2, n);
+    RnsBase base(n, primes);
+    const NttPlan& plan = base.plans[0];
+    REQUIRE(ternary_prefers_sparse(10, n));
+    REQUIRE(!ternary_prefers_sparse(n / 2, n));
+    for (size_t h : {size_t(10), n / 2}) {
+        std::vector<int8_t> sv(n, 0);
+        for (size_t i = 0; i < h; ++i) sv[rng() % n] = (rng() & 1) ? 1 : -1;
+        TernaryPoly s;
+        REQUIRE(ternary_from_signed(sv.data(), n, s));
+        std::vector<u64> sr(n), b(n);
+        ternary_to_residues(s, plan.mod, sr.data());
+        for (auto& x : b) x = rng() % plan.mod;
+        REQUIRE(poly_mul_negacyclic(s, b, plan) == poly_mul_negacyclic(sr, b, plan));
+        REQUIRE(poly_mul_cyclic(s, b, plan) == ring_mul(sr, b, plan.mod, true));
+
+        // RNS, coefficient and NTT form
+        RnsPoly a(base);
+        for (auto& x : a.data) x = rng() % primes[1];
+        for (size_t i = 0; i < base.size(); ++i)
+            for (size_t j = 0; j < n; ++j) a.limb(i)[j] %= primes[i];
+        RnsPoly c;
+        rns_mul_ternary(s, a, c);
+        REQUIRE(!c.ntt_form);
+        for (size_t i = 0; i < base.size(); ++i) {
+            std::vector<u64> ai(a.limb(i), a.limb(i) + n), si(n);
+            ternary_to_residues(s, primes[i], si.data());
+            auto ref = poly_mul_negacyclic(si, ai, base.plans[i]);
+            REQUIRE(std::equal(ref.begin(), ref.end(), c.limb(i)));
+        }
+        rns_ntt(a);
+        rns_mul_ternary(s, a, a);
+        REQUIRE(a.ntt_form);
+        rns_intt(a);
+        REQUIRE(a.data == c.data);
+    }
+
+    // packed form round trip and rejection of non-ternary input
+    std::vector<int8_t> sv(37);
+    for (auto& v : sv) v = (int8_t)(rng() % 3) - 1;
+    TernaryPoly s, t;
+    REQUIRE(ternary_from_signed(sv.data(), sv.size(), s));
+    REQUIRE(s.packed.size() == 10);
+    REQUIRE(ternary_from_packed(s.packed.data(), sv.size(), t));
+    REQUIRE(t.plus == s.plus);
+    REQUIRE(t.minus == s.minus);
+    REQUIRE(t.packed == s.packed);
+    std::vector<uint8_t> bad = s.packed;
+    bad[3] |= 3;
+    REQUIRE(!ternary_from_packed(bad.data(), sv.size(), t));
+    sv[5] = 2;
+    REQUIRE(!ternary_from_signed(sv.data(), sv.size(), t));
+    std::vector<u64> r = {0, 1, 96, 2};
+    REQUIRE(ternary_from_residues(r.data(), 3, 97, t));
+    REQUIRE(!ternary_from_residues(r.data(), 4, 97, t));
+}
+
+TEST_CASE("Tuning profile selects kernels at plan creation", "[ntt][autotune]") {
+    if (getenv("HE_TUNE_FILE")) {
+        // automatic tuning would add entries and rewrite the profile
+        WARN("skipped: HE_TUNE_FILE is set");
+        return;
+    }
+    const size_t n = 1024;
+    const u64 wide = generate_ntt_primes(50, 1, n)[0];
+    const u64 narrow = generate_ntt_primes(30, 1, n)[0];
+    REQUIRE(tune_width(wide) == 64);
+    REQUIRE(tune_width(narrow) == 32);
+    tune_clear();
+
+    // defaults without an entry
+    NttPlan def(n, wide);
+    REQUIRE(def.use_avx2 == cpu_has_avx2());
+    REQUIRE(!def.blocked);
+    REQUIRE(def.blocked_tile == 4096);
+    REQUIRE(def.batch_interleave_min == 0);
+
+    // an entry changes later plans with the same (log2 n, width) only
+    TuneChoice c;
+    c.avx2 = false;
+    c.blocked = true;
+    c.batch_interleave_min = 4;
+    c.blocked_tile = 256;  // below n, so the blocked schedule has long stages
+    c.blocked_group = 2;
+    tune_set(n, wide, c);
+    NttPlan tuned(n, wide), other(n, narrow), bigger(2 * n, wide);
+    REQUIRE(!tuned.use_avx2);
+    REQUIRE(tuned.blocked);
+    REQUIRE(tuned.blocked_tile == 256);
+    REQUIRE(tuned.blocked_group == 2);
+    REQUIRE(tuned.batch_interleave_min == 4);
+    REQUIRE(other.batch_interleave_min == 0);
+    REQUIRE(bigger.batch_interleave_min == 0);
+
+    // every selection computes the same transforms
+    std::mt19937_64 rng(24);
+    const size_t count = 6;  // one interleaved group plus two single ones
+    std::vector<u64> a(count * n);
+    for (auto& v : a) v = rng() % wide;
+    std::vector<u64> x = a, y = a;
+    ntt_negacyclic_batch(x.data(), count, def);
+    ntt_negacyclic_batch(y.data(), count, tuned);
+    REQUIRE(x == y);
+    intt_negacyclic_batch(y.data(), count, tuned);
+    REQUIRE(y == a);
+    std::vector<u64> u(a.begin(), a.begin() + n), v = u;
+    ntt(u, def);
+    ntt(v, tuned);
+    REQUIRE(u == v);
+    ntt_to_bitrev(u, def);
+    ntt_to_bitrev(v, tuned);
+    REQUIRE(u == v);
+
+    // profile round trip; other versions and CPU models are rejected
+    const char* path = "he_tune_test.txt";
+    REQUIRE(tune_save(path));
+    tune_clear();
+    TuneChoice got;
+    REQUIRE(!tune_lookup(n, wide, got));
+    REQUIRE(tune_load(path));
+    REQUIRE(tune_lookup(n, wide, got));
+    REQUIRE(!got.avx2);
+    REQUIRE(got.blocked);
+    REQUIRE(got.batch_interleave_min == 4);
+    REQUIRE(got.blocked_tile == 256);
+    REQUIRE(got.blocked_group == 2);
+    REQUIRE(!tune_lookup(n, narrow, got));
+    for (const char* text : {"he-tune 2\ncpu Some Other CPU\n10 64 1 0 0 12 4\n",
+                             "he-tune 1\ncpu x\n",  // version 1 had no blocked shape
+                             "he-tune 2\n"}) {
+        FILE* f = fopen(path, "w");
+        REQUIRE(f);
+        fputs(text, f);
+        fclose(f);
+        REQUIRE(!tune_load(path));
+    }
+    REQUIRE(tune_lookup(n, wide, got));  // a rejected file leaves the table alone
+    std::remove(path);
+
+    // calibration records a usable choice for its key
+    tune_clear();
+    TuneChoice cal = tune_calibrate(256, narrow);
+    REQUIRE(tune_lookup(256, narrow, got));
+    REQUIRE(got.avx2 == cal.avx2);
+    REQUIRE((!cal.avx2 || cpu_has_avx2()));
+    REQUIRE((cal.batch_interleave_min == 0 || cal.batch_interleave_min >= NTT_BATCH_LANES));
+    tune_clear();
+}
+
+TEST_CASE("Job queue runs operation chains asynchronously", "[ntt][queue]") {
+    const size_t n = 1024;
+    auto primes = generate_ntt_primes(50, 2, n);
+    NttPlan plans[2] = {NttPlan(n, primes[0]), NttPlan(n, primes[1])};
+    // the second plan batches through the interleaved kernels
+    plans[1].batch_interleave_min = 4;
+    std::mt19937_64 rng(25);
+    std::shared_ptr<const aligned_vector<u64>> key[2], noise[2];
+    std::vector<u64> key_coeff[2], noise_ntt[2];
+    for (int p = 0; p < 2; ++p) {
+        const u64 q = plans[p].mod;
+        key_coeff[p].resize(n);
+        for (auto& x : key_coeff[p]) x = rng() % q;
+        aligned_vector<u64> k(key_coeff[p].begin(), key_coeff[p].end()), e(n);
+        ntt_negacyclic(k.data(), n, plans[p]);
+        for (auto& x : e) x = rng() % q;
+        noise_ntt[p].assign(e.begin(), e.end());
+        key[p] = std::make_shared<const aligned_vector<u64>>(std::move(k));
+        noise[p] = std::make_shared<const aligned_vector<u64>>(std::move(e));
+    }
+
+    // c = a * key + e (e given in NTT form), then back: a dependent chain
+    auto chain = [&](int p) {
+        return std::vector<PolyStep>{{STEP_NTT, nullptr}, {STEP_MUL, key[p]}, {STEP_ADD, noise[p]},
+                                     {STEP_SUB, noise[p]}, {STEP_ADD, noise[p]}, {STEP_INTT, nullptr}};
+    };
+    auto expected = [&](int p, const std::vector<u64>& a) {
+        std::vector<u64> c = poly_mul_negacyclic(a, key_coeff[p], plans[p]);
+        std::vector<u64> e = noise_ntt[p];
+        intt_negacyclic(e, plans[p]);
+        add_mod_array(c.data(), e.data(), c.data(), n, plans[p].mod);
+        return c;
+    };
+
+    // several submitting threads, a small in-flight limit so submit blocks
+    PolyQueue queue(3, 8, 16);
+    REQUIRE(queue.workers() == 3);
+    const int threads = 4, per_thread = 24;
+    std::vector<std::vector<u64>> inputs(threads * per_thread);
+    for (auto& a : inputs) {
+        a.resize(n);
+        for (auto& x : a) x = rng() % primes[1];
+    }
+    std::vector<PolyFuture> futures(inputs.size());
+    std::atomic<size_t> max_seen{0};  // Catch2 assertions are main-thread only
+    std::vector<std::thread> submitters;
+    for (int t = 0; t < threads; ++t) {
+        submitters.emplace_back([&, t] {
+            for (int i = 0; i < per_thread; ++i) {
+                size_t k = t * per_thread + i;
+                int p = k % 2;
+                aligned_vector<u64> a(inputs[k].begin(), inputs[k].end());
+                for (auto& x : a) x %= plans[p].mod;
+                futures[k] = queue.submit(std::move(a), plans[p], chain(p));
+                size_t seen = queue.pending();
+                for (size_t m = max_seen; seen > m && !max_seen.compare_exchange_weak(m, seen);) {}
+            }
+        });
+    }
+    for (auto& t : submitters) t.join();
+    REQUIRE(max_seen <= 8);
+    for (size_t k = 0; k < inputs.size(); ++k) {
+        int p = k % 2;
+        std::vector<u64> a = inputs[k];
+        for (auto& x : a) x %= plans[p].mod;
+        aligned_vector<u64> got = futures[k].get();
+        std::vector<u64> want = expected(p, a);
+        REQUIRE(std::equal(want.begin(), want.end(), got.begin()));
+    }
+    queue.wait_idle();
+    REQUIRE(queue.pending() == 0);
+
+    // try_submit, empty programs, and draining on destruction
+    PolyFuture last;
+    {
+        PolyQueue q(1, 1);
+        aligned_vector<u64> a(inputs[0].begin(), inputs[0].end());
+        for (auto& x : a) x %= plans[0].mod;
+        aligned_vector<u64> copy = a;
+        std::vector<PolyStep> none;
+        PolyFuture f;
+        REQUIRE(q.try_submit(a, plans[0], none, f));
+        REQUIRE(std::equal(copy.begin(), copy.end(), f.get().begin()));
+        std::vector<PolyStep> steps = chain(0);
+        aligned_vector<u64> b = copy;
+        REQUIRE(q.try_submit(b, plans[0], steps, last));
+        q.wait_idle();
+        REQUIRE(last.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+        steps = chain(0);
+        b = copy;
+        last = q.submit(std::move(b), plans[0], steps);
+    }
+    std::vector<u64> a0 = inputs[0];
+    for (auto& x : a0) x %= plans[0].mod;
+    std::vector<u64> want = expected(0, a0);
+    aligned_vector<u64> got = last.get();
+    REQUIRE(std::equal(want.begin(), want.end(), got.begin()));
+}
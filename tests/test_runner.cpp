@@ -1,6 +1,7 @@
 \
 #include <bits/stdc++.h>
 #include "../include/ntt.h"
+#include "../include/mod_arith.h"
 using namespace std;
 using u64 = uint64_t;
 
@@ -28,8 +29,8 @@ int main() {
     auto A = a;
     ntt(A, roots, mod);
     // pointwise square then inverse
-    vector<u64> B = A;
-    for (size_t i = 0; i < n; ++i) B[i] = ( (__uint128_t)A[i] * A[i] ) % mod;
+    vector<u64> B(n);
+    mul_mod_array(A.data(), A.data(), B.data(), n, mod);
     intt(B, roots, mod);
     // naive square convolution
     vector<u64> C(2*n-1);
@@ -0,0 +1,69 @@
+// Writes a plan file (include/plan_file.h) for a set of NTT parameters.
+//
+//   he_plan_gen OUT [-n LOG_MIN[:LOG_MAX]] [-b BITS] [-c COUNT] [-q MOD]...
+//
+// Plans cover every n = 2^LOG_MIN..2^LOG_MAX (default 2^12..2^16) for the
+// COUNT largest BITS-bit NTT primes of the largest n (default 8 primes of
+// 60 bits; such primes also serve every smaller n), plus each -q modulus.
+// -c 0 writes only the -q moduli.
+#include "plan_file.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using u64 = uint64_t;
+
+static int usage() {
+    fprintf(stderr, "usage: he_plan_gen OUT [-n LOG_MIN[:LOG_MAX]] [-b BITS] [-c COUNT] [-q MOD]...\n");
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argv[1][0] == '-') return usage();
+    const char* out = argv[1];
+    unsigned log_min = 12, log_max = 16, bits = 60;
+    size_t count = 8;
+    std::vector<u64> extra;
+    for (int i = 2; i < argc; ++i) {
+        if (i + 1 >= argc) return usage();
+        const char* v = argv[++i];
+        if (!strcmp(argv[i - 1], "-n")) {
+            const char* colon = strchr(v, ':');
+            log_min = (unsigned)atoi(v);
+            log_max = colon ? (unsigned)atoi(colon + 1) : log_min;
+        } else if (!strcmp(argv[i - 1], "-b")) {
+            bits = (unsigned)atoi(v);
+        } else if (!strcmp(argv[i - 1], "-c")) {
+            count = (size_t)atoll(v);
+        } else if (!strcmp(argv[i - 1], "-q")) {
+            extra.push_back(strtoull(v, nullptr, 0));
+        } else {
+            return usage();
+        }
+    }
+    if (log_min < 1 || log_min > log_max || log_max > 30 || bits < 20 || bits > 62) return usage();
+
+    std::vector<u64> moduli = generate_ntt_primes(bits, count, size_t(1) << log_max);
+    if (moduli.size() < count) fprintf(stderr, "only %zu primes of %u bits for n = 2^%u\n", moduli.size(), bits, log_max);
+    moduli.insert(moduli.end(), extra.begin(), extra.end());
+
+    std::vector<const NttPlan*> plans;
+    for (unsigned l = log_min; l <= log_max; ++l) {
+        for (u64 q : moduli) {
+            size_t n = size_t(1) << l;
+            const NttPlan* p = cached_plan(n, q);
+            if (!p) {
+                fprintf(stderr, "skipping q = %llu: no NTT of size %zu\n", (unsigned long long)q, n);
+                continue;
+            }
+            plans.push_back(p);
+        }
+    }
+    if (!write_plan_file(out, plans)) {
+        perror(out);
+        return 1;
+    }
+    printf("wrote %zu plans to %s\n", plans.size(), out);
+    return 0;
+}